@@ -0,0 +1,137 @@
+#include "Clock_Sync.h"
+#include "Message_Format.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+constexpr std::chrono::microseconds TimestampedSender::safetyMargin;
+constexpr std::size_t TimestampedSender::maxFrameLength;
+
+int64_t piMicros(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+ClockEstimate estimateClock(PicoLink &link, int exchanges, std::chrono::milliseconds timeout, std::ostream &errorLog) {
+    ClockEstimate best{0, std::chrono::microseconds(0), std::chrono::microseconds(0), false};
+    int64_t bestRoundTrip = 0;
+    std::string line;
+    for (int i = 0; i < exchanges; i++) {
+        int64_t sent = piMicros(std::chrono::steady_clock::now());
+        std::string ping = "Ping " + std::to_string(sent) + "\n";
+        if (!link.writeBytes(ping.data(), ping.size())) {
+            errorLog << "Unable to send ping to the Pico!" << std::endl;
+            break;
+        }
+
+        long long echoed = 0, received = 0, replied = 0;
+        bool answered = false;
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!answered) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now());
+            if (remaining.count() < 0 || !link.readLine(line, remaining)) {
+                break;
+            }
+            answered = std::sscanf(line.c_str(), "Pong %lld %lld %lld", &echoed, &received, &replied) == 3 &&
+                       echoed == sent;
+        }
+        int64_t returned = piMicros(std::chrono::steady_clock::now());
+        if (!answered) {
+            continue;
+        }
+
+        // The round trip, minus however long the Pico held on to the ping
+        int64_t roundTrip = (returned - sent) - (replied - received);
+        if (best.valid && roundTrip >= bestRoundTrip) {
+            continue;
+        }
+        bestRoundTrip = roundTrip;
+        best.offsetUs = ((received - sent) + (replied - returned)) / 2;
+        best.latency = std::chrono::microseconds(roundTrip / 2);
+        best.uncertainty = std::chrono::microseconds(roundTrip / 2);
+        best.valid = true;
+    }
+    if (!best.valid) {
+        errorLog << "Pico did not answer any pings; clocks are not synchronized" << std::endl;
+    }
+    return best;
+}
+
+TimestampedSender::TimestampedSender(PicoLink &link, std::ostream &errorLog) : link(link), errorLog(errorLog) {}
+
+bool TimestampedSender::synchronize(int exchanges) {
+    ClockEstimate fresh = estimateClock(link, exchanges, std::chrono::milliseconds(100), errorLog);
+    if (fresh.valid) {
+        estimate = fresh;
+    }
+    return estimate.valid;
+}
+
+const ClockEstimate &TimestampedSender::clock() const {
+    return estimate;
+}
+
+std::chrono::microseconds TimestampedSender::lead() const {
+    return estimate.latency + estimate.uncertainty + safetyMargin;
+}
+
+bool TimestampedSender::sendAt(std::chrono::steady_clock::time_point applyAt, const char *frame,
+                               std::size_t length) {
+    if (!estimate.valid) {
+        errorLog << "Cannot send a timestamped frame before the clocks are synchronized!" << std::endl;
+        return false;
+    }
+    if (length > maxFrameLength) {
+        errorLog << "Timestamped frame of " << length << " bytes is longer than " << maxFrameLength << "!"
+                 << std::endl;
+        return false;
+    }
+    // Header and frame go out in a single write so nothing else sent on the link can land between them
+    char message[2 * maxMessageLength + maxFrameLength];
+    int headerLength = std::snprintf(message, 2 * maxMessageLength, "At %lld %zu\n",
+                                     static_cast<long long>(piMicros(applyAt) + estimate.offsetUs), length);
+    std::memcpy(message + headerLength, frame, length);
+    if (!link.writeBytes(message, static_cast<std::size_t>(headerLength) + length)) {
+        errorLog << "Unable to send timestamped frame to the Pico!" << std::endl;
+        return false;
+    }
+    stats.framesSent++;
+    return true;
+}
+
+void TimestampedSender::record(const std::string &report) {
+    long long requested = 0, actual = 0;
+    if (std::sscanf(report.c_str(), "Applied %lld %lld", &requested, &actual) != 2) {
+        return;
+    }
+    int64_t error = actual - requested;
+    if (error > 0) {
+        stats.lateFrames++;
+    }
+    error = std::llabs(error);
+    stats.framesReported++;
+    totalErrorUs += error;
+    stats.meanErrorUs = static_cast<double>(totalErrorUs) / static_cast<double>(stats.framesReported);
+    if (error > stats.maximumErrorUs) {
+        stats.maximumErrorUs = error;
+    }
+}
+
+void TimestampedSender::collectReports(std::chrono::milliseconds timeout) {
+    std::string line;
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (stats.framesReported < stats.framesSent) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+        if (remaining.count() < 0 || !link.readLine(line, remaining)) {
+            break;
+        }
+        record(line);
+    }
+}
+
+TimestampedSender::Statistics TimestampedSender::statistics() const {
+    return stats;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Message_Format.h"
+#include "Pico_Link.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/*
+ * Clock synchronization and timestamped frames. Times are microseconds: steady_clock on the Pi, the Pico's timer on
+ * the Pico.
+ *
+ *   Pi -> Pico  "Ping <pi time>\n"            Pico replies "Pong <pi time> <receive time> <send time>\n"
+ *   Pi -> Pico  "At <pico time> <length>\n"   followed by <length> bytes of messages. The Pico holds the messages
+ *                                             until its clock reaches <pico time>, applies them all at once, then
+ *                                             replies "Applied <pico time> <actual pico time>\n". Messages that
+ *                                             arrive late are applied as soon as they arrive.
+ */
+
+/// @brief How the Pico's clock relates to the Pi's
+struct ClockEstimate {
+    int64_t offsetUs; // Pico time = Pi time + offsetUs
+    std::chrono::microseconds latency; // One way, Pi to Pico
+    std::chrono::microseconds uncertainty; // How far off offsetUs could be (half the best round trip)
+    bool valid;
+};
+
+/// @brief The Pi's side of the protocol's clock: steady_clock in microseconds
+int64_t piMicros(std::chrono::steady_clock::time_point time);
+
+/// @brief Estimate the clock offset NTP-style: several ping exchanges, keeping the one with the shortest round trip
+/// (the one least disturbed by queueing)
+/// @param link the connection to the Pico
+/// @param exchanges how many pings to send
+/// @param timeout how long to wait for each pong
+/// @param errorLog where failures are described
+/// @return The estimate, with valid set to false if no pong came back
+ClockEstimate estimateClock(PicoLink &link, int exchanges, std::chrono::milliseconds timeout, std::ostream &errorLog);
+
+/// @brief Sends frames stamped with the Pico time at which they should be applied, and tracks how far from that time
+/// the Pico actually applied them
+class TimestampedSender {
+public:
+    struct Statistics {
+        uint64_t framesSent;
+        uint64_t framesReported; // How many the Pico has confirmed applying
+        uint64_t lateFrames; // Applied after their time
+        double meanErrorUs; // Mean of |actual - requested|
+        int64_t maximumErrorUs;
+    };
+
+    /// @brief Sent on top of the measured latency, so frames are already waiting on the Pico when their time comes
+    static constexpr std::chrono::microseconds safetyMargin{2000};
+
+    /// @brief The longest frame sendAt accepts. The header and frame go out in one write, so they are assembled in a
+    /// buffer of this size plus room for the header.
+    static constexpr std::size_t maxFrameLength = 30 * maxMessageLength;
+
+private:
+    PicoLink &link;
+    std::ostream &errorLog;
+    ClockEstimate estimate{0, std::chrono::microseconds(0), std::chrono::microseconds(0), false};
+    Statistics stats{0, 0, 0, 0, 0};
+    int64_t totalErrorUs = 0;
+
+    void record(const std::string &report);
+
+public:
+    TimestampedSender(PicoLink &link, std::ostream &errorLog);
+
+    /// @brief (Re)estimate the Pico's clock. Frames can only be sent once this has succeeded.
+    /// @return True if the estimate is valid
+    bool synchronize(int exchanges = 8);
+
+    const ClockEstimate &clock() const;
+
+    /// @brief How far ahead of its application time a frame should be sent: the measured latency plus a margin
+    std::chrono::microseconds lead() const;
+
+    /// @brief Send a frame to be applied at the given time
+    /// @param applyAt when the frame should take effect, on the Pi's clock
+    /// @param frame one or more complete messages
+    /// @param length how many bytes are in the frame
+    /// @return True if the frame was sent, false otherwise (e.g. not synchronized, or longer than maxFrameLength)
+    bool sendAt(std::chrono::steady_clock::time_point applyAt, const char *frame, std::size_t length);
+
+    /// @brief Read the Pico's reports of applied frames, until every sent frame is reported or the timeout passes
+    void collectReports(std::chrono::milliseconds timeout);
+
+    /// @brief How accurately frames have been applied so far
+    Statistics statistics() const;
+};
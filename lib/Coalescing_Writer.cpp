@@ -0,0 +1,91 @@
+#include "Coalescing_Writer.h"
+#include "Message_Format.h"
+#include "Metrics.h"
+
+#include <utility>
+
+constexpr int CoalescingWriter::maxPins;
+
+CoalescingWriter::CoalescingWriter(FrameSink sink) : sink(std::move(sink)) {
+    worker = std::thread(&CoalescingWriter::run, this);
+}
+
+void CoalescingWriter::submit(int pinNumber, int pulseWidth) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        submitted++;
+        uint32_t bit = 1u << pinNumber;
+        if ((pendingMask & bit) != 0) {
+            merged++;
+        } else {
+            pendingMask |= bit;
+            pendingOrder[pendingCount++] = pinNumber;
+            if (queueDepth != nullptr) {
+                queueDepth->set(pendingCount);
+            }
+        }
+        pendingPulseWidths[pinNumber] = pulseWidth;
+    }
+    wake.notify_one();
+}
+
+void CoalescingWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pendingCount == 0 && !sending; });
+}
+
+CoalescingWriter::Statistics CoalescingWriter::statistics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Statistics{submitted, merged, framesSent};
+}
+
+void CoalescingWriter::reportQueueDepth(Gauge *gauge) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queueDepth = gauge;
+    if (queueDepth != nullptr) {
+        queueDepth->set(pendingCount);
+    }
+}
+
+void CoalescingWriter::run() {
+    char frame[maxPins * maxMessageLength];
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return pendingCount != 0 || stopping; });
+        if (pendingCount == 0) {
+            break;
+        }
+
+        std::size_t length = 0;
+        for (int i = 0; i < pendingCount; i++) {
+            int pinNumber = pendingOrder[i];
+            length += formatPwmMessage(frame + length, pinNumber, pendingPulseWidths[pinNumber]);
+        }
+        pendingCount = 0;
+        pendingMask = 0;
+        if (queueDepth != nullptr) {
+            queueDepth->set(0);
+        }
+        sending = true;
+        framesSent++;
+
+        lock.unlock();
+        sink(frame, length);
+        lock.lock();
+
+        sending = false;
+        if (pendingCount == 0) {
+            idle.notify_all();
+        }
+    }
+    idle.notify_all();
+}
+
+CoalescingWriter::~CoalescingWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
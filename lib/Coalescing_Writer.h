@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class Gauge;
+
+/// @brief Sends pwm values to the Pico in "latest wins" mode. Values submitted while the previous frame is still
+/// being transmitted are merged per pin, so only the newest value for each pin is ever sent and the newest command
+/// waits at most one frame time, however fast commands are submitted.
+class CoalescingWriter {
+public:
+    /// @brief Transmits one frame. Should block until the frame has actually left (e.g. write() followed by
+    /// tcdrain()), since that is what decides how long values can keep being merged.
+    using FrameSink = std::function<void(const char *, std::size_t)>;
+
+    /// @brief Pico GPIO numbers run from 0 to 29, but WiringControl accepts any pin from 0 to 31, so every one of
+    /// those can be coalesced
+    static constexpr int maxPins = 32;
+
+private:
+    FrameSink sink;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    int pendingPulseWidths[maxPins] = {};
+    int pendingOrder[maxPins] = {};
+    int pendingCount = 0;
+    uint32_t pendingMask = 0;
+    bool sending = false;
+    bool stopping = false;
+    Gauge *queueDepth = nullptr;
+
+    uint64_t submitted = 0;
+    uint64_t merged = 0;
+    uint64_t framesSent = 0;
+
+    std::thread worker;
+
+    void run();
+
+public:
+    /// @brief Counters describing how much merging has happened
+    struct Statistics {
+        uint64_t updatesSubmitted; // Pin values handed to submit()
+        uint64_t updatesMerged; // Pin values replaced by a newer one before they were sent
+        uint64_t framesSent; // Frames handed to the sink
+    };
+
+    /// @brief Queue a pwm value for a pin, replacing any value for that pin that hasn't been sent yet
+    /// @param pinNumber the GPIO number of the pin, between 0 and 31
+    /// @param pulseWidth a pwm value between 1100 and 1900
+    void submit(int pinNumber, int pulseWidth);
+
+    /// @brief Block until every submitted value has been sent
+    void flush();
+
+    /// @brief A snapshot of the merge counters
+    Statistics statistics();
+
+    /// @brief Keep a gauge set to how many pins have a value waiting to be sent
+    /// @param gauge the gauge to update, or nullptr to stop updating it. Must outlive the writer
+    void reportQueueDepth(Gauge *gauge);
+
+    /// @param sink what frames are sent through. Called from the writer's own thread
+    explicit CoalescingWriter(FrameSink sink);
+
+    CoalescingWriter(const CoalescingWriter &) = delete;
+
+    CoalescingWriter &operator=(const CoalescingWriter &) = delete;
+
+    /// @brief Sends anything still pending, then stops the writer thread
+    ~CoalescingWriter();
+};
@@ -0,0 +1,138 @@
+#include "Command_Arbiter.h"
+#include "Command_Interpreter.h"
+
+#include <algorithm>
+#include <thread>
+
+constexpr uint32_t CommandArbiter::switchHistory;
+
+CommandArbiter::CommandArbiter(const std::vector<CommandSourceSettings> &sourceSettings) :
+        sources(new Source[sourceSettings.size()]), sourceCount(static_cast<int>(sourceSettings.size())) {
+    for (int index = 0; index < sourceCount; index++) {
+        sources[index].settings = sourceSettings[index];
+        ranking.push_back(index);
+    }
+    std::stable_sort(ranking.begin(), ranking.end(), [&sourceSettings](int left, int right) {
+        return sourceSettings[left].priority > sourceSettings[right].priority;
+    });
+}
+
+int64_t CommandArbiter::toNs(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+int CommandArbiter::size() const {
+    return sourceCount;
+}
+
+const CommandSourceSettings &CommandArbiter::source(int index) const {
+    return sources[index].settings;
+}
+
+void CommandArbiter::submit(int index, const pwm_array &pwms) {
+    sources[index].slot.write(SourceCommand{pwms, toNs(std::chrono::steady_clock::now())});
+}
+
+void CommandArbiter::release(int index) {
+    sources[index].slot.write(SourceCommand{pwm_array{}, 0});
+}
+
+void CommandArbiter::recordSwitch(int64_t nowNs, int to, int64_t commandAgeNs) {
+    // Only the executor records switches, so the count can't change under us
+    uint64_t count = switchCount.load(std::memory_order_relaxed);
+    recentSwitches[count % switchHistory].write(SourceSwitch{nowNs, active, to, commandAgeNs});
+    switchCount.store(count + 1, std::memory_order_release);
+}
+
+int CommandArbiter::tick(Command_Interpreter_RPi5 &interpreter, std::chrono::steady_clock::time_point now) {
+    int64_t nowNs = toNs(now);
+    ticks.fetch_add(1, std::memory_order_relaxed);
+
+    int winner = -1;
+    SourceCommand winning{};
+    uint32_t winningVersion = 0;
+    bool activeExpired = false;
+    for (int index: ranking) {
+        Source &source = sources[index];
+        // If the source is in the middle of a write, tryRead() leaves the last consistent copy alone and the new
+        // command is picked up next tick
+        source.slot.tryRead(source.lastRead, source.lastReadVersion);
+        const SourceCommand &command = source.lastRead;
+        uint32_t version = source.lastReadVersion;
+        if (command.submittedNs == 0) {
+            continue;
+        }
+        if (nowNs - command.submittedNs > source.settings.lease.count()) {
+            activeExpired = activeExpired || index == active;
+            continue;
+        }
+        winner = index;
+        winning = command;
+        winningVersion = version;
+        break;
+    }
+
+    bool switched = winner != active;
+    if (switched) {
+        if (activeExpired) {
+            expiredLeases.fetch_add(1, std::memory_order_relaxed);
+        }
+        recordSwitch(nowNs, winner, winner < 0 ? 0 : std::max<int64_t>(0, nowNs - winning.submittedNs));
+        active = winner;
+        activeSource.store(winner, std::memory_order_relaxed);
+    }
+
+    if (winner < 0) {
+        if (!neutralSent) {
+            interpreter.untimed_execute(pwm_array{{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}});
+            commandsApplied.fetch_add(1, std::memory_order_relaxed);
+            neutralSent = true;
+        }
+        return -1;
+    }
+    if (switched || winningVersion != appliedVersion) {
+        interpreter.untimed_execute(winning.pwms);
+        commandsApplied.fetch_add(1, std::memory_order_relaxed);
+        appliedVersion = winningVersion;
+        neutralSent = false;
+    }
+    return winner;
+}
+
+void CommandArbiter::run(Command_Interpreter_RPi5 &interpreter, const std::atomic<bool> &running,
+                         std::chrono::microseconds tickPeriod) {
+    auto nextTick = std::chrono::steady_clock::now();
+    while (running.load(std::memory_order_relaxed)) {
+        auto now = std::chrono::steady_clock::now();
+        tick(interpreter, now);
+        // If a tick ran late, carry on from now rather than running the missed ticks back to back
+        nextTick = std::max(nextTick + tickPeriod, now);
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+CommandArbiter::Statistics CommandArbiter::statistics() const {
+    return Statistics{ticks.load(std::memory_order_relaxed), commandsApplied.load(std::memory_order_relaxed),
+                      switchCount.load(std::memory_order_acquire), expiredLeases.load(std::memory_order_relaxed),
+                      activeSource.load(std::memory_order_relaxed)};
+}
+
+std::vector<SourceSwitch> CommandArbiter::switches() const {
+    uint64_t count = switchCount.load(std::memory_order_acquire);
+    uint64_t first = count > switchHistory ? count - switchHistory : 0;
+    std::vector<SourceSwitch> recent;
+    recent.reserve(static_cast<std::size_t>(count - first));
+    for (uint64_t i = first; i < count; i++) {
+        SourceSwitch entry{};
+        recentSwitches[i % switchHistory].read(entry);
+        recent.push_back(entry);
+    }
+    // Entries the executor wrapped around onto while we were copying belong to newer switches, so drop them
+    uint64_t now = switchCount.load(std::memory_order_acquire);
+    uint64_t overwritten = now > switchHistory ? now - switchHistory : 0;
+    if (overwritten > first) {
+        recent.erase(recent.begin(),
+                     recent.begin() + static_cast<std::ptrdiff_t>(std::min(overwritten - first, count - first)));
+    }
+    return recent;
+}
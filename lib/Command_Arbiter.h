@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Command.h"
+#include "Seqlock.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Command_Interpreter_RPi5;
+
+/// @brief One of the programs that wants to drive the thrusters (e.g. teleop, autonomy, the safety system)
+struct CommandSourceSettings {
+    std::string name;
+    int priority; // Higher wins. Sources with equal priority are ranked in the order they were given
+    std::chrono::nanoseconds lease; // How long a command stays in force without being resubmitted
+};
+
+/// @brief When the arbiter handed the thrusters from one source to another
+struct SourceSwitch {
+    int64_t timeNs; // steady_clock time of the tick that made the switch
+    int32_t from; // Index of the previous source, or -1 if no source was live (thrusters neutral)
+    int32_t to; // Index of the new source, or -1 if no source is live any more
+    int64_t commandAgeNs; // How long the new source's command had been waiting when it took effect
+};
+
+/// @brief Decides which of several command sources drives the thrusters. Each source has its own slot, written
+/// without locks (a seqlock, one writer per slot), so sources never wait on each other or on the executor. Each control
+/// tick, the executor reads every slot, also without locks, and applies the command of the highest priority source
+/// whose lease hasn't run out. When every lease has run out, the thrusters are sent to neutral (1500).
+class CommandArbiter {
+public:
+    /// @brief How many recent switches switches() can return
+    static constexpr uint32_t switchHistory = 64;
+
+    /// @brief Counters since the arbiter was created
+    struct Statistics {
+        uint64_t ticks;
+        uint64_t commandsApplied; // Commands passed on to the interpreter
+        uint64_t switches;
+        uint64_t expiredLeases; // How many times the active source lost the thrusters by letting its lease run out
+        int activeSource; // -1 if no source is live
+    };
+
+private:
+    /// @brief What a source last asked for
+    struct SourceCommand {
+        pwm_array pwms;
+        int64_t submittedNs; // 0 if the source has never submitted (or has released the thrusters)
+    };
+
+    struct Source {
+        CommandSourceSettings settings;
+        Seqlock<SourceCommand> slot;
+        // The last consistent copy of the slot, only touched by the executor. Used for a tick that catches the source
+        // in the middle of a write, so the executor never waits on a submitter.
+        SourceCommand lastRead{};
+        uint32_t lastReadVersion = 0;
+    };
+
+    std::unique_ptr<Source[]> sources;
+    int sourceCount;
+    std::vector<int> ranking; // Source indices from highest to lowest priority
+
+    // Executor state, only touched by the thread calling tick()
+    int active = -1;
+    uint32_t appliedVersion = 0;
+    bool neutralSent = false;
+
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> commandsApplied{0};
+    std::atomic<uint64_t> expiredLeases{0};
+    std::atomic<int> activeSource{-1};
+    std::atomic<uint64_t> switchCount{0};
+    Seqlock<SourceSwitch> recentSwitches[switchHistory];
+
+    static int64_t toNs(std::chrono::steady_clock::time_point time);
+
+    void recordSwitch(int64_t nowNs, int to, int64_t commandAgeNs);
+
+public:
+    /// @param sourceSettings every source that may drive the thrusters. A source is referred to by its index in this
+    /// list; there is no adding sources later, so the executor never has to synchronize with registration.
+    explicit CommandArbiter(const std::vector<CommandSourceSettings> &sourceSettings);
+
+    CommandArbiter(const CommandArbiter &) = delete;
+
+    CommandArbiter &operator=(const CommandArbiter &) = delete;
+
+    /// @brief How many sources there are
+    int size() const;
+
+    const CommandSourceSettings &source(int index) const;
+
+    /// @brief Ask for the thrusters on behalf of a source, starting (or extending) its lease. Lock-free; each source
+    /// should be submitted to from one thread at a time.
+    /// @param index which source
+    /// @param pwms the pwm values, between 1100 and 1900, in the same order as the interpreter's thruster pins
+    void submit(int index, const pwm_array &pwms);
+
+    /// @brief Give up the thrusters on behalf of a source without waiting for its lease to run out
+    void release(int index);
+
+    /// @brief Pick the highest priority live source and, if its command hasn't been applied yet, apply it. Sends the
+    /// thrusters to neutral once when no source is live. Takes no locks and never waits for a submitter: a source caught
+    /// in the middle of a write is judged on its previous command this tick. Cheap enough to run every control tick.
+    /// @param interpreter the interpreter to apply commands to. Only the executor thread may use it.
+    /// @param now the time of this tick (leases are measured against it)
+    /// @return The index of the source now driving the thrusters, or -1 if none is live
+    int tick(Command_Interpreter_RPi5 &interpreter,
+             std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    /// @brief Call tick() every tickPeriod until running is set to false
+    void run(Command_Interpreter_RPi5 &interpreter, const std::atomic<bool> &running,
+             std::chrono::microseconds tickPeriod);
+
+    /// @brief A snapshot of the counters. Safe to call from any thread.
+    Statistics statistics() const;
+
+    /// @brief The most recent source switches, oldest first. Safe to call from any thread.
+    std::vector<SourceSwitch> switches() const;
+};
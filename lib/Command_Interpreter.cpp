@@ -3,127 +3,75 @@
 #include <fstream>
 #include <ctime>
 #include <utility>
+#include <algorithm>
+#include <thread>
 #include "Serial.h"
 #include "Command_Interpreter.h"
 #include "Wiring.h"
+#include "Message_Format.h"
 
-void DigitalPin::initialize(WiringControl &wiringControl) {
-    switch (enableType) {
-        case ActiveLow:
-            wiringControl.setPinType(gpioNumber, DigitalActiveLow);
-            break;
-        case ActiveHigh:
-            wiringControl.setPinType(gpioNumber, DigitalActiveHigh);
-            break;
-        default:
-            errorLog << "Impossible digital pin type " << enableType << "! Exiting." << std::endl;
-            exit(42);
-    }
+void DigitalPin::initialize(WiringControl &wiringControl) const {
+    wiringControl.setPinType(gpioNumber, enableType == ActiveLow ? DigitalActiveLow : DigitalActiveHigh);
 }
 
-void DigitalPin::enable(WiringControl &wiringControl) {
-    switch (enableType) {
-        case ActiveHigh:
-            wiringControl.digitalWrite(gpioNumber, High);
-            break;
-        case ActiveLow:
-            wiringControl.digitalWrite(gpioNumber, Low);
-            break;
-        default:
-            errorLog << "Impossible pin mode!" << std::endl;
-            exit(42);
-    }
+void DigitalPin::enable(WiringControl &wiringControl) const {
+    wiringControl.digitalWrite(gpioNumber, enableType == ActiveLow ? Low : High);
 }
 
-void DigitalPin::disable(WiringControl &wiringControl) {
-    switch (enableType) {
-        case ActiveHigh:
-            wiringControl.digitalWrite(gpioNumber, Low);
-            break;
-        case ActiveLow:
-            wiringControl.digitalWrite(gpioNumber, High);
-            break;
-        default:
-            errorLog << "Impossible pin mode!" << std::endl;
-            exit(42);
-    }
+void DigitalPin::disable(WiringControl &wiringControl) const {
+    wiringControl.digitalWrite(gpioNumber, enableType == ActiveLow ? High : Low);
 }
 
-bool DigitalPin::enabled(WiringControl &wiringControl) {
-    switch (enableType) {
-        case ActiveHigh:
-            return wiringControl.digitalRead(gpioNumber) == High;
-        case ActiveLow:
-            return wiringControl.digitalRead(gpioNumber) == Low;
-        default:
-            errorLog << "Impossible pin enable type! Exiting." << std::endl;
-            exit(42);
-    }
+bool DigitalPin::enabled(const WiringControl &wiringControl) const {
+    return wiringControl.digitalRead(gpioNumber) == (enableType == ActiveLow ? Low : High);
 }
 
-int DigitalPin::read(WiringControl &wiringControl) {
+int DigitalPin::read(const WiringControl &wiringControl) const {
     return wiringControl.digitalRead(gpioNumber);
 }
 
-void PwmPin::setPwm(int pulseWidth, WiringControl &wiringControl) {
-    setPowerAndDirection(pulseWidth, wiringControl);
-    std::time_t currentTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-    outLog << "Current time: " << std::ctime(&currentTime) << std::endl;
-    outLog << "Thruster at pin " << gpioNumber << ": " << pulseWidth << std::endl;
+int DigitalPin::getGpioNumber() const {
+    return gpioNumber;
 }
 
+EnableType DigitalPin::getEnableType() const {
+    return enableType;
+}
 
-void HardwarePwmPin::initialize(WiringControl &wiringControl) {
-    wiringControl.setPinType(gpioNumber, HardwarePWM);
+void PwmPin::initialize(WiringControl &wiringControl) const {
+    wiringControl.setPinType(gpioNumber, pinType);
 }
 
-void HardwarePwmPin::enable(WiringControl &wiringControl) {
+void PwmPin::enable(WiringControl &wiringControl) const {
     wiringControl.pwmWriteMaximum(gpioNumber);
 }
 
-void HardwarePwmPin::disable(WiringControl &wiringControl) {
+void PwmPin::disable(WiringControl &wiringControl) const {
     wiringControl.pwmWriteOff(gpioNumber);
 }
 
-bool HardwarePwmPin::enabled(WiringControl &wiringControl) {
+bool PwmPin::enabled(const WiringControl &wiringControl) const {
     return wiringControl.pwmRead(gpioNumber).pulseWidth != 1500;
 }
 
-void HardwarePwmPin::setPowerAndDirection(int pwmValue, WiringControl &wiringControl) {
-    wiringControl.pwmWrite(gpioNumber, pwmValue);
+void PwmPin::setPwm(int pulseWidth, WiringControl &wiringControl) const {
+    wiringControl.pwmWrite(gpioNumber, pulseWidth);
 }
 
-int HardwarePwmPin::read(WiringControl &wiringControl) {
+int PwmPin::read(const WiringControl &wiringControl) const {
     return wiringControl.pwmRead(gpioNumber).pulseWidth;
 }
 
-
-void SoftwarePwmPin::initialize(WiringControl &wiringControl) {
-    wiringControl.setPinType(gpioNumber, SoftwarePWM);
-}
-
-void SoftwarePwmPin::enable(WiringControl &wiringControl) {
-    wiringControl.pwmWriteMaximum(gpioNumber);
+int PwmPin::getGpioNumber() const {
+    return gpioNumber;
 }
 
-void SoftwarePwmPin::disable(WiringControl &wiringControl) {
-    wiringControl.pwmWriteOff(gpioNumber);
+PinType PwmPin::getPinType() const {
+    return pinType;
 }
 
-bool SoftwarePwmPin::enabled(WiringControl &wiringControl) {
-    return wiringControl.pwmRead(gpioNumber).pulseWidth != 1500;
-}
-
-void SoftwarePwmPin::setPowerAndDirection(int pwmValue, WiringControl &wiringControl) {
-    wiringControl.pwmWrite(gpioNumber, pwmValue);
-}
-
-int SoftwarePwmPin::read(WiringControl &wiringControl) {
-    return wiringControl.pwmRead(gpioNumber).pulseWidth;
-}
-
-Command_Interpreter_RPi5::Command_Interpreter_RPi5(std::vector<PwmPin *> thrusterPins,
-                                                   std::vector<DigitalPin *> digitalPins,
+Command_Interpreter_RPi5::Command_Interpreter_RPi5(std::vector<PwmPin> thrusterPins,
+                                                   std::vector<DigitalPin> digitalPins,
                                                    const WiringControl &wiringControl, std::ostream &output,
                                                    std::ostream &outLog, std::ostream &errorLog) :
         thrusterPins(std::move(thrusterPins)), digitalPins(std::move(digitalPins)), wiringControl(wiringControl),
@@ -134,53 +82,438 @@ Command_Interpreter_RPi5::Command_Interpreter_RPi5(std::vector<PwmPin *> thruste
                  << std::endl;
         exit(42);
     }
-}
-
-std::vector<Pin *> Command_Interpreter_RPi5::allPins() {
-    auto allPins = std::vector<Pin *>{};
-    allPins.insert(allPins.end(), this->thrusterPins.begin(), this->thrusterPins.end());
-    allPins.insert(allPins.end(), this->digitalPins.begin(), this->digitalPins.end());
-    return allPins;
+    for (const DigitalPin &pin: this->digitalPins) {
+        if (pin.getGpioNumber() < 0 || pin.getGpioNumber() > 31) {
+            errorLog << "Invalid digital pin number " << pin.getGpioNumber() << "!" << std::endl;
+            exit(42);
+        }
+        digitalPinMask |= 1u << pin.getGpioNumber();
+        if (pin.getEnableType() == ActiveLow) {
+            activeLowMask |= 1u << pin.getGpioNumber();
+        }
+    }
 }
 
 void Command_Interpreter_RPi5::initializePins() {
     if (!wiringControl.initializeSerial()) {
-        errorLog << "Failure to configure serial!" << std::endl;
-        exit(42);
+        errorLog << "Unable to reach the Pico! Still trying; pins will be configured once it connects." << std::endl;
+    }
+    for (const PwmPin &pin: thrusterPins) {
+        pin.initialize(wiringControl);
     }
-    for (Pin *pin: allPins()) {
-        pin->initialize(wiringControl);
+    for (const DigitalPin &pin: digitalPins) {
+        pin.initialize(wiringControl);
     }
 }
 
 std::vector<int> Command_Interpreter_RPi5::readPins() {
+    checkWatchdog();
     std::vector<int> pinValues;
-    for (auto pin: allPins()) {
-        pinValues.push_back(pin->read(wiringControl));
+    pinValues.reserve(thrusterPins.size() + digitalPins.size());
+    for (const PwmPin &pin: thrusterPins) {
+        pinValues.push_back(pin.read(wiringControl));
+    }
+    for (const DigitalPin &pin: digitalPins) {
+        pinValues.push_back(pin.read(wiringControl));
     }
     return pinValues;
 }
 
 Command_Interpreter_RPi5::~Command_Interpreter_RPi5() {
-    for (auto pin: allPins()) {
-        delete pin;
+    if (watchdog != nullptr) {
+        watchdog->disarm();
     }
 }
 
 void Command_Interpreter_RPi5::blind_execute(const CommandComponent &commandComponent) {
-    auto endTime = std::chrono::system_clock::now() + commandComponent.duration;
-    auto currentTime = std::chrono::system_clock::now();
+    auto endTime = clock->now() + commandComponent.duration;
     untimed_execute(commandComponent.thruster_pwms);
-    while (currentTime < endTime) {
+    waitUntil(endTime, *clock);
+}
+
+void Command_Interpreter_RPi5::blindExecuteCommands(const Command *begin, const Command *end) {
+    for (const Command *command = begin; command != end; command++) {
+        blind_execute(command->acceleration);
+        blind_execute(command->steadyState);
+        blind_execute(command->deceleration);
+    }
+}
+
+void Command_Interpreter_RPi5::blind_execute(const Sequence &sequence) {
+    blindExecuteCommands(sequence.commands.data(), sequence.commands.data() + sequence.commands.size());
+}
+
+void Command_Interpreter_RPi5::blind_execute(ArenaSequence &&sequence) {
+    ArenaSequence owned(std::move(sequence));
+    blindExecuteCommands(owned.begin(), owned.end());
+}
+
+std::vector<int> Command_Interpreter_RPi5::thrusterPinNumbers() {
+    std::vector<int> pinNumbers;
+    for (const PwmPin &pin: thrusterPins) {
+        pinNumbers.push_back(pin.getGpioNumber());
+    }
+    return pinNumbers;
+}
+
+bool Command_Interpreter_RPi5::compile(const Sequence &sequence, MissionTimeline &timeline) {
+    return compileSequence(sequence, thrusterPinNumbers(), timeline, errorLog);
+}
+
+bool Command_Interpreter_RPi5::compile(const ArenaSequence &sequence, MissionTimeline &timeline) {
+    return compileSequence(sequence.begin(), sequence.size(), thrusterPinNumbers(), timeline, errorLog);
+}
+
+bool Command_Interpreter_RPi5::canExecute(const MissionTimeline &timeline) {
+    if (!timeline.valid()) {
+        errorLog << "Cannot execute an empty timeline!" << std::endl;
+        return false;
+    }
+    for (int thruster = 0; thruster < 8; thruster++) {
+        if (timeline.header().thrusterPins[thruster] != thrusterPins[thruster].getGpioNumber()) {
+            errorLog << "Timeline was compiled for different thruster pins! Not executing." << std::endl;
+            return false;
+        }
+        // Timeline bytes go straight to the Pico, which only has a digital output on these pins
+        if (thrusterPins[thruster].getPinType() == SoftwarePWM && wiringControl.generatesSoftwarePwm()) {
+            errorLog << "Timelines can't drive software pwm pins generated on the Pi! Not executing." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Command_Interpreter_RPi5::execute(const MissionTimeline &timeline) {
+    if (!canExecute(timeline)) {
+        return false;
+    }
+    if (timestampedSender != nullptr) {
+        return executeTimestamped(timeline);
+    }
+    const TimelineHeader &header = timeline.header();
+
+    checkWatchdog();
+    // Queued pwm values would otherwise be sent in the middle of the timeline, overriding its entries
+    wiringControl.flushCoalesced();
+    auto start = clock->now();
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const TimelineEntry &entry = timeline.entry(i);
+        waitUntil(start + std::chrono::nanoseconds(entry.offsetNs), *clock);
+        auto tripHeldOff = holdOffWatchdog();
+        wiringControl.writeFrame(timeline.bytes(entry), entry.byteLength);
+        for (int thruster = 0; thruster < 8; thruster++) {
+            wiringControl.setCachedPwm(header.thrusterPins[thruster], entry.thrusterPwms[thruster]);
+        }
+        if (watchdog != nullptr) {
+            watchdog->feed();
+        }
+    }
+    waitUntil(start + std::chrono::nanoseconds(header.totalDurationNs), *clock);
+    return true;
+}
+
+bool Command_Interpreter_RPi5::executeTimestamped(const MissionTimeline &timeline) {
+    const TimelineHeader &header = timeline.header();
+    checkWatchdog();
+    wiringControl.flushCoalesced();
+    // Both clocks drift, so measure again for every timeline
+    timestampedSender->synchronize();
+    const auto lead = timestampedSender->lead();
+
+    SteadyInterpreterClock steadyClock;
+    auto start = steadyClock.now() + lead;
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const TimelineEntry &entry = timeline.entry(i);
+        auto applyAt = start + std::chrono::nanoseconds(entry.offsetNs);
+        waitUntil(applyAt - lead, steadyClock);
+        auto tripHeldOff = holdOffWatchdog();
+        if (!timestampedSender->sendAt(applyAt, timeline.bytes(entry), entry.byteLength)) {
+            return false;
+        }
+        for (int thruster = 0; thruster < 8; thruster++) {
+            wiringControl.setCachedPwm(header.thrusterPins[thruster], entry.thrusterPwms[thruster]);
+        }
+        if (watchdog != nullptr) {
+            watchdog->feed();
+        }
+    }
+    waitUntil(start + std::chrono::nanoseconds(header.totalDurationNs), steadyClock);
+    timestampedSender->collectReports(std::chrono::duration_cast<std::chrono::milliseconds>(lead) +
+                                      std::chrono::milliseconds(100));
+    return true;
+}
+
+bool Command_Interpreter_RPi5::enableTimestampedFrames() {
+    PicoLink *link = wiringControl.picoLink();
+    if (link == nullptr) {
+        errorLog << "No link to the Pico to synchronize clocks over!" << std::endl;
+        return false;
+    }
+    auto sender = std::unique_ptr<TimestampedSender>(new TimestampedSender(*link, errorLog));
+    if (!sender->synchronize()) {
+        return false;
+    }
+    const ClockEstimate &estimate = sender->clock();
+    outLog << "Pico clock offset " << estimate.offsetUs << " us (+/- " << estimate.uncertainty.count()
+           << " us), latency " << estimate.latency.count() << " us" << std::endl;
+    timestampedSender = std::move(sender);
+    return true;
+}
+
+ClockEstimate Command_Interpreter_RPi5::picoClock() {
+    if (timestampedSender == nullptr) {
+        return ClockEstimate{0, std::chrono::microseconds(0), std::chrono::microseconds(0), false};
+    }
+    return timestampedSender->clock();
+}
 
-        currentTime = std::chrono::system_clock::now();
+TimestampedSender::Statistics Command_Interpreter_RPi5::applicationTimeStatistics() {
+    if (timestampedSender == nullptr) {
+        return TimestampedSender::Statistics{0, 0, 0, 0, 0};
+    }
+    return timestampedSender->statistics();
+}
+
+bool Command_Interpreter_RPi5::onboard_execute(const MissionTimeline &timeline) {
+    PicoLink *link = wiringControl.picoLink();
+    if (link == nullptr) {
+        errorLog << "No link to the Pico to upload the timeline over!" << std::endl;
+        return false;
+    }
+    if (!canExecute(timeline)) {
+        return false;
+    }
+    const TimelineHeader &header = timeline.header();
+
+    checkWatchdog();
+    // Anything still queued for the thrusters has to reach the Pico before it hands them over to playback
+    wiringControl.flushCoalesced();
+    SequenceUploader uploader(*link, errorLog, std::chrono::milliseconds(500), clock);
+    if (!uploader.upload(timeline) || !uploader.arm()) {
+        return false;
+    }
+    if (!uploader.trigger()) {
+        uploader.abort();
+        return false;
+    }
+
+    // The Pico keeps time now; the Pi only checks that each report arrives when it should
+    const auto margin = std::chrono::milliseconds(100);
+    const auto slice = std::chrono::milliseconds(10);
+    auto start = clock->now();
+    uint32_t nextStep = 0;
+    while (true) {
+        uint64_t dueNs = nextStep < header.entryCount ? timeline.entry(nextStep).offsetNs : header.totalDurationNs;
+        auto due = start + std::chrono::nanoseconds(dueNs) + margin;
+        auto now = clock->now();
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - now);
+        uint32_t step = 0;
+        auto event = uploader.waitForEvent(std::max(std::chrono::milliseconds(0), std::min(wait, slice)), step);
+        if (watchdog != nullptr) {
+            watchdog->feed();
+        }
+
+        if (event == SequenceUploader::PlaybackEvent::Progress && step < header.entryCount) {
+            const TimelineEntry &entry = timeline.entry(step);
+            for (int thruster = 0; thruster < 8; thruster++) {
+                wiringControl.setCachedPwm(header.thrusterPins[thruster], entry.thrusterPwms[thruster]);
+            }
+            nextStep = step + 1;
+        } else if (event == SequenceUploader::PlaybackEvent::Done) {
+            return true;
+        } else if (event == SequenceUploader::PlaybackEvent::Failed ||
+                   clock->now() >= due) {
+            errorLog << "On-board playback failed before step " << nextStep << "! Aborting." << std::endl;
+            // Whatever went wrong, aborting leaves the thrusters in a known state
+            uploader.abort();
+            for (int thruster = 0; thruster < 8; thruster++) {
+                wiringControl.setCachedPwm(header.thrusterPins[thruster], 1500);
+            }
+            return false;
+        }
+    }
+}
+
+bool Command_Interpreter_RPi5::onboard_execute(const Sequence &sequence) {
+    MissionTimeline timeline;
+    return compile(sequence, timeline) && onboard_execute(timeline);
+}
+
+bool Command_Interpreter_RPi5::onboard_execute(ArenaSequence &&sequence) {
+    ArenaSequence owned(std::move(sequence));
+    MissionTimeline timeline;
+    return compile(owned, timeline) && onboard_execute(timeline);
+}
+
+std::unique_lock<std::mutex> Command_Interpreter_RPi5::holdOffWatchdog() {
+    return watchdog != nullptr ? watchdog->holdOffTrip() : std::unique_lock<std::mutex>();
+}
+
+void Command_Interpreter_RPi5::waitUntil(std::chrono::steady_clock::time_point time, InterpreterClock &timeSource) {
+    if (watchdog == nullptr) {
+        timeSource.sleepUntil(time);
+        return;
+    }
+    // Wake up often enough to keep the watchdog fed while deliberately holding the current command
+    const auto slice = std::chrono::milliseconds(10);
+    auto now = timeSource.now();
+    while (now < time) {
+        timeSource.sleepUntil(std::min(time, now + slice));
+        watchdog->feed();
+        now = timeSource.now();
     }
 }
 
 void Command_Interpreter_RPi5::untimed_execute(pwm_array thrusterPwms) {
-    int i = 0;
-    for (int pulseWidth: thrusterPwms.pwm_signals) {
-        thrusterPins.at(i)->setPwm(pulseWidth, wiringControl);
-        i++;
+    auto start = std::chrono::steady_clock::now();
+    checkWatchdog();
+    {
+        auto tripHeldOff = holdOffWatchdog();
+        for (std::size_t thruster = 0; thruster < thrusterPins.size(); thruster++) {
+            thrusterPins[thruster].setPwm(thrusterPwms.pwm_signals[thruster], wiringControl);
+        }
+        if (watchdog != nullptr) {
+            watchdog->feed();
+        }
+    }
+    std::time_t currentTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    // ctime() shares one buffer between every caller, so interpreters on different threads would race on it
+    char timeText[26];
+    outLog << "Current time: " << ctime_r(&currentTime, timeText);
+    // Log what the pins were left at rather than what was asked for, since out-of-range values are never sent
+    for (std::size_t thruster = 0; thruster < thrusterPins.size(); thruster++) {
+        int gpioNumber = thrusterPins[thruster].getGpioNumber();
+        int requested = thrusterPwms.pwm_signals[thruster];
+        int sent = wiringControl.pwmRead(gpioNumber).pulseWidth;
+        outLog << "Thruster at pin " << gpioNumber << ": " << sent;
+        if (sent != requested) {
+            outLog << " (rejected " << requested << ")";
+        }
+        outLog << '\n';
+    }
+    outLog.flush();
+    if (metrics != nullptr) {
+        commandsExecuted->add();
+        commandLatency->observe(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count()));
     }
-}
\ No newline at end of file
+}
+
+void Command_Interpreter_RPi5::attachMetrics(std::shared_ptr<MetricsRegistry> registry) {
+    wiringControl.attachMetrics(registry);
+    commandsExecuted = &registry->counter("propulsion_commands_total", "Thruster commands executed");
+    commandLatency = &registry->histogram("propulsion_command_latency_microseconds",
+                                          "How long each thruster command took to hand to WiringControl",
+                                          {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000});
+    watchdogTrips = &registry->counter("propulsion_watchdog_trips_total",
+                                       "Times the watchdog drove the thrusters to neutral, counted at the next command");
+    metrics = std::move(registry);
+}
+
+void Command_Interpreter_RPi5::useClock(std::shared_ptr<InterpreterClock> newClock) {
+    clock = std::move(newClock);
+}
+
+void Command_Interpreter_RPi5::enableEnergyAccounting(const ThrustModel &model, double batteryWattHours,
+                                                      float supplyVoltage) {
+    energyMeter = std::make_shared<ThrusterEnergyMeter>(model, thrusterPinNumbers(), batteryWattHours,
+                                                        supplyVoltage, clock);
+    wiringControl.attachEnergyMeter(energyMeter);
+}
+
+std::shared_ptr<const ThrusterEnergyMeter> Command_Interpreter_RPi5::energyAccounting() const {
+    return energyMeter;
+}
+
+void Command_Interpreter_RPi5::setDigitalPins(uint32_t enableMask, uint32_t disableMask) {
+    if (((enableMask | disableMask) & ~digitalPinMask) != 0) {
+        errorLog << "Ignoring pins that aren't digital pins in mask " << std::hex << ((enableMask | disableMask) &
+                                                                                       ~digitalPinMask)
+                 << std::dec << std::endl;
+    }
+    enableMask &= digitalPinMask;
+    disableMask &= digitalPinMask & ~enableMask;
+    // Active high pins go high when enabled, active low pins go low when enabled
+    uint32_t highMask = (enableMask & ~activeLowMask) | (disableMask & activeLowMask);
+    uint32_t lowMask = (enableMask & activeLowMask) | (disableMask & ~activeLowMask);
+    wiringControl.digitalWriteMask(highMask, lowMask);
+}
+
+uint32_t Command_Interpreter_RPi5::enabledDigitalPins() {
+    return (wiringControl.digitalReadMask() ^ activeLowMask) & digitalPinMask;
+}
+
+PicoConnection::Statistics Command_Interpreter_RPi5::connectionStatistics() {
+    if (wiringControl.picoConnection() == nullptr) {
+        return PicoConnection::Statistics{0, 0, 0, std::chrono::microseconds(0), std::chrono::microseconds(0),
+                                          false};
+    }
+    return wiringControl.picoConnection()->statistics();
+}
+
+LinkStats Command_Interpreter_RPi5::linkStatistics() {
+    return wiringControl.linkStatistics();
+}
+
+double Command_Interpreter_RPi5::maxThrusterUpdateRate() {
+    std::size_t bytesPerUpdate = 0;
+    char message[maxMessageLength];
+    for (const PwmPin &pin: thrusterPins) {
+        // Every pulse width in range has four digits, so any value gives the length of a real update
+        bytesPerUpdate += formatPwmMessage(message, pin.getGpioNumber(), 1500);
+    }
+    return maxUpdateRate(wiringControl.linkStatistics(), bytesPerUpdate);
+}
+
+void Command_Interpreter_RPi5::enableCoalescing() {
+    wiringControl.enableCoalescing();
+}
+
+void Command_Interpreter_RPi5::flush() {
+    wiringControl.flushCoalesced();
+}
+
+CoalescingWriter::Statistics Command_Interpreter_RPi5::coalescingStatistics() {
+    if (wiringControl.coalescer() == nullptr) {
+        return CoalescingWriter::Statistics{0, 0, 0};
+    }
+    return wiringControl.coalescer()->statistics();
+}
+
+void Command_Interpreter_RPi5::enableWatchdog(std::chrono::milliseconds deadline) {
+    if (watchdog != nullptr) {
+        watchdog->disarm();
+    }
+    watchdog.reset(new ThrusterWatchdog(deadline));
+    std::vector<int> pinNumbers = thrusterPinNumbers();
+    if (!watchdog->arm(pinNumbers, [this, pinNumbers](const char *frame, std::size_t length) {
+        // Cached first, so that reconnecting to the Pico after a trip restores neutral rather than the old thrust
+        for (int pinNumber: pinNumbers) {
+            wiringControl.setCachedPwm(pinNumber, 1500);
+        }
+        wiringControl.writeFrame(frame, length);
+    })) {
+        errorLog << "Unable to arm thruster watchdog!" << std::endl;
+        exit(42);
+    }
+}
+
+ThrusterWatchdog::Statistics Command_Interpreter_RPi5::watchdogStatistics() {
+    if (watchdog == nullptr) {
+        return ThrusterWatchdog::Statistics{0, std::chrono::nanoseconds(0), std::chrono::nanoseconds(0)};
+    }
+    return watchdog->statistics();
+}
+
+void Command_Interpreter_RPi5::checkWatchdog() {
+    if (watchdog == nullptr || !watchdog->consumeTrip()) {
+        return;
+    }
+    errorLog << "No command received within the watchdog deadline; thrusters were set to neutral." << std::endl;
+    if (metrics != nullptr) {
+        watchdogTrips->add();
+    }
+    for (const PwmPin &pin: thrusterPins) {
+        wiringControl.setCachedPwm(pin.getGpioNumber(), 1500);
+    }
+}
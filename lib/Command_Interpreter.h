@@ -3,8 +3,18 @@
 
 #include "Command.h"
 #include "Wiring.h"
+#include "Coalescing_Writer.h"
+#include "Watchdog.h"
+#include "Mission_Compiler.h"
+#include "Sequence_Upload.h"
+#include "Clock_Sync.h"
+#include "Sequence_Arena.h"
+#include "Metrics.h"
+#include "Energy_Accounting.h"
+#include "Interpreter_Clock.h"
 #include <vector>
 #include <fstream>
+#include <memory>
 
 ///@brief Whether a digital pin is active high or active low
 enum EnableType {
@@ -12,169 +22,150 @@ enum EnableType {
 };
 
 /*
- * NOTE: We may not need DigitalPin, in which case both DigitalPin and abstract Pin classes are not useful, and can
- * be replaced with just the HardwarePwmPin class (probably renamed to Pin). This would also necessitate the removal of allPins
- * and digitalPins data members from Command_Interpreter_RPi5. Additionally, we probably won't use SoftwarePWM.
+ * Pins are small value types: a GPIO number and what the pin is used for. Their state lives in WiringControl, and the
+ * Command Interpreter logs on their behalf, so the interpreter can keep them by value in contiguous arrays.
  */
 
-/// @brief A Raspberry Pi Pico GPIO pin, as specified by its GPIO pin number (see https://pico.pinout.xyz/)
-class Pin {
-protected:
-    int gpioNumber{};
-    std::ostream &output;
-    std::ostream &outLog;
-    std::ostream &errorLog;
-public:
-    /// @brief Initializes pin through Wiring Control class (i.e. to output, PWM, etc.)
-    virtual void initialize(WiringControl &wiringControl) = 0;
-
-    /// @brief Sets pin to maximum (positive) power
-    virtual void enable(WiringControl &wiringControl) = 0;
-
-    /// @brief Sets pin to be unpowered (stopped)
-    virtual void disable(WiringControl &wiringControl) = 0;
-
-    /// @brief Whether a pin is currently powered (whether its power level is not zero)
-    /// @return True if power is not zero, false otherwise
-    virtual bool enabled(WiringControl &wiringControl) = 0;
-
-    /// @brief The pin's current state
-    /// @return The current pin status
-    virtual int read(WiringControl &wiringControl) = 0;
-
-    /// @param gpioNumber the Pico GPIO number for the pin (see https://pico.pinout.xyz/ and look for GPX labels in green)
-    /// @param output where you want output (not logging) messages to be sent (probably std::cout)
-    /// @param outLog where you want logging (not error) messages to be logged
-    /// @param errorLog where you want error messages to be logged
-    explicit Pin(int gpioNumber, std::ostream &output, std::ostream &outLog, std::ostream &errorLog) : gpioNumber(
-            gpioNumber),
-                                                                                                          output(output),
-                                                                                                          outLog(outLog),
-                                                                                                          errorLog(
-                                                                                                                  errorLog) {}
-
-    virtual ~Pin() = default;
-};
-
 /// @brief A digital (two-state) Raspberry Pi Pico GPIO pin
-class DigitalPin : public Pin {
+class DigitalPin {
 private:
+    int gpioNumber;
     EnableType enableType;
+
 public:
-    void initialize(WiringControl &wiringControl) override;
+    /// @brief Configures the pin as a digital output on the Pico and disables it
+    void initialize(WiringControl &wiringControl) const;
+
+    void enable(WiringControl &wiringControl) const;
 
-    void enable(WiringControl &wiringControl) override;
+    void disable(WiringControl &wiringControl) const;
 
-    void disable(WiringControl &wiringControl) override;
+    /// @brief Whether the pin is currently enabled, honoring its active high/low setting
+    bool enabled(const WiringControl &wiringControl) const;
 
-    bool enabled(WiringControl &wiringControl) override;
+    /// @brief The pin's current level
+    /// @return 1 if the pin is high, 0 if it is low
+    int read(const WiringControl &wiringControl) const;
 
-    int read(WiringControl &wiringControl) override;
+    /// @brief The pin's Pico GPIO number
+    int getGpioNumber() const;
+
+    /// @brief Whether the pin is active high or active low
+    EnableType getEnableType() const;
 
     /// @param gpioNumber the Pico GPIO number for the pin (see https://pico.pinout.xyz/ and look for GPX labels in green)
     /// @param enableType whether the pin is active high or active low
-    /// @param output where you want output (not logging) messages to be sent (probably std::cout)
-    /// @param outLog where you want logging (not error) messages to be logged
-    /// @param errorLog where you want error messages to be logged
-    DigitalPin(int gpioNumber, EnableType enableType, std::ostream &output, std::ostream &outLog,
-               std::ostream &errorLog) : Pin(gpioNumber, output, outLog, errorLog), enableType(enableType) {};
+    DigitalPin(int gpioNumber, EnableType enableType) : gpioNumber(gpioNumber), enableType(enableType) {}
 };
 
-/// @brief A PWM pin which may or may not be hardware-supported
-class PwmPin : public Pin {
+/// @brief A pwm pin driving a thruster, which may or may not be hardware-supported. Construct it as a HardwarePwmPin
+/// or SoftwarePwmPin.
+class PwmPin {
 protected:
-    /// @brief Sets pin to the specified pwm value and direction
-    /// @param pwmValue a pwm value dictating the power and direction for the thruster
-    virtual void setPowerAndDirection(int pwmValue, WiringControl &wiringControl) = 0;
+    int gpioNumber;
+    PinType pinType; // HardwarePWM or SoftwarePWM
 
-public:
-    /// @brief Sets pin to given pwm frequency
-    /// @param frequency the desired frequency, between 1100 and 1900
-    virtual void setPwm(int frequency, WiringControl &wiringControl);
+    PwmPin(int gpioNumber, PinType pinType) : gpioNumber(gpioNumber), pinType(pinType) {}
 
-    /// @param gpioNumber the Pico GPIO number for the pin (see https://pico.pinout.xyz/ and look for GPX labels in green)
-    /// @param output where you want output (not logging) messages to be sent (probably std::cout)
-    /// @param outLog where you want logging (not error) messages to be logged
-    /// @param errorLog where you want error messages to be logged
-    explicit PwmPin(int gpioNumber, std::ostream &output, std::ostream &outLog, std::ostream &errorLog) : Pin(
-            gpioNumber, output, outLog, errorLog) {}
+public:
+    /// @brief Configures the pin for pwm on the Pico and sets it to 1500
+    void initialize(WiringControl &wiringControl) const;
 
-    virtual ~PwmPin() = default;
-};
+    /// @brief Sets pin to maximum (positive) power
+    void enable(WiringControl &wiringControl) const;
 
-/// @brief a pwm-capable Raspberry Pi Pico GPIO pin (supports analogue output)
-class HardwarePwmPin : public PwmPin {
-protected:
-    /// @brief Sets pin to the specified pwm value and direction
-    /// @param pwmValue a pwm value dictating the power and direction for the thruster
-    void setPowerAndDirection(int pwmValue, WiringControl &wiringControl) override;
+    /// @brief Sets pin to be unpowered (stopped)
+    void disable(WiringControl &wiringControl) const;
 
-public:
-    void initialize(WiringControl &wiringControl) override;
+    /// @brief Whether the pin's power level is not zero
+    bool enabled(const WiringControl &wiringControl) const;
 
-    void enable(WiringControl &wiringControl) override;
+    /// @brief Sets pin to the given pwm value, which dictates the power and direction of the thruster
+    /// @param pulseWidth the pwm value, between 1100 and 1900
+    void setPwm(int pulseWidth, WiringControl &wiringControl) const;
 
-    void disable(WiringControl &wiringContro) override;
+    /// @brief The pin's current pwm value
+    int read(const WiringControl &wiringControl) const;
 
-    bool enabled(WiringControl &wiringControl) override;
+    /// @brief The pin's Pico GPIO number
+    int getGpioNumber() const;
 
-    int read(WiringControl &wiringControl) override;
+    /// @brief HardwarePWM or SoftwarePWM
+    PinType getPinType() const;
+};
 
+/// @brief a pwm-capable Raspberry Pi Pico GPIO pin (supports analogue output)
+class HardwarePwmPin : public PwmPin {
+public:
     /// @param gpioNumber the Pico GPIO number for the pin (see https://pico.pinout.xyz/ and look for GPX labels in green)
-    /// @param output where you want output (not logging) messages to be sent (probably std::cout)
-    /// @param outLog where you want logging (not error) messages to be logged
-    /// @param errorLog where you want error messages to be logged
-    explicit HardwarePwmPin(int gpioNumber, std::ostream &output, std::ostream &outLog, std::ostream &errorLog)
-            : PwmPin(gpioNumber, output, outLog, errorLog) {};
+    explicit HardwarePwmPin(int gpioNumber) : PwmPin(gpioNumber, HardwarePWM) {}
 };
 
 /// @brief a Raspberry Pi Pico GPIO pin that doesn't natively support PWM, but that will simulate analogue output
 /// through software pwm control.
 class SoftwarePwmPin : public PwmPin {
 public:
-    void initialize(WiringControl &wiringControl) override;
-
-    void enable(WiringControl &wiringControl) override;
-
-    void disable(WiringControl &wiringControl) override;
-
-    bool enabled(WiringControl &wiringControl) override;
-
-    /// @brief Sets pin to the specified pwm value and direction
-    /// @param pwmValue a pwm value dictating the power and direction for the thruster
-    void setPowerAndDirection(int pwmValue, WiringControl &wiringControl) override;
-
-    int read(WiringControl &wiringControl) override;
-
     /// @param gpioNumber the Pico GPIO number for the pin (see https://pico.pinout.xyz/ and look for GPX labels in green)
-    /// @param output where you want output (not logging) messages to be sent (probably std::cout)
-    /// @param outLog where you want logging (not error) messages to be logged
-    /// @param errorLog where you want error messages to be logged
-    explicit SoftwarePwmPin(int gpioNumber, std::ostream &output, std::ostream &outLog, std::ostream &errorLog)
-            : PwmPin(gpioNumber, output, outLog, errorLog) {};
+    explicit SoftwarePwmPin(int gpioNumber) : PwmPin(gpioNumber, SoftwarePWM) {}
 };
 
+// Pins are stored as PwmPin, so the pin classes must not add anything that would be sliced off
+static_assert(sizeof(HardwarePwmPin) == sizeof(PwmPin) && sizeof(SoftwarePwmPin) == sizeof(PwmPin),
+              "Pin classes only choose the pin type");
+
 /// @brief The purpose of this class is toggle the GPIO pins on the Raspberry Pi based on a command object.
 /// Requires information about wiring, etc.
 class Command_Interpreter_RPi5 {
 private:
-    std::vector<Pin *> allPins();
-
-    std::vector<PwmPin *> thrusterPins;
-    std::vector<DigitalPin *> digitalPins;
+    std::vector<PwmPin> thrusterPins; // In thruster order, stored contiguously
+    std::vector<DigitalPin> digitalPins;
     WiringControl wiringControl;
     std::ostream &output;
     std::ostream &outLog;
     std::ostream &errorLog;
+    std::unique_ptr<ThrusterWatchdog> watchdog;
+    std::unique_ptr<TimestampedSender> timestampedSender;
+    uint32_t digitalPinMask = 0; // Bit n is set if GPIO n is one of the digital pins
+    uint32_t activeLowMask = 0; // Bit n is set if GPIO n is an active low digital pin
+    std::shared_ptr<MetricsRegistry> metrics;
+    Counter *commandsExecuted = nullptr;
+    Histogram *commandLatency = nullptr;
+    Counter *watchdogTrips = nullptr;
+    std::shared_ptr<ThrusterEnergyMeter> energyMeter;
+    std::shared_ptr<InterpreterClock> clock = std::make_shared<SteadyInterpreterClock>();
+
+    /// @brief Bring the cached pin states up to date if the watchdog has driven the thrusters to neutral
+    void checkWatchdog();
+
+    /// @brief Keep the watchdog from tripping while a command is written and fed (holds nothing without a watchdog)
+    std::unique_lock<std::mutex> holdOffWatchdog();
+
+    /// @brief Sleep until the given time, feeding the watchdog along the way
+    /// @param timeSource the clock time is on
+    void waitUntil(std::chrono::steady_clock::time_point time, InterpreterClock &timeSource);
+
+    /// @brief Whether a timeline is valid, was compiled for this interpreter's thruster pins and doesn't target
+    /// software pwm pins generated on the Pi (logs why if not)
+    bool canExecute(const MissionTimeline &timeline);
+
+    /// @brief execute(timeline) with timestamped frames, each sent ahead of its time by the measured latency
+    bool executeTimestamped(const MissionTimeline &timeline);
+
+    /// @brief The GPIO numbers of the thruster pins, in thruster order
+    std::vector<int> thrusterPinNumbers();
+
+    /// @brief blind_execute every command in [begin, end)
+    void blindExecuteCommands(const Command *begin, const Command *end);
 
 public:
-    /// @param thrusterPins the PWM pins that will drive robot thrusters
+    /// @param thrusterPins the PWM pins that will drive robot thrusters, e.g. {HardwarePwmPin(4), ...}. The interpreter
+    /// keeps its own copy.
     /// @param digitalPins non-PWM pins to be used for digital (2-state) output
     /// @param output where you want output (not logging) messages to be sent (probably std::cout)
-    /// @param outLog where you want logging (not error) messages to be logged
-    /// @param errorLog where you want error messages to be logged
-    explicit Command_Interpreter_RPi5(std::vector<PwmPin *> thrusterPins,
-                                      std::vector<DigitalPin *> digitalPins,
+    /// @param outLog where you want logging (not error) messages to be logged, for the interpreter and its pins
+    /// @param errorLog where you want error messages to be logged, for the interpreter and its pins
+    explicit Command_Interpreter_RPi5(std::vector<PwmPin> thrusterPins,
+                                      std::vector<DigitalPin> digitalPins,
                                       const WiringControl &wiringControl, std::ostream &output,
                                       std::ostream &outLog, std::ostream &errorLog);
 
@@ -190,10 +181,133 @@ public:
     /// @param command a command struct with three sub-components: the acceleration, steady-state, and deceleration.
     void blind_execute(const CommandComponent &command);
 
+    /// @brief Switch thruster writes to "latest wins" mode, so that when commands arrive faster than the serial link
+    /// can carry them only the newest value for each thruster is sent. Call after initializePins().
+    void enableCoalescing();
+
+    /// @brief Block until every thruster value given so far has been sent to the Pico. Only needed in coalescing mode.
+    void flush();
+
+    /// @brief Count executed commands, time how long each takes to send, and count watchdog trips in registry, along
+    /// with what WiringControl::attachMetrics() tracks. Call before initializePins() and enableCoalescing().
+    /// @param registry where the metrics are registered (e.g. one served by a MetricsServer)
+    void attachMetrics(std::shared_ptr<MetricsRegistry> registry);
+
+    /// @brief Time blind_execute, execute(timeline) and the supervision of onboard_execute with clock instead of
+    /// steady_clock, e.g. a ManualClock so that timed commands run instantly in tests. Timestamped playback is timed
+    /// against the Pico's clock, so it keeps using steady_clock.
+    /// @param clock where the time comes from and how it is waited for
+    void useClock(std::shared_ptr<InterpreterClock> clock);
+
+    /// @brief Start estimating each thruster's energy use, heat load and time at throttle from every pwm change from
+    /// now on (commands, timelines, and the watchdog driving the thrusters to neutral), for battery and thermal
+    /// budgeting. Calling it again starts over from zero. The meter keeps time by the interpreter's clock, so call
+    /// useClock() first.
+    /// @param model gives the current each thruster draws at each pwm value
+    /// @param batteryWattHours the battery's usable energy when full
+    /// @param supplyVoltage the battery voltage the thrusters run at
+    void enableEnergyAccounting(const ThrustModel &model, double batteryWattHours, float supplyVoltage = 16);
+
+    /// @brief The running energy totals, which any thread can read without blocking the interpreter
+    /// @return The meter, or nullptr if energy accounting isn't enabled
+    std::shared_ptr<const ThrusterEnergyMeter> energyAccounting() const;
+
+    /// @brief How many thruster values have been merged away in coalescing mode
+    /// @return The merge counters, all zero if coalescing isn't enabled
+    CoalescingWriter::Statistics coalescingStatistics();
+
+    /// @brief Start a watchdog that drives every thruster to neutral (1500) if no command is executed within the
+    /// deadline. Executing any command (including waiting out a blind_execute) counts as a fresh command. Call after
+    /// initializePins().
+    /// @param deadline how long the thrusters may go without a fresh command
+    void enableWatchdog(std::chrono::milliseconds deadline);
+
+    /// @brief How often the watchdog has tripped and how quickly it reacted
+    /// @return The watchdog's statistics, all zero if it isn't enabled
+    ThrusterWatchdog::Statistics watchdogStatistics();
+
+    /// @brief Executes every component of every command in a sequence, one after another, using blind_execute.
+    /// @param sequence the commands to execute, in order
+    void blind_execute(const Sequence &sequence);
+
+    /// @brief Same as blind_execute(const Sequence &), for a sequence built in an arena. The interpreter takes the
+    /// sequence over, so neither building nor executing it allocates memory on the heap.
+    /// @param sequence the commands to execute, in order
+    void blind_execute(ArenaSequence &&sequence);
+
+    /// @brief Validates a sequence and compiles it for this interpreter's thruster pins, so that it can be executed
+    /// (or saved and loaded later) without re-validating or re-formatting anything.
+    /// @param sequence the sequence to compile
+    /// @param timeline where the compiled timeline is stored
+    /// @return True if the sequence is valid, false otherwise (the reason is written to errorLog)
+    bool compile(const Sequence &sequence, MissionTimeline &timeline);
+
+    /// @brief Same as compile(const Sequence &, MissionTimeline &), for a sequence built in an arena
+    bool compile(const ArenaSequence &sequence, MissionTimeline &timeline);
+
+    /// @brief Executes a compiled timeline: waits for each entry's time and sends its preformatted messages. Like
+    /// blind_execute, returns once the last component's duration is over and does not stop the thrusters.
+    /// @param timeline a timeline compiled (or loaded) for this interpreter's thruster pins
+    /// @return False if the timeline wasn't compiled for these thruster pins or some of them are software pwm pins
+    /// generated by a SoftwarePwmEngine (nothing is sent), true otherwise
+    bool execute(const MissionTimeline &timeline);
+
+    /// @brief Synchronize with the Pico's clock and from then on send each entry of a timeline ahead of time, stamped
+    /// with the Pico time at which it should take effect, so that execute(timeline) changes the thrusters at known
+    /// instants regardless of serial latency. The clocks are synchronized again at the start of every timeline.
+    /// Call after initializePins().
+    /// @return True if the Pico answered the clock synchronization, false otherwise (frames are then sent untimed)
+    bool enableTimestampedFrames();
+
+    /// @brief How the Pico's clock relates to ours, as last measured
+    /// @return The estimate, with valid set to false if timestamped frames aren't enabled
+    ClockEstimate picoClock();
+
+    /// @brief How far from their requested time the Pico has applied timestamped frames
+    /// @return The statistics, all zero if timestamped frames aren't enabled
+    TimestampedSender::Statistics applicationTimeStatistics();
+
+    /// @brief Uploads a compiled timeline to the Pico and has the Pico play it back, so every step starts exactly on
+    /// time regardless of the Pi's scheduling. Returns once playback is over, having checked along the way that the
+    /// Pico kept up. If the Pico stops reporting, playback is aborted (every thruster goes to 1500).
+    /// @param timeline a timeline compiled (or loaded) for this interpreter's thruster pins
+    /// @return True if the whole timeline was played, false otherwise (the reason is written to errorLog)
+    bool onboard_execute(const MissionTimeline &timeline);
+
+    /// @brief Compiles a sequence and plays it back on the Pico. See onboard_execute(const MissionTimeline &).
+    /// @param sequence the commands to execute, in order
+    /// @return True if the whole sequence was played, false otherwise (the reason is written to errorLog)
+    bool onboard_execute(const Sequence &sequence);
+
+    /// @brief Same as onboard_execute(const Sequence &), for a sequence built in an arena
+    bool onboard_execute(ArenaSequence &&sequence);
+
+    /// @brief Enables and disables several digital pins at once, honoring each pin's active high/low setting. All of
+    /// the changes are sent to the Pico in a single frame.
+    /// @param enableMask bit n set means the digital pin at GPIO n is enabled
+    /// @param disableMask bit n set means the digital pin at GPIO n is disabled. Pins in both masks are enabled
+    void setDigitalPins(uint32_t enableMask, uint32_t disableMask);
+
+    /// @brief Which digital pins are currently enabled
+    /// @return A word where bit n is set if the digital pin at GPIO n is enabled
+    uint32_t enabledDigitalPins();
+
+    /// @brief How often the connection to the Pico has been lost and how quickly it was restored
+    /// @return The statistics, all zero if there is no connection (e.g. in mock mode)
+    PicoConnection::Statistics connectionStatistics();
+
+    /// @brief What is known about the link to the Pico: measured if it was negotiated, nominal otherwise
+    LinkStats linkStatistics();
+
+    /// @brief The fastest rate at which all 8 thrusters can be updated over the current link to the Pico. Commands
+    /// given faster than this queue up behind each other (or are merged, in coalescing mode).
+    /// @return Full thruster updates per second
+    double maxThrusterUpdateRate();
+
     /// @brief Get the current pwm values of all the pins.
     /// @return A vector containing the current value of all pins. PWM pins will return a value in the range [1100, 1900]
     std::vector<int> readPins();
 
-    ~Command_Interpreter_RPi5(); //TODO this also deletes all its pins. Not sure if this is desirable or not?
+    ~Command_Interpreter_RPi5();
 };
 
@@ -0,0 +1,151 @@
+#include "Energy_Accounting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+constexpr int ThrusterUsage::throttleBands;
+
+namespace {
+    /// @brief Distance from neutral to full throttle, in us
+    constexpr float fullThrottleUs = 400;
+}
+
+ThrusterEnergyMeter::ThrusterEnergyMeter(const ThrustModel &model, const std::vector<int> &thrusterPins,
+                                         double batteryWattHours, float supplyVoltage,
+                                         std::chrono::steady_clock::time_point start) :
+        ThrusterEnergyMeter(model, thrusterPins, batteryWattHours, supplyVoltage, start,
+                            std::make_shared<SteadyInterpreterClock>()) {}
+
+ThrusterEnergyMeter::ThrusterEnergyMeter(const ThrustModel &model, const std::vector<int> &thrusterPins,
+                                         double batteryWattHours, float supplyVoltage,
+                                         std::shared_ptr<InterpreterClock> clock) :
+        ThrusterEnergyMeter(model, thrusterPins, batteryWattHours, supplyVoltage, clock->now(), clock) {}
+
+ThrusterEnergyMeter::ThrusterEnergyMeter(const ThrustModel &model, const std::vector<int> &thrusterPins,
+                                         double batteryWattHours, float supplyVoltage,
+                                         std::chrono::steady_clock::time_point start,
+                                         std::shared_ptr<InterpreterClock> clock) :
+        model(model), supplyVoltage(supplyVoltage), batteryJoules(batteryWattHours * 3600),
+        thrusterCount(static_cast<int>(std::min<std::size_t>(thrusterPins.size(), 8))), clock(std::move(clock)) {
+    std::fill(std::begin(thrusterIndex), std::end(thrusterIndex), -1);
+    for (int thruster = 0; thruster < thrusterCount; thruster++) {
+        int pinNumber = thrusterPins[thruster];
+        if (pinNumber >= 0 && pinNumber < 32) {
+            thrusterIndex[pinNumber] = thruster;
+        }
+    }
+    for (Account &account: accounts) {
+        account = Account{};
+        account.lastChangeNs = toNs(start);
+        account.pulseWidth = 1500;
+        account.amps = model.current(1500);
+    }
+    for (int thruster = 0; thruster < 8; thruster++) {
+        published[thruster].write(accounts[thruster]);
+    }
+}
+
+int64_t ThrusterEnergyMeter::toNs(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+int ThrusterEnergyMeter::throttleBand(int pulseWidth) const {
+    const ThrusterCurve &curve = model.thrusterCurve();
+    float offset = std::fabs(static_cast<float>(pulseWidth) - curve.neutralUs);
+    if (offset <= curve.deadbandUs) {
+        return 0;
+    }
+    int quarter = static_cast<int>((offset - curve.deadbandUs) * 4 / (fullThrottleUs - curve.deadbandUs));
+    return 1 + std::min(quarter, ThrusterUsage::throttleBands - 2);
+}
+
+void ThrusterEnergyMeter::record(int pinNumber, int pulseWidth, std::chrono::steady_clock::time_point time) {
+    if (pinNumber < 0 || pinNumber >= 32 || thrusterIndex[pinNumber] < 0) {
+        return;
+    }
+    int thruster = thrusterIndex[pinNumber];
+    Account &account = accounts[thruster];
+    if (pulseWidth == account.pulseWidth) {
+        // The running interval simply continues
+        return;
+    }
+    int64_t nowNs = std::max(toNs(time), account.lastChangeNs);
+    int64_t elapsedNs = nowNs - account.lastChangeNs;
+    double seconds = elapsedNs * 1e-9;
+    account.joules += supplyVoltage * account.amps * seconds;
+    account.coulombs += account.amps * seconds;
+    account.heatLoad += static_cast<double>(account.amps) * account.amps * seconds;
+    account.nsAtThrottle[throttleBand(account.pulseWidth)] += elapsedNs;
+    account.lastChangeNs = nowNs;
+    account.pulseWidth = pulseWidth;
+    account.amps = model.current(static_cast<float>(pulseWidth));
+    published[thruster].write(account);
+}
+
+int ThrusterEnergyMeter::size() const {
+    return thrusterCount;
+}
+
+ThrusterUsage ThrusterEnergyMeter::extrapolate(const Account &account, int64_t nowNs) const {
+    int64_t elapsedNs = std::max<int64_t>(nowNs - account.lastChangeNs, 0);
+    double seconds = elapsedNs * 1e-9;
+    ThrusterUsage usage{};
+    usage.pulseWidth = account.pulseWidth;
+    usage.watts = supplyVoltage * account.amps;
+    usage.joules = account.joules + usage.watts * seconds;
+    usage.coulombs = account.coulombs + account.amps * seconds;
+    usage.heatLoad = account.heatLoad + static_cast<double>(account.amps) * account.amps * seconds;
+    for (int band = 0; band < ThrusterUsage::throttleBands; band++) {
+        usage.secondsAtThrottle[band] = account.nsAtThrottle[band] * 1e-9;
+    }
+    usage.secondsAtThrottle[throttleBand(account.pulseWidth)] += seconds;
+    return usage;
+}
+
+void ThrusterEnergyMeter::record(int pinNumber, int pulseWidth) {
+    record(pinNumber, pulseWidth, clock->now());
+}
+
+ThrusterUsage ThrusterEnergyMeter::usage(int thruster, std::chrono::steady_clock::time_point now) const {
+    if (thruster < 0 || thruster >= thrusterCount) {
+        return ThrusterUsage{};
+    }
+    Account account;
+    published[thruster].read(account);
+    return extrapolate(account, toNs(now));
+}
+
+ThrusterUsage ThrusterEnergyMeter::usage(int thruster) const {
+    return usage(thruster, clock->now());
+}
+
+double ThrusterEnergyMeter::totalJoules(std::chrono::steady_clock::time_point now) const {
+    double joules = 0;
+    for (int thruster = 0; thruster < thrusterCount; thruster++) {
+        joules += usage(thruster, now).joules;
+    }
+    return joules;
+}
+
+double ThrusterEnergyMeter::totalJoules() const {
+    return totalJoules(clock->now());
+}
+
+double ThrusterEnergyMeter::totalWatts() const {
+    double watts = 0;
+    for (int thruster = 0; thruster < thrusterCount; thruster++) {
+        Account account;
+        published[thruster].read(account);
+        watts += supplyVoltage * account.amps;
+    }
+    return watts;
+}
+
+double ThrusterEnergyMeter::remainingJoules(std::chrono::steady_clock::time_point now) const {
+    return batteryJoules - totalJoules(now);
+}
+
+double ThrusterEnergyMeter::remainingJoules() const {
+    return remainingJoules(clock->now());
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Interpreter_Clock.h"
+#include "Seqlock.h"
+#include "Thrust_Model.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// @brief What one thruster has used since accounting started, as of the time it was read
+struct ThrusterUsage {
+    static constexpr int throttleBands = 5;
+
+    int pulseWidth; // The thruster's current pwm value
+    double watts; // Estimated power at the current pwm value
+    double joules; // Estimated energy used
+    double coulombs; // Estimated charge drawn (divide by 3600 for amp hours)
+    double heatLoad; // Integral of current squared over time, in A^2 s. Resistive heating in the motor and ESC grows
+                     // with this
+    // Seconds spent in each throttle band: in the deadband (no thrust), then each quarter of the range beyond it, in
+    // either direction
+    std::array<double, throttleBands> secondsAtThrottle;
+};
+
+/// @brief Keeps running totals of the estimated energy, charge, heat load and time at throttle of each thruster,
+/// using the current that ThrustModel predicts for each pwm value. Each pwm change folds the time since the previous
+/// change into the totals, so updating costs the same however long the dive has been. Totals are published through a
+/// seqlock per thruster, so any thread can read them (including the interval still in progress) without a lock.
+class ThrusterEnergyMeter {
+private:
+    /// @brief The totals up to a thruster's last pwm change
+    struct Account {
+        int64_t lastChangeNs;
+        int32_t pulseWidth;
+        float amps;
+        double joules;
+        double coulombs;
+        double heatLoad;
+        int64_t nsAtThrottle[ThrusterUsage::throttleBands];
+    };
+
+    ThrustModel model;
+    float supplyVoltage;
+    double batteryJoules;
+    int thrusterCount;
+    int thrusterIndex[32]; // Indexed by GPIO number, -1 for pins that aren't thrusters
+    Account accounts[8]; // The writer's copy
+    Seqlock<Account> published[8];
+    std::shared_ptr<InterpreterClock> clock; // Gives the time to calls that don't pass one
+
+    ThrusterEnergyMeter(const ThrustModel &model, const std::vector<int> &thrusterPins, double batteryWattHours,
+                        float supplyVoltage, std::chrono::steady_clock::time_point start,
+                        std::shared_ptr<InterpreterClock> clock);
+
+    int throttleBand(int pulseWidth) const;
+
+    /// @brief The account as of now, including the time since its last change
+    ThrusterUsage extrapolate(const Account &account, int64_t nowNs) const;
+
+    static int64_t toNs(std::chrono::steady_clock::time_point time);
+
+public:
+    /// @param model gives the current drawn at each pwm value
+    /// @param thrusterPins the GPIO number of each thruster (at most 8), in thruster order. Every thruster starts at
+    /// 1500 when the meter is created.
+    /// @param batteryWattHours the battery's usable energy when full
+    /// @param supplyVoltage the battery voltage the thrusters run at (the default matches ThrustModel's curve)
+    /// @param start when accounting starts. Calls that don't pass a time use steady_clock.
+    ThrusterEnergyMeter(const ThrustModel &model, const std::vector<int> &thrusterPins, double batteryWattHours,
+                        float supplyVoltage = 16,
+                        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now());
+
+    /// @brief A meter that keeps time by clock, starting at its current time. The Command Interpreter passes its own
+    /// clock, so a ManualClock's waits are charged for just as real ones would be.
+    ThrusterEnergyMeter(const ThrustModel &model, const std::vector<int> &thrusterPins, double batteryWattHours,
+                        float supplyVoltage, std::shared_ptr<InterpreterClock> clock);
+
+    ThrusterEnergyMeter(const ThrusterEnergyMeter &) = delete;
+
+    ThrusterEnergyMeter &operator=(const ThrusterEnergyMeter &) = delete;
+
+    /// @brief Note that a pin's pwm value changed. Pins that aren't thrusters are ignored. Calls must not overlap
+    /// (WiringControl makes them while holding its state lock) and their times must not go backwards.
+    /// @param pinNumber the GPIO number of the pin
+    /// @param pulseWidth its new pwm value
+    /// @param time when the change happened
+    void record(int pinNumber, int pulseWidth, std::chrono::steady_clock::time_point time);
+
+    /// @brief Note that a pin's pwm value changed just now, by the meter's clock
+    void record(int pinNumber, int pulseWidth);
+
+    /// @brief How many thrusters are accounted for
+    int size() const;
+
+    /// @brief What a thruster has used up to the given time. Safe to call from any thread.
+    /// @param thruster the thruster's index, in the order the pins were given
+    ThrusterUsage usage(int thruster, std::chrono::steady_clock::time_point now) const;
+
+    /// @brief What a thruster has used up to now, by the meter's clock
+    ThrusterUsage usage(int thruster) const;
+
+    /// @brief The energy every thruster together has used up to the given time, in joules. Safe to call from any
+    /// thread.
+    double totalJoules(std::chrono::steady_clock::time_point now) const;
+
+    double totalJoules() const;
+
+    /// @brief The estimated power every thruster together is drawing right now, in watts
+    double totalWatts() const;
+
+    /// @brief How much of the battery is left for the thrusters, in joules (negative once it has been overdrawn)
+    double remainingJoules(std::chrono::steady_clock::time_point now) const;
+
+    double remainingJoules() const;
+};
@@ -0,0 +1,53 @@
+#include "Frame_Recorder.h"
+
+#include <cstdio>
+#include <utility>
+
+FrameRecorder::FrameRecorder(std::shared_ptr<InterpreterClock> clock) : clock(std::move(clock)) {}
+
+void FrameRecorder::record(const char *frame, std::size_t length) {
+    auto time = clock->now();
+    std::lock_guard<std::mutex> lock(framesMutex);
+    recorded.push_back(RecordedFrame{time, std::string(frame, length)});
+}
+
+std::vector<RecordedFrame> FrameRecorder::frames() const {
+    std::lock_guard<std::mutex> lock(framesMutex);
+    return recorded;
+}
+
+std::string FrameRecorder::text() const {
+    std::lock_guard<std::mutex> lock(framesMutex);
+    std::string bytes;
+    for (const RecordedFrame &frame: recorded) {
+        bytes += frame.bytes;
+    }
+    return bytes;
+}
+
+std::vector<RecordedPwm> FrameRecorder::pwmMessages() const {
+    std::vector<RecordedPwm> messages;
+    for (const RecordedFrame &frame: frames()) {
+        std::size_t start = 0;
+        while (start < frame.bytes.size()) {
+            std::size_t end = frame.bytes.find('\n', start);
+            if (end == std::string::npos) {
+                end = frame.bytes.size();
+            }
+            std::string line = frame.bytes.substr(start, end - start);
+            int pinNumber = 0;
+            int pulseWidth = 0;
+            char trailing = 0;
+            if (std::sscanf(line.c_str(), "Set %d PWM %d%c", &pinNumber, &pulseWidth, &trailing) == 2) {
+                messages.push_back(RecordedPwm{frame.time, pinNumber, pulseWidth});
+            }
+            start = end + 1;
+        }
+    }
+    return messages;
+}
+
+void FrameRecorder::clear() {
+    std::lock_guard<std::mutex> lock(framesMutex);
+    recorded.clear();
+}
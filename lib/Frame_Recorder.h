@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Interpreter_Clock.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// @brief One frame as it would have been written to the Pico
+struct RecordedFrame {
+    std::chrono::steady_clock::time_point time;
+    std::string bytes;
+};
+
+/// @brief A pwm message found in the recorded frames
+struct RecordedPwm {
+    std::chrono::steady_clock::time_point time;
+    int pinNumber;
+    int pulseWidth;
+};
+
+/// @brief An in-memory stand-in for the Pico. A WiringControl given one with recordFramesTo() appends every frame it
+/// would have sent here (from any thread, including the coalescing writer and the watchdog), stamped with the time
+/// from the recorder's clock. Each test can have its own recorder, so tests don't share stdout and can run in
+/// parallel.
+class FrameRecorder {
+private:
+    std::shared_ptr<InterpreterClock> clock;
+    mutable std::mutex framesMutex;
+    std::vector<RecordedFrame> recorded;
+
+public:
+    /// @param clock stamps each frame. Pass the interpreter's clock so the stamps match the times it waited for.
+    explicit FrameRecorder(std::shared_ptr<InterpreterClock> clock = std::make_shared<SteadyInterpreterClock>());
+
+    FrameRecorder(const FrameRecorder &) = delete;
+
+    FrameRecorder &operator=(const FrameRecorder &) = delete;
+
+    /// @brief Append a frame
+    void record(const char *frame, std::size_t length);
+
+    /// @brief A copy of every frame recorded so far, oldest first
+    std::vector<RecordedFrame> frames() const;
+
+    /// @brief Every byte recorded so far, as the Pico would have received them
+    std::string text() const;
+
+    /// @brief Every "Set <pin> PWM <value>" message recorded so far, oldest first, with the time of its frame
+    std::vector<RecordedPwm> pwmMessages() const;
+
+    /// @brief Forget everything recorded so far
+    void clear();
+};
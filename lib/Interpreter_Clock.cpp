@@ -0,0 +1,31 @@
+#include "Interpreter_Clock.h"
+
+#include <thread>
+
+std::chrono::steady_clock::time_point SteadyInterpreterClock::now() {
+    return std::chrono::steady_clock::now();
+}
+
+void SteadyInterpreterClock::sleepUntil(std::chrono::steady_clock::time_point time) {
+    std::this_thread::sleep_until(time);
+}
+
+ManualClock::ManualClock(std::chrono::steady_clock::time_point start) :
+        nowNs(std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count()) {}
+
+std::chrono::steady_clock::time_point ManualClock::now() {
+    return std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::nanoseconds(nowNs.load(std::memory_order_acquire))));
+}
+
+void ManualClock::sleepUntil(std::chrono::steady_clock::time_point time) {
+    int64_t targetNs = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    int64_t current = nowNs.load(std::memory_order_relaxed);
+    // Another thread may have moved the clock further already, and it never goes back
+    while (current < targetNs &&
+           !nowNs.compare_exchange_weak(current, targetNs, std::memory_order_acq_rel, std::memory_order_relaxed)) {}
+}
+
+void ManualClock::advance(std::chrono::nanoseconds duration) {
+    nowNs.fetch_add(duration.count(), std::memory_order_acq_rel);
+}
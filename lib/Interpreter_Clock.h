@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/// @brief Where the Command Interpreter gets the time from and how it waits for it. Normally that is steady_clock and
+/// a real sleep; tests substitute a ManualClock so timed commands finish instantly and at exactly the right times.
+class InterpreterClock {
+public:
+    virtual std::chrono::steady_clock::time_point now() = 0;
+
+    /// @brief Return once now() has reached time
+    virtual void sleepUntil(std::chrono::steady_clock::time_point time) = 0;
+
+    virtual ~InterpreterClock() = default;
+};
+
+/// @brief steady_clock, sleeping for real
+class SteadyInterpreterClock : public InterpreterClock {
+public:
+    std::chrono::steady_clock::time_point now() override;
+
+    void sleepUntil(std::chrono::steady_clock::time_point time) override;
+};
+
+/// @brief A clock that only moves when told to. Sleeping jumps straight to the time being waited for, so a two second
+/// command takes no real time. Safe to read and advance from several threads.
+class ManualClock : public InterpreterClock {
+private:
+    std::atomic<int64_t> nowNs;
+
+public:
+    /// @param start the time the clock starts at
+    explicit ManualClock(std::chrono::steady_clock::time_point start = std::chrono::steady_clock::time_point{});
+
+    std::chrono::steady_clock::time_point now() override;
+
+    /// @brief Move the clock forward to time. Does nothing if it is already there or past it.
+    void sleepUntil(std::chrono::steady_clock::time_point time) override;
+
+    /// @brief Move the clock forward by duration
+    void advance(std::chrono::nanoseconds duration);
+};
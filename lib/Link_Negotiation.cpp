@@ -0,0 +1,161 @@
+#include "Link_Negotiation.h"
+
+#include <string>
+#include <thread>
+
+namespace {
+    /// @brief An echo line that uses every printable character, so bit errors at the new rate show up
+    std::string echoLine(const std::string &tag) {
+        std::string line = "Echo " + tag + " ";
+        for (char character = '!'; character <= '~'; character++) {
+            line.push_back(character);
+        }
+        line.push_back('\n');
+        return line;
+    }
+
+    /// @brief Wait for the reply to an echo, skipping any other lines (e.g. the Pico's own echo of commands)
+    bool readEcho(PicoLink &link, const std::string &expected, std::chrono::steady_clock::time_point deadline) {
+        std::string line;
+        while (true) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now());
+            if (remaining.count() < 0 || !link.readLine(line, remaining)) {
+                return false;
+            }
+            if (line.compare(0, 5, "Echo ") == 0) {
+                return line + "\n" == expected;
+            }
+        }
+    }
+
+    bool verifyEchoes(PicoLink &link, const LinkNegotiationSettings &settings, std::chrono::microseconds &latency) {
+        std::chrono::nanoseconds total{0};
+        for (int i = 0; i < settings.verificationEchoes; i++) {
+            std::string line = echoLine("v" + std::to_string(i));
+            auto sent = std::chrono::steady_clock::now();
+            if (!link.writeBytes(line.data(), line.size()) || !readEcho(link, line, sent + settings.replyTimeout)) {
+                return false;
+            }
+            total += std::chrono::steady_clock::now() - sent;
+        }
+        if (settings.verificationEchoes > 0) {
+            latency = std::chrono::duration_cast<std::chrono::microseconds>(total / settings.verificationEchoes);
+        }
+        return true;
+    }
+
+    bool measureThroughput(PicoLink &link, const LinkNegotiationSettings &settings, int baudRate,
+                           double &bytesPerSecond) {
+        std::vector<std::string> lines;
+        std::string burst;
+        while (burst.size() < settings.throughputProbeBytes) {
+            lines.push_back(echoLine("t" + std::to_string(lines.size())));
+            burst += lines.back();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (!link.writeBytes(burst.data(), burst.size())) {
+            return false;
+        }
+        // The whole burst has to come back in about the time it takes to send at the nominal rate, so a Pico that
+        // stalls partway through doesn't hold up negotiation (and the reconnect that runs it) for long
+        auto transferTime = std::chrono::duration<double>(
+                static_cast<double>(burst.size()) / nominalLinkStats(baudRate).throughputBytesPerSecond);
+        auto deadline = start + std::chrono::duration_cast<std::chrono::microseconds>(transferTime) +
+                        settings.replyTimeout;
+        for (const std::string &line: lines) {
+            if (!readEcho(link, line, deadline)) {
+                return false;
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bytesPerSecond = elapsed > 0 ? static_cast<double>(burst.size()) / elapsed : 0;
+        return true;
+    }
+
+    bool verifyLink(PicoLink &link, const LinkNegotiationSettings &settings, LinkStats &stats) {
+        return verifyEchoes(link, settings, stats.roundTripLatency) &&
+               measureThroughput(link, settings, stats.baudRate, stats.throughputBytesPerSecond);
+    }
+}
+
+LinkStats nominalLinkStats(int baudRate) {
+    return LinkStats{baudRate, false, baudRate / 10.0, std::chrono::microseconds(0)};
+}
+
+LinkStats negotiateBaudRate(PicoLink &link, const LinkNegotiationSettings &settings, std::ostream &errorLog) {
+    LinkStats current = nominalLinkStats(settings.baseBaudRate);
+    link.discardInput();
+    if (!verifyLink(link, settings, current)) {
+        errorLog << "Pico did not echo at " << settings.baseBaudRate << " baud; staying there without negotiating"
+                 << std::endl;
+        return nominalLinkStats(settings.baseBaudRate);
+    }
+    current.verified = true;
+
+    for (int baudRate: settings.candidateBaudRates) {
+        unsigned int speed;
+        if (baudRate <= settings.baseBaudRate || !baudRateToSpeed(baudRate, speed)) {
+            continue;
+        }
+
+        std::string request = "Baud " + std::to_string(baudRate);
+        std::string requestLine = request + "\n";
+        if (!link.writeBytes(requestLine.data(), requestLine.size())) {
+            errorLog << "Unable to send baud rate request to the Pico" << std::endl;
+            break;
+        }
+        std::string reply;
+        bool answered = false;
+        auto deadline = std::chrono::steady_clock::now() + settings.replyTimeout;
+        while (std::chrono::steady_clock::now() < deadline &&
+               link.readLine(reply, std::chrono::duration_cast<std::chrono::milliseconds>(
+                       deadline - std::chrono::steady_clock::now()))) {
+            if (reply.compare(0, request.size() + 1, request + " ") == 0) {
+                answered = true;
+                break;
+            }
+        }
+        if (!answered) {
+            errorLog << "Pico does not support baud rate negotiation; staying at " << settings.baseBaudRate
+                     << " baud" << std::endl;
+            break;
+        }
+        if (reply != request + " OK") {
+            continue;
+        }
+
+        LinkStats candidate{baudRate, true, 0, std::chrono::microseconds(0)};
+        if (link.setBaudRate(baudRate)) {
+            std::this_thread::sleep_for(settings.settleTime);
+            link.discardInput();
+            if (verifyLink(link, settings, candidate)) {
+                return candidate;
+            }
+        }
+
+        errorLog << "Link failed verification at " << baudRate << " baud; falling back to "
+                 << settings.baseBaudRate << std::endl;
+        link.setBaudRate(settings.baseBaudRate);
+        // Give the Pico time to give up on the new rate too
+        std::string ignored;
+        auto revertDeadline = std::chrono::steady_clock::now() + settings.picoRevertTimeout;
+        while (std::chrono::steady_clock::now() < revertDeadline &&
+               link.readLine(ignored, std::chrono::duration_cast<std::chrono::milliseconds>(
+                       revertDeadline - std::chrono::steady_clock::now()))) {}
+        link.discardInput();
+        if (!verifyLink(link, settings, current)) {
+            errorLog << "Pico did not come back to " << settings.baseBaudRate << " baud!" << std::endl;
+            return nominalLinkStats(settings.baseBaudRate);
+        }
+    }
+    return current;
+}
+
+double maxUpdateRate(const LinkStats &stats, std::size_t bytesPerUpdate) {
+    if (bytesPerUpdate == 0) {
+        return 0;
+    }
+    return stats.throughputBytesPerSecond / static_cast<double>(bytesPerUpdate);
+}
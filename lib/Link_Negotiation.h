@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Pico_Link.h"
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+/*
+ * Baud rate negotiation with the Pico. The link always starts at defaultBaudRate, then:
+ *
+ *   Pi -> Pico  "Echo <text>\n"          Pico replies with the same line. Used to check the link works.
+ *   Pi -> Pico  "Baud <rate>\n"          Pico replies "Baud <rate> OK\n" and then switches to <rate>, or replies
+ *                                        "Baud <rate> Unsupported\n" and stays where it is.
+ *
+ * After switching, the Pi checks the new rate with a few echoes and a burst of echoes to measure throughput. If they
+ * don't come back intact, the Pi goes back to defaultBaudRate and tries the next (slower) rate. The Pico must go back
+ * to defaultBaudRate by itself if it hasn't received an intact line within one second of switching.
+ *
+ * A Pico that doesn't reply to "Echo" at all is left at defaultBaudRate.
+ */
+
+/// @brief The rate the Pico listens at after it starts up
+constexpr int defaultBaudRate = 115200;
+
+/// @brief What was measured about the link to the Pico
+struct LinkStats {
+    int baudRate;
+    bool verified; // Whether the Pico echoed correctly at baudRate. If not, the rest are nominal values
+    double throughputBytesPerSecond;
+    std::chrono::microseconds roundTripLatency;
+};
+
+struct LinkNegotiationSettings {
+    std::vector<int> candidateBaudRates = {2000000, 1000000, 921600, 460800, 230400}; // Fastest first
+    int baseBaudRate = defaultBaudRate;
+    std::chrono::milliseconds replyTimeout{200};
+    std::chrono::milliseconds settleTime{20}; // How long to wait after switching rates before talking
+    std::chrono::milliseconds picoRevertTimeout{1000}; // How long the Pico waits before going back to the base rate
+    int verificationEchoes = 3;
+    std::size_t throughputProbeBytes = 4096;
+};
+
+/// @brief What a link at the given rate should manage without measuring it: 10 bits per byte (8N1), no latency
+LinkStats nominalLinkStats(int baudRate);
+
+/// @brief Find the fastest rate that the Pico and the link both handle reliably, and leave both ends at it
+/// @param link the connection to the Pico, currently at settings.baseBaudRate
+/// @param settings which rates to try and how long to wait
+/// @param errorLog where failures are described
+/// @return The rate the link was left at and what was measured at it
+LinkStats negotiateBaudRate(PicoLink &link, const LinkNegotiationSettings &settings, std::ostream &errorLog);
+
+/// @brief How many updates per second a link can sustain
+/// @param stats the measured (or nominal) link
+/// @param bytesPerUpdate how many bytes each update sends
+/// @return Updates per second, or 0 if bytesPerUpdate is 0
+double maxUpdateRate(const LinkStats &stats, std::size_t bytesPerUpdate);
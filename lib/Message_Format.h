@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Wiring.h"
+#include <cstddef>
+
+// Formatting for the Pico's text protocol that writes straight into a caller-provided buffer, without std::string
+// or std::to_string. Pin numbers (0-29) and pulse widths (1100-1900) are small, so numbers are written two digits at
+// a time from a table built at compile time.
+
+/// @brief Enough room for the longest message the Pico understands (e.g. "Configure 29 Digital\n")
+constexpr std::size_t maxMessageLength = 32;
+
+/// @brief "00", "01", ... "99" laid out back to back
+struct DigitPairTable {
+    char digits[200];
+
+    constexpr DigitPairTable() : digits() {
+        for (int i = 0; i < 100; i++) {
+            digits[2 * i] = static_cast<char>('0' + i / 10);
+            digits[2 * i + 1] = static_cast<char>('0' + i % 10);
+        }
+    }
+};
+
+constexpr DigitPairTable digitPairTable{};
+
+/// @brief Write a non-negative number below 10000 in decimal
+/// @param out where the digits are written. Needs room for 4 characters
+/// @param value the number to write
+/// @return The number of characters written, or 0 (nothing written) if value is out of range
+inline std::size_t formatNumber(char *out, int value) {
+    if (value < 0 || value > 9999) {
+        return 0;
+    }
+    if (value < 10) {
+        out[0] = static_cast<char>('0' + value);
+        return 1;
+    }
+    if (value < 100) {
+        out[0] = digitPairTable.digits[2 * value];
+        out[1] = digitPairTable.digits[2 * value + 1];
+        return 2;
+    }
+    int high = value / 100;
+    int low = value % 100;
+    std::size_t length = 0;
+    if (high < 10) {
+        out[length++] = static_cast<char>('0' + high);
+    } else {
+        out[length++] = digitPairTable.digits[2 * high];
+        out[length++] = digitPairTable.digits[2 * high + 1];
+    }
+    out[length++] = digitPairTable.digits[2 * low];
+    out[length++] = digitPairTable.digits[2 * low + 1];
+    return length;
+}
+
+/// @brief Copy a string literal (without its terminator)
+/// @return The number of characters written
+template<std::size_t N>
+inline std::size_t formatLiteral(char *out, const char (&literal)[N]) {
+    for (std::size_t i = 0; i < N - 1; i++) {
+        out[i] = literal[i];
+    }
+    return N - 1;
+}
+
+/// @brief Format "Set <pin> PWM <pulse width>\n"
+/// @param buffer where the message is written. Needs room for maxMessageLength characters
+/// @return The length of the message, or 0 if the pin number or pulse width can't be formatted (see formatNumber)
+inline std::size_t formatPwmMessage(char *buffer, int pinNumber, int pulseWidth) {
+    std::size_t length = formatLiteral(buffer, "Set ");
+    std::size_t pinLength = formatNumber(buffer + length, pinNumber);
+    if (pinLength == 0) {
+        return 0;
+    }
+    length += pinLength;
+    length += formatLiteral(buffer + length, " PWM ");
+    std::size_t pulseWidthLength = formatNumber(buffer + length, pulseWidth);
+    if (pulseWidthLength == 0) {
+        return 0;
+    }
+    length += pulseWidthLength;
+    buffer[length++] = '\n';
+    return length;
+}
+
+/// @brief Format "Set <pin> Digital High\n" or "Set <pin> Digital Low\n"
+/// @param buffer where the message is written. Needs room for maxMessageLength characters
+/// @return The length of the message, or 0 if the pin number can't be formatted
+inline std::size_t formatDigitalMessage(char *buffer, int pinNumber, DigitalPinStatus status) {
+    std::size_t length = formatLiteral(buffer, "Set ");
+    std::size_t pinLength = formatNumber(buffer + length, pinNumber);
+    if (pinLength == 0) {
+        return 0;
+    }
+    length += pinLength;
+    if (status == High) {
+        length += formatLiteral(buffer + length, " Digital High\n");
+    } else {
+        length += formatLiteral(buffer + length, " Digital Low\n");
+    }
+    return length;
+}
+
+/// @brief Format "Configure <pin> <type>\n", where type is Digital, HardPwm or SoftPwm
+/// @param buffer where the message is written. Needs room for maxMessageLength characters
+/// @param softwarePwmAsDigital configure software pwm pins as digital outputs (when the Pi generates their pwm)
+/// @return The length of the message, or 0 if the pin number can't be formatted
+inline std::size_t formatConfigureMessage(char *buffer, int pinNumber, PinType pinType,
+                                          bool softwarePwmAsDigital = false) {
+    std::size_t length = formatLiteral(buffer, "Configure ");
+    std::size_t pinLength = formatNumber(buffer + length, pinNumber);
+    if (pinLength == 0) {
+        return 0;
+    }
+    length += pinLength;
+    switch (pinType) {
+        case HardwarePWM:
+            length += formatLiteral(buffer + length, " HardPwm\n");
+            break;
+        case SoftwarePWM:
+            if (!softwarePwmAsDigital) {
+                length += formatLiteral(buffer + length, " SoftPwm\n");
+                break;
+            }
+            // fall through
+        default:
+            length += formatLiteral(buffer + length, " Digital\n");
+    }
+    return length;
+}
@@ -0,0 +1,175 @@
+#include "Metrics.h"
+
+#include <utility>
+
+constexpr std::size_t Histogram::maxBounds;
+constexpr std::size_t MetricsRegistry::maxMetrics;
+
+void Counter::add(uint64_t amount) {
+    value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t Counter::get() const {
+    return value.load(std::memory_order_relaxed);
+}
+
+void Gauge::set(int64_t newValue) {
+    value.store(newValue, std::memory_order_relaxed);
+}
+
+void Gauge::add(int64_t amount) {
+    value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+int64_t Gauge::get() const {
+    return value.load(std::memory_order_relaxed);
+}
+
+Histogram::Histogram(const std::vector<uint64_t> &upperBounds) {
+    for (uint64_t upperBound: upperBounds) {
+        if (boundCount == maxBounds) {
+            break;
+        }
+        bounds[boundCount++] = upperBound;
+    }
+    for (auto &count: buckets) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(uint64_t value) {
+    std::size_t index = 0;
+    while (index < boundCount && value > bounds[index]) {
+        index++;
+    }
+    buckets[index].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::size_t Histogram::bucketCount() const {
+    return boundCount + 1;
+}
+
+uint64_t Histogram::bound(std::size_t bucket) const {
+    return bucket < boundCount ? bounds[bucket] : UINT64_MAX;
+}
+
+uint64_t Histogram::bucket(std::size_t bucket) const {
+    return buckets[bucket].load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::sum() const {
+    return total.load(std::memory_order_relaxed);
+}
+
+MetricsRegistry::Metric::Metric(std::string name, std::string help, std::string labels, Kind kind,
+                                const std::vector<uint64_t> &bounds) : name(std::move(name)), help(std::move(help)),
+                                                                       labels(std::move(labels)), kind(kind),
+                                                                       histogram(bounds) {}
+
+MetricsRegistry::Metric &MetricsRegistry::find(const std::string &name, const std::string &help,
+                                               const std::string &labels, Kind kind,
+                                               const std::vector<uint64_t> &bounds) {
+    std::lock_guard<std::mutex> lock(registering);
+    std::size_t count = metricCount.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < count; i++) {
+        if (metrics[i]->name == name) {
+            if (metrics[i]->kind != kind) {
+                return unexported;
+            }
+            if (metrics[i]->labels == labels) {
+                return *metrics[i];
+            }
+        }
+    }
+    if (count == maxMetrics) {
+        return unexported;
+    }
+    metrics[count].reset(new Metric(name, help, labels, kind, bounds));
+    // Publish the metric only once it is fully constructed, so render() can read it without the lock
+    metricCount.store(count + 1, std::memory_order_release);
+    return *metrics[count];
+}
+
+Counter &MetricsRegistry::counter(const std::string &name, const std::string &help, const std::string &labels) {
+    return find(name, help, labels, CounterKind, {}).counter;
+}
+
+Gauge &MetricsRegistry::gauge(const std::string &name, const std::string &help, const std::string &labels) {
+    return find(name, help, labels, GaugeKind, {}).gauge;
+}
+
+Histogram &MetricsRegistry::histogram(const std::string &name, const std::string &help,
+                                      const std::vector<uint64_t> &upperBounds, const std::string &labels) {
+    return find(name, help, labels, HistogramKind, upperBounds).histogram;
+}
+
+std::size_t MetricsRegistry::size() const {
+    return metricCount.load(std::memory_order_acquire);
+}
+
+void MetricsRegistry::renderValue(std::string &text, const Metric &metric, const std::string &suffix,
+                                  const std::string &extraLabel, uint64_t value) {
+    text += metric.name;
+    text += suffix;
+    if (!metric.labels.empty() || !extraLabel.empty()) {
+        text += '{';
+        text += metric.labels;
+        if (!metric.labels.empty() && !extraLabel.empty()) {
+            text += ',';
+        }
+        text += extraLabel;
+        text += '}';
+    }
+    text += ' ';
+    text += std::to_string(value);
+    text += '\n';
+}
+
+std::string MetricsRegistry::render() const {
+    static const char *const typeNames[] = {"counter", "gauge", "histogram"};
+    std::size_t count = metricCount.load(std::memory_order_acquire);
+    std::vector<bool> rendered(count, false);
+    std::string text;
+    for (std::size_t first = 0; first < count; first++) {
+        if (rendered[first]) {
+            continue;
+        }
+        const Metric &family = *metrics[first];
+        text += "# HELP " + family.name + " " + family.help + "\n";
+        text += "# TYPE " + family.name + " " + typeNames[family.kind] + "\n";
+        for (std::size_t i = first; i < count; i++) {
+            const Metric &metric = *metrics[i];
+            if (rendered[i] || metric.name != family.name) {
+                continue;
+            }
+            rendered[i] = true;
+            switch (metric.kind) {
+                case CounterKind:
+                    renderValue(text, metric, "", "", metric.counter.get());
+                    break;
+                case GaugeKind:
+                    text += metric.name;
+                    if (!metric.labels.empty()) {
+                        text += "{" + metric.labels + "}";
+                    }
+                    text += " " + std::to_string(metric.gauge.get()) + "\n";
+                    break;
+                case HistogramKind: {
+                    // Buckets are cumulative in the text format, and the count has to match the +Inf bucket
+                    uint64_t cumulative = 0;
+                    for (std::size_t bucket = 0; bucket < metric.histogram.bucketCount(); bucket++) {
+                        cumulative += metric.histogram.bucket(bucket);
+                        std::string bound = bucket + 1 < metric.histogram.bucketCount()
+                                            ? std::to_string(metric.histogram.bound(bucket)) : "+Inf";
+                        renderValue(text, metric, "_bucket", "le=\"" + bound + "\"", cumulative);
+                    }
+                    renderValue(text, metric, "_sum", "", metric.histogram.sum());
+                    renderValue(text, metric, "_count", "", cumulative);
+                    break;
+                }
+            }
+        }
+    }
+    return text;
+}
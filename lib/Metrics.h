@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// @brief A count that only goes up (e.g. bytes written). Updating it is a single relaxed atomic add.
+class Counter {
+private:
+    std::atomic<uint64_t> value{0};
+
+public:
+    void add(uint64_t amount = 1);
+
+    uint64_t get() const;
+};
+
+/// @brief A value that goes up and down (e.g. a queue depth or a pin's pwm value)
+class Gauge {
+private:
+    std::atomic<int64_t> value{0};
+
+public:
+    void set(int64_t newValue);
+
+    void add(int64_t amount);
+
+    int64_t get() const;
+};
+
+/// @brief Counts observations (e.g. write latencies in microseconds) into buckets with fixed upper bounds, plus their
+/// total. Observing takes a few relaxed atomic adds and a scan of the bounds, never a lock.
+class Histogram {
+public:
+    static constexpr std::size_t maxBounds = 16;
+
+private:
+    uint64_t bounds[maxBounds] = {};
+    std::size_t boundCount = 0;
+    std::atomic<uint64_t> buckets[maxBounds + 1]; // The last bucket holds observations above every bound
+    std::atomic<uint64_t> total{0};
+
+public:
+    /// @param upperBounds the (inclusive) upper bound of each bucket, in increasing order. Only the first maxBounds are
+    /// used.
+    explicit Histogram(const std::vector<uint64_t> &upperBounds);
+
+    void observe(uint64_t value);
+
+    std::size_t bucketCount() const;
+
+    /// @brief The upper bound of a bucket. The last bucket has no bound.
+    uint64_t bound(std::size_t bucket) const;
+
+    /// @brief How many observations fell in a bucket (not including the buckets below it)
+    uint64_t bucket(std::size_t bucket) const;
+
+    /// @brief The sum of every observation
+    uint64_t sum() const;
+};
+
+/// @brief Holds the counters, gauges and histograms that describe how the propulsion system is doing, and renders them
+/// in the Prometheus text format. Metrics are registered up front (registering takes a lock); from then on, updating
+/// and rendering them are both lock-free, so a scrape never holds up the control thread.
+class MetricsRegistry {
+public:
+    static constexpr std::size_t maxMetrics = 128;
+
+private:
+    enum Kind {
+        CounterKind, GaugeKind, HistogramKind
+    };
+
+    struct Metric {
+        std::string name;
+        std::string help;
+        std::string labels;
+        Kind kind;
+        Counter counter;
+        Gauge gauge;
+        Histogram histogram;
+
+        Metric(std::string name, std::string help, std::string labels, Kind kind,
+               const std::vector<uint64_t> &bounds);
+    };
+
+    std::mutex registering; // Only held while registering, never while updating or rendering
+    std::unique_ptr<Metric> metrics[maxMetrics];
+    std::atomic<std::size_t> metricCount{0};
+    Metric unexported{"", "", "", CounterKind, {}}; // Handed out when the registry is full
+
+    Metric &find(const std::string &name, const std::string &help, const std::string &labels, Kind kind,
+                 const std::vector<uint64_t> &bounds);
+
+    static void renderValue(std::string &text, const Metric &metric, const std::string &suffix,
+                            const std::string &extraLabel, uint64_t value);
+
+public:
+    MetricsRegistry() = default;
+
+    MetricsRegistry(const MetricsRegistry &) = delete;
+
+    MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+    /// @brief Get the counter with the given name and labels, registering it if it doesn't exist yet. Metrics live as
+    /// long as the registry. If the registry is full (or the name is already used for a different kind of metric), a
+    /// metric that is never exported is returned instead.
+    /// @param name a Prometheus metric name, e.g. propulsion_bytes_written_total
+    /// @param help one line describing the metric
+    /// @param labels preformatted Prometheus labels without braces, e.g. pin="4", or empty for none
+    Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    /// @brief Get a gauge, registering it if needed. See counter().
+    Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    /// @brief Get a histogram, registering it with the given bucket bounds if needed. See counter().
+    Histogram &histogram(const std::string &name, const std::string &help, const std::vector<uint64_t> &upperBounds,
+                         const std::string &labels = "");
+
+    /// @brief How many metrics are registered
+    std::size_t size() const;
+
+    /// @brief Every metric in the Prometheus text exposition format, with the series of each metric grouped together
+    std::string render() const;
+};
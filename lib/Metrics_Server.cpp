@@ -0,0 +1,130 @@
+#include "Metrics_Server.h"
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+constexpr std::chrono::milliseconds MetricsServer::requestTimeout;
+
+MetricsServer::MetricsServer(const MetricsRegistry &registry, std::ostream &outLog, std::ostream &errorLog) :
+        registry(registry), outLog(outLog), errorLog(errorLog) {}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start(const std::string &socketPath) {
+    if (server.joinable()) {
+        errorLog << "Metrics are already being served at " << path << "!" << std::endl;
+        return false;
+    }
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        errorLog << "Metrics socket path " << socketPath << " is too long!" << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        errorLog << "Unable to create metrics socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    // A socket left behind by a previous run would make bind() fail
+    unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, 4) != 0 ||
+        pipe(wakePipe) != 0) {
+        errorLog << "Unable to serve metrics at " << socketPath << ": " << strerror(errno) << std::endl;
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    path = socketPath;
+    server = std::thread(&MetricsServer::run, this);
+    outLog << "Serving metrics at " << path << std::endl;
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (!server.joinable()) {
+        return;
+    }
+    char wake = 0;
+    while (write(wakePipe[1], &wake, 1) < 0 && errno == EINTR) {}
+    server.join();
+    close(listener);
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    listener = -1;
+    wakePipe[0] = wakePipe[1] = -1;
+    unlink(path.c_str());
+}
+
+uint64_t MetricsServer::scrapeCount() const {
+    return scrapes.load(std::memory_order_relaxed);
+}
+
+void MetricsServer::run() {
+    // Only run when nothing else wants the CPU. Not being allowed to is harmless, so failure is ignored.
+    sched_param idle{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &idle);
+
+    pollfd waiting[2] = {{listener, POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+    while (true) {
+        if (poll(waiting, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            errorLog << "Metrics server stopped: " << strerror(errno) << std::endl;
+            return;
+        }
+        if (waiting[1].revents != 0) {
+            return;
+        }
+        int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client >= 0) {
+            serve(client);
+            close(client);
+        }
+    }
+}
+
+void MetricsServer::serve(int client) {
+    // A client that stops reading mustn't keep the server (or stop()) waiting forever
+    timeval sendTimeout{1, 0};
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+
+    char request[1024];
+    ssize_t requestLength = 0;
+    pollfd readable{client, POLLIN, 0};
+    if (poll(&readable, 1, static_cast<int>(requestTimeout.count())) > 0) {
+        requestLength = read(client, request, sizeof(request));
+    }
+
+    std::string body = registry.render();
+    std::string response;
+    if (requestLength >= 4 && std::memcmp(request, "GET ", 4) == 0) {
+        response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                   std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    }
+    response += body;
+
+    std::size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t count = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        sent += static_cast<std::size_t>(count);
+    }
+    scrapes.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Metrics.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+
+/// @brief Serves a metrics registry over a local Unix domain socket, one scrape per connection. A client that sends an
+/// HTTP request (e.g. curl --unix-socket) gets an HTTP response; any other client just gets the metrics text. The
+/// server runs on its own thread at the lowest scheduling priority, so it only ever uses time the control loop leaves.
+class MetricsServer {
+private:
+    const MetricsRegistry &registry;
+    std::ostream &outLog;
+    std::ostream &errorLog;
+    std::string path;
+    int listener = -1;
+    int wakePipe[2] = {-1, -1}; // Written to by stop() to wake the server thread
+    std::atomic<uint64_t> scrapes{0};
+    std::thread server;
+
+    void run();
+
+    void serve(int client);
+
+public:
+    /// @brief How long to wait for a client to send its request before answering it with the plain text
+    static constexpr std::chrono::milliseconds requestTimeout{50};
+
+    /// @param registry the metrics to serve. Must outlive the server
+    /// @param outLog where the socket path is logged
+    /// @param errorLog where socket errors are logged
+    MetricsServer(const MetricsRegistry &registry, std::ostream &outLog, std::ostream &errorLog);
+
+    MetricsServer(const MetricsServer &) = delete;
+
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    ~MetricsServer();
+
+    /// @brief Create the socket (replacing a stale one left at the same path) and start serving it
+    /// @param socketPath where to create the socket
+    /// @return True if serving, false if the socket couldn't be created (the reason is written to errorLog)
+    bool start(const std::string &socketPath);
+
+    /// @brief Stop serving and remove the socket. Does nothing if not started.
+    void stop();
+
+    /// @brief How many clients have been served
+    uint64_t scrapeCount() const;
+};
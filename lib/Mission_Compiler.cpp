@@ -0,0 +1,222 @@
+#include "Mission_Compiler.h"
+#include "Message_Format.h"
+#include "Wiring.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+    const char timelineMagic[4] = {'P', 'T', 'L', 'N'};
+
+    std::vector<const CommandComponent *> components(const Command *commands, std::size_t count) {
+        std::vector<const CommandComponent *> all;
+        for (std::size_t i = 0; i < count; i++) {
+            all.push_back(&commands[i].acceleration);
+            all.push_back(&commands[i].steadyState);
+            all.push_back(&commands[i].deceleration);
+        }
+        return all;
+    }
+}
+
+bool compileSequence(const Sequence &sequence, const std::vector<int> &thrusterPinNumbers, MissionTimeline &timeline,
+                     std::ostream &errorLog) {
+    return compileSequence(sequence.commands.data(), sequence.commands.size(), thrusterPinNumbers, timeline,
+                           errorLog);
+}
+
+bool compileSequence(const Command *commands, std::size_t count, const std::vector<int> &thrusterPinNumbers,
+                     MissionTimeline &timeline, std::ostream &errorLog) {
+    if (thrusterPinNumbers.size() != 8) {
+        errorLog << "Incorrect number of thruster pins given! Need 8, given " << thrusterPinNumbers.size()
+                 << std::endl;
+        return false;
+    }
+
+    auto all = components(commands, count);
+    for (std::size_t i = 0; i < all.size(); i++) {
+        if (all[i]->duration.count() < 0) {
+            errorLog << "Component " << i << " of the sequence has a negative duration!" << std::endl;
+            return false;
+        }
+        for (int pulseWidth: all[i]->thruster_pwms.pwm_signals) {
+            // The same limits as WiringControl::pwmWrite(), which would refuse to send anything else
+            if (pulseWidth < minimumPulseWidth || pulseWidth > maximumPulseWidth) {
+                errorLog << "Component " << i << " of the sequence has pwm " << pulseWidth << ", outside of ["
+                         << minimumPulseWidth << ", " << maximumPulseWidth << "]!" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    std::vector<TimelineEntry> entries;
+    std::vector<char> bytes;
+    uint64_t offsetNs = 0;
+    const pwm_array *previous = nullptr;
+    for (std::size_t i = 0; i < all.size(); i++) {
+        const CommandComponent &component = *all[i];
+        uint64_t durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(component.duration).count();
+        bool last = i + 1 == all.size();
+        if (durationNs == 0 && !last) {
+            continue;
+        }
+
+        TimelineEntry entry{};
+        entry.offsetNs = offsetNs;
+        entry.byteOffset = static_cast<uint32_t>(bytes.size());
+        for (int thruster = 0; thruster < 8; thruster++) {
+            int pulseWidth = component.thruster_pwms.pwm_signals[thruster];
+            entry.thrusterPwms[thruster] = pulseWidth;
+            if (previous != nullptr && previous->pwm_signals[thruster] == pulseWidth) {
+                continue;
+            }
+            char message[maxMessageLength];
+            std::size_t length = formatPwmMessage(message, thrusterPinNumbers[thruster], pulseWidth);
+            bytes.insert(bytes.end(), message, message + length);
+        }
+        entry.byteLength = static_cast<uint32_t>(bytes.size() - entry.byteOffset);
+        entries.push_back(entry);
+        previous = &component.thruster_pwms;
+        offsetNs += durationNs;
+    }
+
+    TimelineHeader header{};
+    std::memcpy(header.magic, timelineMagic, sizeof(header.magic));
+    header.version = timelineVersion;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.thrusterCount = 8;
+    for (int thruster = 0; thruster < 8; thruster++) {
+        header.thrusterPins[thruster] = thrusterPinNumbers[thruster];
+    }
+    header.totalDurationNs = offsetNs;
+    header.byteCount = bytes.size();
+
+    std::vector<char> data(sizeof(TimelineHeader) + entries.size() * sizeof(TimelineEntry) + bytes.size());
+    std::memcpy(data.data(), &header, sizeof(TimelineHeader));
+    if (!entries.empty()) {
+        std::memcpy(data.data() + sizeof(TimelineHeader), entries.data(), entries.size() * sizeof(TimelineEntry));
+    }
+    if (!bytes.empty()) {
+        std::memcpy(data.data() + sizeof(TimelineHeader) + entries.size() * sizeof(TimelineEntry), bytes.data(),
+                    bytes.size());
+    }
+
+    timeline.release();
+    timeline.ownedData = std::move(data);
+    timeline.data = timeline.ownedData.data();
+    timeline.size = timeline.ownedData.size();
+    return true;
+}
+
+bool MissionTimeline::valid() const {
+    return data != nullptr;
+}
+
+const TimelineHeader &MissionTimeline::header() const {
+    return *reinterpret_cast<const TimelineHeader *>(data);
+}
+
+const TimelineEntry &MissionTimeline::entry(uint32_t index) const {
+    return reinterpret_cast<const TimelineEntry *>(data + sizeof(TimelineHeader))[index];
+}
+
+const char *MissionTimeline::bytes(const TimelineEntry &entry) const {
+    return data + sizeof(TimelineHeader) + header().entryCount * sizeof(TimelineEntry) + entry.byteOffset;
+}
+
+bool MissionTimeline::save(const std::string &path, std::ostream &errorLog) const {
+    if (!valid()) {
+        errorLog << "Cannot save an empty timeline!" << std::endl;
+        return false;
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data, static_cast<std::streamsize>(size));
+    if (!file) {
+        errorLog << "Unable to write timeline to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MissionTimeline::load(const std::string &path, std::ostream &errorLog) {
+    release();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        errorLog << "Unable to open timeline " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat fileStatus{};
+    if (fstat(fd, &fileStatus) == -1 || static_cast<std::size_t>(fileStatus.st_size) < sizeof(TimelineHeader)) {
+        errorLog << "Timeline " << path << " is too small to be a timeline!" << std::endl;
+        close(fd);
+        return false;
+    }
+    auto fileSize = static_cast<std::size_t>(fileStatus.st_size);
+    void *address = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        errorLog << "Unable to map timeline " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    mapping = address;
+    data = static_cast<const char *>(address);
+    size = fileSize;
+
+    const TimelineHeader &loaded = header();
+    // Bound the counts by the file size before multiplying, so a corrupt header can't overflow the size check
+    const std::size_t afterHeader = fileSize - sizeof(TimelineHeader);
+    if (std::memcmp(loaded.magic, timelineMagic, sizeof(loaded.magic)) != 0 || loaded.version != timelineVersion ||
+        loaded.thrusterCount != 8 || loaded.entryCount > afterHeader / sizeof(TimelineEntry) ||
+        loaded.byteCount != afterHeader - loaded.entryCount * sizeof(TimelineEntry)) {
+        errorLog << "Timeline " << path << " is corrupt or from an incompatible version!" << std::endl;
+        release();
+        return false;
+    }
+    for (uint32_t i = 0; i < loaded.entryCount; i++) {
+        if (static_cast<uint64_t>(entry(i).byteOffset) + entry(i).byteLength > loaded.byteCount) {
+            errorLog << "Timeline " << path << " is corrupt!" << std::endl;
+            release();
+            return false;
+        }
+    }
+    return true;
+}
+
+void MissionTimeline::release() {
+    if (mapping != nullptr) {
+        munmap(mapping, size);
+        mapping = nullptr;
+    }
+    ownedData.clear();
+    ownedData.shrink_to_fit();
+    data = nullptr;
+    size = 0;
+}
+
+MissionTimeline::MissionTimeline(MissionTimeline &&other) noexcept {
+    *this = std::move(other);
+}
+
+MissionTimeline &MissionTimeline::operator=(MissionTimeline &&other) noexcept {
+    if (this != &other) {
+        release();
+        // Moving a vector keeps its buffer, so data stays valid whether it points into ownedData or a mapping
+        ownedData = std::move(other.ownedData);
+        data = other.data;
+        size = other.size;
+        mapping = other.mapping;
+        other.mapping = nullptr;
+        other.data = nullptr;
+        other.size = 0;
+    }
+    return *this;
+}
+
+MissionTimeline::~MissionTimeline() {
+    release();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Command.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * A compiled timeline is one flat block of memory, laid out the same way in RAM and on disk so a saved timeline can
+ * be mmap'd and executed without parsing:
+ *
+ *   TimelineHeader
+ *   TimelineEntry[entryCount]
+ *   char bytes[byteCount]   (the serial messages, already formatted)
+ */
+
+/// @brief Bump whenever TimelineHeader or TimelineEntry change
+constexpr uint32_t timelineVersion = 1;
+
+struct TimelineHeader {
+    char magic[4]; // "PTLN"
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t thrusterCount;
+    int32_t thrusterPins[8]; // The GPIO numbers the timeline was compiled for, in thruster order
+    uint64_t totalDurationNs; // When the timeline ends, relative to its start
+    uint64_t byteCount;
+};
+
+/// @brief Something to send at a given time
+struct TimelineEntry {
+    uint64_t offsetNs; // When to send, relative to the start of the timeline
+    uint32_t byteOffset; // Where the preformatted messages start in the byte block
+    uint32_t byteLength;
+    int32_t thrusterPwms[8]; // The pwm of every thruster once the messages are sent (for the interpreter's cache)
+};
+
+/// @brief A Sequence compiled into a timeline of preformatted serial messages. Either owns its memory (after
+/// compiling) or maps a saved file (after loading).
+class MissionTimeline {
+private:
+    std::vector<char> ownedData;
+    const char *data = nullptr;
+    std::size_t size = 0;
+    void *mapping = nullptr;
+
+    void release();
+
+    friend bool compileSequence(const Command *commands, std::size_t count,
+                                const std::vector<int> &thrusterPinNumbers, MissionTimeline &timeline,
+                                std::ostream &errorLog);
+
+public:
+    /// @brief Whether the timeline holds a compiled sequence
+    bool valid() const;
+
+    const TimelineHeader &header() const;
+
+    /// @param index which entry, between 0 and header().entryCount - 1
+    const TimelineEntry &entry(uint32_t index) const;
+
+    /// @brief The preformatted serial messages of an entry
+    const char *bytes(const TimelineEntry &entry) const;
+
+    /// @brief Write the timeline to a file
+    /// @return True on success, false otherwise (the reason is written to errorLog)
+    bool save(const std::string &path, std::ostream &errorLog) const;
+
+    /// @brief Map a timeline saved with save(). The file is checked (magic, version, sizes) but not re-validated.
+    /// @return True on success, false otherwise (the reason is written to errorLog)
+    bool load(const std::string &path, std::ostream &errorLog);
+
+    MissionTimeline() = default;
+
+    MissionTimeline(const MissionTimeline &) = delete;
+
+    MissionTimeline &operator=(const MissionTimeline &) = delete;
+
+    MissionTimeline(MissionTimeline &&other) noexcept;
+
+    MissionTimeline &operator=(MissionTimeline &&other) noexcept;
+
+    ~MissionTimeline();
+};
+
+/// @brief Validate a sequence once and compile it into a timeline. Each command component becomes one entry sent at
+/// the time the component starts. After the first entry, only thrusters whose pwm changes are sent, and zero-length
+/// components that are immediately overridden are dropped.
+/// @param sequence the sequence to compile
+/// @param thrusterPinNumbers the GPIO numbers of the 8 thruster pins, in the same order as the pwm arrays
+/// @param timeline where the compiled timeline is stored
+/// @param errorLog where validation errors are written
+/// @return True if the sequence is valid (all pwms within 1100-1900, no negative durations), false otherwise
+bool compileSequence(const Sequence &sequence, const std::vector<int> &thrusterPinNumbers, MissionTimeline &timeline,
+                     std::ostream &errorLog);
+
+/// @brief Same as compileSequence(sequence, ...) for commands stored elsewhere (such as an ArenaSequence)
+/// @param commands the first of the commands to compile
+/// @param count how many commands there are
+bool compileSequence(const Command *commands, std::size_t count, const std::vector<int> &thrusterPinNumbers,
+                     MissionTimeline &timeline, std::ostream &errorLog);
@@ -0,0 +1,109 @@
+#include "Parallel_For.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    threads = std::max(1u, threads);
+    void *memory = nullptr;
+    if (posix_memalign(&memory, alignof(Share), sizeof(Share) * threads) != 0) {
+        throw std::bad_alloc();
+    }
+    shares.reset(static_cast<Share *>(memory));
+    for (unsigned i = 0; i < threads; i++) {
+        new(&shares[i]) Share();
+    }
+    for (unsigned self = 1; self < threads; self++) {
+        workers.emplace_back(&WorkStealingPool::run, this, self);
+    }
+}
+
+void WorkStealingPool::ShareDeleter::operator()(Share *memory) const {
+    static_assert(std::is_trivially_destructible<Share>::value, "Shares are freed without running destructors");
+    std::free(memory);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker: workers) {
+        worker.join();
+    }
+}
+
+unsigned WorkStealingPool::size() const {
+    return static_cast<unsigned>(workers.size()) + 1;
+}
+
+void WorkStealingPool::work(unsigned self) {
+    // Own share first, then go round the others taking whatever is left
+    for (unsigned offset = 0; offset < size(); offset++) {
+        Share &share = shares[(self + offset) % size()];
+        while (true) {
+            std::size_t begin = share.next.fetch_add(grain, std::memory_order_relaxed);
+            if (begin >= share.end) {
+                break;
+            }
+            chunkFunction(context, begin, std::min(begin + grain, share.end));
+        }
+    }
+}
+
+void WorkStealingPool::run(unsigned self) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        work(self);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+        }
+        finished.notify_one();
+    }
+}
+
+void WorkStealingPool::parallelFor(std::size_t count, std::size_t grainSize, ChunkFunction function,
+                                   void *functionContext) {
+    if (count == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> call(callMutex);
+    grain = std::max<std::size_t>(1, grainSize);
+    if (workers.empty() || count <= grain) {
+        for (std::size_t begin = 0; begin < count; begin += grain) {
+            function(functionContext, begin, std::min(begin + grain, count));
+        }
+        return;
+    }
+
+    chunkFunction = function;
+    context = functionContext;
+    std::size_t perShare = (count + size() - 1) / size();
+    for (unsigned i = 0; i < size(); i++) {
+        shares[i].end = std::min(count, perShare * i + perShare);
+        shares[i].next.store(std::min(count, perShare * i), std::memory_order_relaxed);
+    }
+    {
+        // Publishes the shares and the job to the workers
+        std::lock_guard<std::mutex> lock(mutex);
+        running = static_cast<unsigned>(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&]() { return running == 0; });
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// @brief A fixed set of threads for running loops in parallel. Each call splits the range evenly between the
+/// threads; a thread that finishes its share steals chunks from the others' shares, so uneven chunks still keep every
+/// core busy. The calling thread works too. Running a loop doesn't allocate.
+class WorkStealingPool {
+private:
+    using ChunkFunction = void (*)(void *, std::size_t, std::size_t);
+
+    /// @brief One thread's share of the range. Chunks are claimed (by the owner or a thief) with fetch_add on next.
+    struct alignas(64) Share {
+        std::atomic<std::size_t> next{0};
+        std::size_t end = 0;
+    };
+
+    /// @brief Frees shares allocated in the constructor. C++14 operator new[] ignores alignas(64), so they come
+    /// from posix_memalign() instead.
+    struct ShareDeleter {
+        void operator()(Share *memory) const;
+    };
+
+    std::unique_ptr<Share[], ShareDeleter> shares;
+    std::vector<std::thread> workers;
+
+    std::mutex callMutex; // One loop at a time
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    uint64_t generation = 0;
+    unsigned running = 0;
+    bool stopping = false;
+
+    ChunkFunction chunkFunction = nullptr;
+    void *context = nullptr;
+    std::size_t grain = 1;
+
+    void work(unsigned self);
+
+    void run(unsigned self);
+
+    void parallelFor(std::size_t count, std::size_t grainSize, ChunkFunction function, void *functionContext);
+
+public:
+    /// @param threads how many threads take part in each loop, including the caller (at least 1)
+    explicit WorkStealingPool(unsigned threads = std::thread::hardware_concurrency());
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    ~WorkStealingPool();
+
+    /// @brief How many threads take part in each loop, including the caller
+    unsigned size() const;
+
+    /// @brief Call body(begin, end) for chunks covering [0, count) exactly once, in parallel, and wait for all of them
+    /// @param count the size of the range
+    /// @param grainSize how many indices each chunk holds (the last chunk of a share may be smaller)
+    /// @param body called as body(std::size_t begin, std::size_t end), from any of the threads
+    template<typename Body>
+    void parallelFor(std::size_t count, std::size_t grainSize, Body &&body) {
+        using BodyType = typename std::remove_reference<Body>::type;
+        parallelFor(count, grainSize, [](void *bodyPointer, std::size_t begin, std::size_t end) {
+            (*static_cast<BodyType *>(bodyPointer))(begin, end);
+        }, static_cast<void *>(&body));
+    }
+};
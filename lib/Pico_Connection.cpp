@@ -0,0 +1,197 @@
+#include "Pico_Connection.h"
+
+#include <algorithm>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <utility>
+
+constexpr std::size_t PicoConnection::maxRestoreFrameLength;
+
+PicoConnection::Device::Device(int fd) : fd(fd), link(fd) {}
+
+PicoConnection::Device::~Device() {
+    close(fd);
+}
+
+PicoConnection::PicoConnection(Opener opener, std::ostream &outLog, std::ostream &errorLog,
+                               ReconnectSettings settings) : opener(std::move(opener)), settings(settings),
+                                                             outLog(outLog), errorLog(errorLog) {}
+
+PicoConnection::~PicoConnection() {
+    stopWatching(owner);
+}
+
+void PicoConnection::setOpenHook(OpenHook hook) {
+    openHook = std::move(hook);
+}
+
+bool PicoConnection::connect(const void *restoreOwner, Restorer restoreFrame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (watcher.joinable()) {
+            return false;
+        }
+        owner = restoreOwner;
+        restorer = std::move(restoreFrame);
+        stopping = false;
+    }
+    watcher = std::thread(&PicoConnection::run, this);
+    return waitUntilConnected(settings.connectTimeout);
+}
+
+void PicoConnection::stopWatching(const void *restoreOwner) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!watcher.joinable() || restoreOwner != owner) {
+            return;
+        }
+        stopping = true;
+    }
+    changed.notify_all();
+    watcher.join();
+    std::lock_guard<std::mutex> lock(mutex);
+    restorer = nullptr;
+    owner = nullptr;
+}
+
+bool PicoConnection::connected() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return device != nullptr;
+}
+
+bool PicoConnection::waitUntilConnected(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return changed.wait_for(lock, timeout, [this]() { return device != nullptr || stopping; }) && device != nullptr;
+}
+
+std::shared_ptr<PicoConnection::Device> PicoConnection::currentDevice() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return device;
+}
+
+std::shared_ptr<PicoConnection::Device> PicoConnection::open() {
+    auto backoff = settings.initialBackoff;
+    while (true) {
+        int fd = opener();
+        if (fd >= 0) {
+            return std::make_shared<Device>(fd);
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        stats.failedAttempts++;
+        if (changed.wait_for(lock, backoff, [this]() { return stopping; })) {
+            return nullptr;
+        }
+        backoff = std::min(backoff * 2, settings.maximumBackoff);
+    }
+}
+
+bool PicoConnection::watch(const Device &current) {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return false;
+            }
+        }
+        // No events requested: poll still reports a hang-up or error on the device
+        pollfd hangUp{current.fd, 0, 0};
+        int ready = poll(&hangUp, 1, static_cast<int>(settings.watchInterval.count()));
+        if ((ready > 0 && (hangUp.revents & (POLLHUP | POLLERR | POLLNVAL))) || writeFailed.load()) {
+            return true;
+        }
+    }
+}
+
+void PicoConnection::run() {
+    auto lostAt = std::chrono::steady_clock::now();
+    while (true) {
+        std::shared_ptr<Device> fresh = open();
+        if (fresh == nullptr) {
+            return;
+        }
+        if (openHook) {
+            openHook(fresh->link);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return;
+            }
+            // Writes are held back until the Pico has caught up, so nothing overtakes the restore frame
+            char frame[maxRestoreFrameLength];
+            std::size_t length = restorer ? std::min(restorer(frame, sizeof(frame)), sizeof(frame)) : 0;
+            if (length > 0 && !fresh->link.writeBytes(frame, length)) {
+                errorLog << "Unable to restore pin states on the Pico! Reconnecting." << std::endl;
+                continue;
+            }
+            device = fresh;
+            writeFailed = false;
+            stats.connected = true;
+            if (everConnected) {
+                auto recovery = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - lostAt);
+                stats.reconnects++;
+                stats.lastRecoveryTime = recovery;
+                stats.maximumRecoveryTime = std::max(stats.maximumRecoveryTime, recovery);
+                outLog << "Reconnected to the Pico in " << recovery.count() << " us (" << length
+                       << " bytes of pin state restored)" << std::endl;
+            }
+            everConnected = true;
+        }
+        changed.notify_all();
+
+        if (!watch(*fresh)) {
+            return;
+        }
+        lostAt = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            device.reset();
+            stats.disconnects++;
+            stats.connected = false;
+        }
+        errorLog << "Lost the connection to the Pico! Reconnecting." << std::endl;
+    }
+}
+
+void PicoConnection::drain() {
+    std::shared_ptr<Device> current = currentDevice();
+    if (current != nullptr) {
+        tcdrain(current->fd);
+    }
+}
+
+PicoConnection::Statistics PicoConnection::statistics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+bool PicoConnection::writeBytes(const char *bytes, std::size_t length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (device == nullptr) {
+        return false;
+    }
+    if (!device->link.writeBytes(bytes, length)) {
+        writeFailed = true;
+        return false;
+    }
+    return true;
+}
+
+bool PicoConnection::readLine(std::string &line, std::chrono::milliseconds timeout) {
+    std::shared_ptr<Device> current = currentDevice();
+    return current != nullptr && current->link.readLine(line, timeout);
+}
+
+bool PicoConnection::setBaudRate(int baudRate) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return device != nullptr && device->link.setBaudRate(baudRate);
+}
+
+void PicoConnection::discardInput() {
+    std::shared_ptr<Device> current = currentDevice();
+    if (current != nullptr) {
+        current->link.discardInput();
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Pico_Link.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+/// @brief How quickly to retry opening the Pico's device
+struct ReconnectSettings {
+    std::chrono::milliseconds initialBackoff{5}; // Wait after the first failed attempt, doubled after each failure
+    std::chrono::milliseconds maximumBackoff{250};
+    std::chrono::milliseconds connectTimeout{5000}; // How long connect() waits for the first connection
+    std::chrono::milliseconds watchInterval{10}; // How often the watcher checks for a failed write or a stop request
+};
+
+/// @brief A connection to the Pico that survives the device going away (e.g. the USB cable being knocked loose).
+/// A watcher thread notices the hang-up (or a failed write), reopens the device with exponential backoff, and sends
+/// one batched frame that restores every pin's configuration and state, so nothing has to be restarted. While the
+/// connection is down, writes are dropped; whatever they changed is in the restore frame.
+class PicoConnection : public PicoLink {
+public:
+    /// @brief Opens the Pico's device
+    /// @return An open file descriptor, or -1 if the device can't be opened (yet)
+    using Opener = std::function<int()>;
+
+    /// @brief Called with each freshly opened device before anything else is sent over it (e.g. to negotiate the
+    /// baud rate). Runs on the watcher thread.
+    using OpenHook = std::function<void(PicoLink &)>;
+
+    /// @brief Writes the messages that bring a freshly connected Pico back to the current state into frame
+    /// @return How many bytes were written (at most maxRestoreFrameLength)
+    using Restorer = std::function<std::size_t(char *frame, std::size_t capacity)>;
+
+    static constexpr std::size_t maxRestoreFrameLength = 2048;
+
+    /// @brief Connection counters since connect()
+    struct Statistics {
+        uint64_t disconnects; // How many times the connection was lost
+        uint64_t reconnects; // How many times it came back
+        uint64_t failedAttempts; // Opens that failed, including before the first connection
+        std::chrono::microseconds lastRecoveryTime; // From noticing the loss to the restore frame being written
+        std::chrono::microseconds maximumRecoveryTime;
+        bool connected;
+    };
+
+private:
+    /// @brief An open device. Closed once the last user lets go, so a reader never sees its descriptor reused.
+    struct Device {
+        int fd;
+        FdPicoLink link;
+
+        explicit Device(int fd);
+
+        ~Device();
+    };
+
+    Opener opener;
+    OpenHook openHook;
+    Restorer restorer;
+    const void *owner = nullptr;
+    ReconnectSettings settings;
+    std::ostream &outLog;
+    std::ostream &errorLog;
+
+    mutable std::mutex mutex; // Guards everything below, and is held for every write to the device
+    std::condition_variable changed;
+    std::shared_ptr<Device> device;
+    std::atomic<bool> writeFailed{false};
+    bool stopping = false;
+    bool everConnected = false;
+    Statistics stats{0, 0, 0, std::chrono::microseconds(0), std::chrono::microseconds(0), false};
+    std::thread watcher;
+
+    void run();
+
+    /// @brief Keep trying to open the device until it opens or the connection is stopped
+    /// @return The device, or nullptr if the connection was stopped
+    std::shared_ptr<Device> open();
+
+    /// @brief Wait until the device hangs up, a write fails, or the connection is stopped
+    /// @return True if the connection was lost, false if it was stopped
+    bool watch(const Device &current);
+
+    std::shared_ptr<Device> currentDevice() const;
+
+public:
+    /// @param opener opens the Pico's device (e.g. the serial port)
+    /// @param outLog where reconnections are logged
+    /// @param errorLog where lost connections are logged
+    /// @param settings how quickly to retry
+    PicoConnection(Opener opener, std::ostream &outLog, std::ostream &errorLog,
+                   ReconnectSettings settings = ReconnectSettings{});
+
+    PicoConnection(const PicoConnection &) = delete;
+
+    PicoConnection &operator=(const PicoConnection &) = delete;
+
+    ~PicoConnection();
+
+    /// @brief Set what to do with each freshly opened device. Call before connect().
+    void setOpenHook(OpenHook hook);
+
+    /// @brief Start the watcher thread, which opens the device and keeps it open from then on, and wait up to
+    /// connectTimeout for the first connection. If it doesn't come, the watcher keeps trying in the background.
+    /// @param restoreOwner whoever restorer belongs to, so only they can stop the watcher
+    /// @param restoreFrame what to send whenever the device has been (re)opened. Runs on the watcher thread while
+    /// writes are held back.
+    /// @return True if connected within connectTimeout, false otherwise (or if already started)
+    bool connect(const void *restoreOwner, Restorer restoreFrame);
+
+    /// @brief Stop the watcher thread, if it was started by restoreOwner. The device stays open, but is no longer
+    /// reopened if it goes away.
+    void stopWatching(const void *restoreOwner);
+
+    /// @brief Whether the device is currently open
+    bool connected() const;
+
+    /// @brief Wait until the device is open
+    /// @return True if it is open, false if the timeout ran out first
+    bool waitUntilConnected(std::chrono::milliseconds timeout);
+
+    /// @brief Wait until everything written so far has left (for a serial port; does nothing for other devices)
+    void drain();
+
+    Statistics statistics() const;
+
+    /// @return False if the connection is down or the write failed (which starts a reconnect)
+    bool writeBytes(const char *bytes, std::size_t length) override;
+
+    /// @return False if the connection is down or no line arrived in time
+    bool readLine(std::string &line, std::chrono::milliseconds timeout) override;
+
+    bool setBaudRate(int baudRate) override;
+
+    void discardInput() override;
+};
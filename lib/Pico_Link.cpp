@@ -0,0 +1,133 @@
+#include "Pico_Link.h"
+
+#include <cerrno>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+FdPicoLink::FdPicoLink(int fd) : fd(fd) {}
+
+bool FdPicoLink::writeBytes(const char *bytes, std::size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        length -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+bool FdPicoLink::readLine(std::string &line, std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        std::size_t newline = received.find('\n');
+        if (newline != std::string::npos) {
+            line.assign(received, 0, newline);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            received.erase(0, newline + 1);
+            return true;
+        }
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            return false;
+        }
+        pollfd readable{fd, POLLIN, 0};
+        int ready = poll(&readable, 1, static_cast<int>(remaining.count()));
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        char buffer[256];
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            // Hung up, or nothing there after all
+            if (count == 0 || (readable.revents & (POLLHUP | POLLERR))) {
+                return false;
+            }
+            continue;
+        }
+        received.append(buffer, static_cast<std::size_t>(count));
+    }
+}
+
+bool FdPicoLink::setBaudRate(int baudRate) {
+    unsigned int speed;
+    if (!baudRateToSpeed(baudRate, speed)) {
+        return false;
+    }
+    termios options{};
+    if (tcgetattr(fd, &options) == -1) {
+        return errno == ENOTTY;
+    }
+    tcdrain(fd);
+    cfsetispeed(&options, static_cast<speed_t>(speed));
+    cfsetospeed(&options, static_cast<speed_t>(speed));
+    return tcsetattr(fd, TCSANOW, &options) == 0;
+}
+
+void FdPicoLink::discardInput() {
+    received.clear();
+    if (tcflush(fd, TCIFLUSH) == 0) {
+        return;
+    }
+    // Not a terminal: drain whatever is already waiting
+    char buffer[256];
+    pollfd readable{fd, POLLIN, 0};
+    while (poll(&readable, 1, 0) > 0 && (readable.revents & POLLIN)) {
+        if (read(fd, buffer, sizeof(buffer)) <= 0) {
+            break;
+        }
+    }
+}
+
+bool baudRateToSpeed(int baudRate, unsigned int &speed) {
+    switch (baudRate) {
+        case 50: speed = B50; break;
+        case 75: speed = B75; break;
+        case 110: speed = B110; break;
+        case 134: speed = B134; break;
+        case 150: speed = B150; break;
+        case 200: speed = B200; break;
+        case 300: speed = B300; break;
+        case 600: speed = B600; break;
+        case 1200: speed = B1200; break;
+        case 1800: speed = B1800; break;
+        case 2400: speed = B2400; break;
+        case 4800: speed = B4800; break;
+        case 9600: speed = B9600; break;
+        case 19200: speed = B19200; break;
+        case 38400: speed = B38400; break;
+        case 57600: speed = B57600; break;
+        case 115200: speed = B115200; break;
+        case 230400: speed = B230400; break;
+        case 460800: speed = B460800; break;
+        case 500000: speed = B500000; break;
+        case 576000: speed = B576000; break;
+        case 921600: speed = B921600; break;
+        case 1000000: speed = B1000000; break;
+        case 1152000: speed = B1152000; break;
+        case 1500000: speed = B1500000; break;
+        case 2000000: speed = B2000000; break;
+        case 2500000: speed = B2500000; break;
+        case 3000000: speed = B3000000; break;
+        case 3500000: speed = B3500000; break;
+        case 4000000: speed = B4000000; break;
+        default:
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/// @brief A two-way byte connection to the Pico, for exchanges that need the Pico's replies (e.g. link negotiation)
+class PicoLink {
+public:
+    /// @brief Send bytes to the Pico
+    /// @return True if every byte was written, false otherwise
+    virtual bool writeBytes(const char *bytes, std::size_t length) = 0;
+
+    /// @brief Wait for the next line from the Pico
+    /// @param line where the line is stored, without its trailing newline
+    /// @param timeout how long to wait for a complete line
+    /// @return True if a line arrived in time, false otherwise
+    virtual bool readLine(std::string &line, std::chrono::milliseconds timeout) = 0;
+
+    /// @brief Change the baud rate of our end of the link. The Pico has to be told separately.
+    /// @return True if the rate was applied, false otherwise
+    virtual bool setBaudRate(int baudRate) = 0;
+
+    /// @brief Throw away anything received but not read yet
+    virtual void discardInput() = 0;
+
+    virtual ~PicoLink() = default;
+};
+
+/// @brief A PicoLink over a file descriptor: normally the serial port, but any stream (e.g. one end of a socketpair)
+/// works. Changing the baud rate of something that isn't a terminal does nothing and succeeds.
+class FdPicoLink : public PicoLink {
+private:
+    int fd;
+    std::string received;
+
+public:
+    /// @param fd an open file descriptor. It isn't closed by the link.
+    explicit FdPicoLink(int fd);
+
+    bool writeBytes(const char *bytes, std::size_t length) override;
+
+    bool readLine(std::string &line, std::chrono::milliseconds timeout) override;
+
+    bool setBaudRate(int baudRate) override;
+
+    void discardInput() override;
+};
+
+/// @brief Look up the termios speed constant for a baud rate
+/// @param baudRate a standard rate between 50 and 4000000
+/// @param speed where the constant is stored
+/// @return True if the rate is supported, false otherwise
+bool baudRateToSpeed(int baudRate, unsigned int &speed);
@@ -0,0 +1,63 @@
+#include "Propulsion_Daemon.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+PropulsionDaemon::PropulsionDaemon(Command_Interpreter_RPi5 &interpreter, PropulsionSharedMemory &sharedMemory,
+                                   std::ostream &outLog, std::ostream &errorLog, const ThrustModel &thrustModel)
+        : interpreter(interpreter), sharedMemory(sharedMemory), thrustModel(thrustModel), outLog(outLog),
+          errorLog(errorLog) {}
+
+pwm_array PropulsionDaemon::pulseWidthsFor(const force_array &forces) const {
+    pwm_array pwms{};
+    for (int thruster = 0; thruster < 8; thruster++) {
+        float force = forces.forces[thruster];
+        float pulseWidth = std::isfinite(force) ? thrustModel.pulseWidth(force) : 1500;
+        pulseWidth = std::min(std::max(pulseWidth, static_cast<float>(minimumPulseWidth)),
+                              static_cast<float>(maximumPulseWidth));
+        pwms.pwm_signals[thruster] = static_cast<int>(std::lround(pulseWidth));
+    }
+    return pwms;
+}
+
+bool PropulsionDaemon::pollOnce() {
+    SharedCommand command{};
+    if (!sharedMemory.readNewCommand(command, lastCommandVersion)) {
+        return false;
+    }
+    switch (command.mode) {
+        case PwmMode:
+            interpreter.untimed_execute(command.pwms);
+            commandsApplied++;
+            publishTelemetry();
+            return true;
+        case ForceMode:
+            interpreter.untimed_execute(pulseWidthsFor(command.forces));
+            commandsApplied++;
+            publishTelemetry();
+            return true;
+        default:
+            errorLog << "Unknown shared memory command mode " << command.mode << "; ignoring." << std::endl;
+            return false;
+    }
+}
+
+void PropulsionDaemon::publishTelemetry() {
+    sharedMemory.writeTelemetry(interpreter.readPins(), commandsApplied);
+}
+
+void PropulsionDaemon::run(const std::atomic<bool> &running, std::chrono::microseconds pollInterval) {
+    outLog << "Propulsion daemon serving shared memory commands." << std::endl;
+    publishTelemetry();
+    while (running.load(std::memory_order_relaxed)) {
+        if (!pollOnce()) {
+            std::this_thread::sleep_for(pollInterval);
+        }
+    }
+    outLog << "Propulsion daemon stopped after " << commandsApplied << " commands." << std::endl;
+}
+
+uint64_t PropulsionDaemon::appliedCount() const {
+    return commandsApplied;
+}
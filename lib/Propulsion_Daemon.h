@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Command_Interpreter.h"
+#include "Shared_Memory.h"
+#include "Thrust_Model.h"
+#include <atomic>
+#include <chrono>
+
+/// @brief Serves thruster commands written to shared memory by other processes, and publishes the resulting pin
+/// states back to shared memory.
+class PropulsionDaemon {
+private:
+    Command_Interpreter_RPi5 &interpreter;
+    PropulsionSharedMemory &sharedMemory;
+    ThrustModel thrustModel;
+    std::ostream &outLog;
+    std::ostream &errorLog;
+    uint32_t lastCommandVersion = 0;
+    uint64_t commandsApplied = 0;
+
+    /// @brief The pulse width that gives each thruster its force, limited to the pulse widths the thrusters accept
+    pwm_array pulseWidthsFor(const force_array &forces) const;
+
+public:
+    /// @brief Execute the newest command in shared memory, if there is one that hasn't been executed yet
+    /// @return True if a command was executed, false otherwise
+    bool pollOnce();
+
+    /// @brief Publish the interpreter's current pin states to shared memory
+    void publishTelemetry();
+
+    /// @brief Poll for commands until running is set to false
+    /// @param running cleared (e.g. by a signal handler) to stop the daemon
+    /// @param pollInterval how long to sleep when no new command is available
+    void run(const std::atomic<bool> &running, std::chrono::microseconds pollInterval);
+
+    /// @brief The number of commands executed so far
+    uint64_t appliedCount() const;
+
+    /// @param interpreter an interpreter whose pins have already been initialized
+    /// @param sharedMemory a region that has already been created
+    /// @param outLog where you want logging (not error) messages to be logged
+    /// @param errorLog where you want error messages to be logged
+    /// @param thrustModel turns force commands into pulse widths (only its thruster curve is used)
+    PropulsionDaemon(Command_Interpreter_RPi5 &interpreter, PropulsionSharedMemory &sharedMemory,
+                     std::ostream &outLog, std::ostream &errorLog,
+                     const ThrustModel &thrustModel = ThrustModel(std::array<ThrusterGeometry, 8>{}));
+};
@@ -0,0 +1,47 @@
+#include "Propulsion_Daemon.h"
+#include "Metrics_Server.h"
+
+#include <csignal>
+#include <iostream>
+
+namespace {
+    std::atomic<bool> running{true};
+
+    void stop(int) {
+        running.store(false);
+    }
+}
+
+int main() {
+    std::ofstream outLog("/dev/null");
+
+    // Before touching the wiring, so a second launch leaves the running daemon's thrusters alone
+    PropulsionSharedMemory sharedMemory("/propulsion", std::cerr);
+    if (!sharedMemory.create()) {
+        return 42;
+    }
+
+    auto pins = std::vector<PwmPin>{};
+    for (int pinNumber: std::vector<int>{4, 5, 2, 3, 9, 7, 8, 6}) {
+        pins.push_back(HardwarePwmPin(pinNumber));
+    }
+    WiringControl wiringControl = WiringControl(std::cout, outLog, std::cerr);
+    Command_Interpreter_RPi5 interpreter(pins, std::vector<DigitalPin>{}, wiringControl, std::cout, outLog,
+                                         std::cerr);
+    auto metrics = std::make_shared<MetricsRegistry>();
+    interpreter.attachMetrics(metrics);
+    interpreter.initializePins();
+
+    // Metrics are nice to have, so carry on without them if the socket can't be created. Only started once the region
+    // is ours: start() replaces whatever socket is at the path, and a rejected second daemon mustn't take the running
+    // daemon's.
+    MetricsServer metricsServer(*metrics, std::cout, std::cerr);
+    metricsServer.start("/tmp/propulsion_metrics.sock");
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    PropulsionDaemon daemon(interpreter, sharedMemory, std::cout, std::cerr);
+    daemon.run(running, std::chrono::microseconds(100));
+    return 0;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/// @brief A sequence-lock protected slot holding a trivially copyable value. Readers never block writers and never
+/// take a lock: they copy the value and retry if a write happened while they were copying. The payload is stored as
+/// relaxed atomic words so the slot is safe to place in memory shared between processes.
+/// @tparam T the (trivially copyable) type stored in the slot
+template<typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock payload must be trivially copyable");
+
+    static constexpr std::size_t wordCount = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> words[wordCount];
+
+public:
+    Seqlock() {
+        for (auto &word: words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    Seqlock(const Seqlock &) = delete;
+
+    Seqlock &operator=(const Seqlock &) = delete;
+
+    /// @brief Publish a new value. Only one thread (or process) may write to a slot at a time; the caller serializes
+    /// writers. Never waits, so a writer that dies partway through can't hold up the next one, but it does leave the
+    /// slot looking mid-write until recoverAbandonedWrite() is called.
+    /// @param value the value to store
+    void write(const T &value) {
+        uint32_t buffer[wordCount] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+
+        // A sequence left odd by an abandoned write is moved on by recoverAbandonedWrite(), so this is even
+        uint32_t start = sequence.load(std::memory_order_relaxed);
+        sequence.store(start + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < wordCount; i++) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        sequence.store(start + 2, std::memory_order_release);
+    }
+
+    /// @brief Make a slot whose writer died partway through a write readable again. Only call once the writer is
+    /// known to be gone: the value may be half written, so treat the version this produces as already seen.
+    /// @param stuckSequence the odd sequence number the slot was left at (see version())
+    /// @return True if the slot was still at stuckSequence and has been moved on to the next even version
+    bool recoverAbandonedWrite(uint32_t stuckSequence) {
+        if ((stuckSequence & 1u) == 0) {
+            return false;
+        }
+        return sequence.compare_exchange_strong(stuckSequence, stuckSequence + 1, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed);
+    }
+
+    /// @brief Attempt to copy out a consistent value without waiting
+    /// @param value where the value is copied to. Only meaningful when true is returned
+    /// @param version set to the sequence number the copy was taken at (even, and increasing with every write)
+    /// @return True if the copy is consistent, false if a write was in progress or happened during the copy
+    bool tryRead(T &value, uint32_t &version) const {
+        uint32_t buffer[wordCount];
+        uint32_t before = sequence.load(std::memory_order_acquire);
+        if ((before & 1u) != 0) {
+            return false;
+        }
+        for (std::size_t i = 0; i < wordCount; i++) {
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != before) {
+            return false;
+        }
+        std::memcpy(&value, buffer, sizeof(T));
+        version = before;
+        return true;
+    }
+
+    /// @brief Copy out a consistent value, retrying until one is obtained
+    /// @param value where the value is copied to
+    /// @return The sequence number the copy was taken at
+    uint32_t read(T &value) const {
+        uint32_t version = 0;
+        while (!tryRead(value, version)) {}
+        return version;
+    }
+
+    /// @brief The current sequence number. Increases by two with every completed write, and is odd while a write is in
+    /// progress.
+    uint32_t version() const {
+        return sequence.load(std::memory_order_acquire);
+    }
+};
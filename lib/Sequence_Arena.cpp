@@ -0,0 +1,100 @@
+#include "Sequence_Arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+SequenceArena::SequenceArena(std::size_t capacity) {
+    addBlock(std::max<std::size_t>(capacity, 1));
+}
+
+void SequenceArena::addBlock(std::size_t size) {
+    blocks.push_back(Block{std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+}
+
+void *SequenceArena::allocate(std::size_t bytes, std::size_t alignment) {
+    while (true) {
+        Block &block = blocks[current];
+        auto address = reinterpret_cast<std::uintptr_t>(block.memory.get()) + used;
+        std::size_t padding = (alignment - address % alignment) % alignment;
+        if (used + padding + bytes <= block.size) {
+            used += padding + bytes;
+            peak = std::max(peak, bytesUsed());
+            return block.memory.get() + used - bytes;
+        }
+        // Move on to the next block, allocating one (at least twice as big as the last) if there isn't one
+        if (current + 1 == blocks.size()) {
+            addBlock(std::max(block.size * 2, bytes + alignment));
+        }
+        current++;
+        used = 0;
+    }
+}
+
+void SequenceArena::reset() {
+    current = 0;
+    used = 0;
+}
+
+std::size_t SequenceArena::bytesUsed() const {
+    std::size_t total = used;
+    for (std::size_t i = 0; i < current; i++) {
+        total += blocks[i].size;
+    }
+    return total;
+}
+
+std::size_t SequenceArena::peakBytesUsed() const {
+    return peak;
+}
+
+std::size_t SequenceArena::blockCount() const {
+    return blocks.size();
+}
+
+const Command *ArenaSequence::begin() const {
+    return commands.data();
+}
+
+const Command *ArenaSequence::end() const {
+    return commands.data() + commands.size();
+}
+
+std::size_t ArenaSequence::size() const {
+    return commands.size();
+}
+
+bool ArenaSequence::empty() const {
+    return commands.empty();
+}
+
+SequenceBuilder::SequenceBuilder(SequenceArena &arena, std::size_t expectedCommands)
+        : commands(ArenaAllocator<Command>(arena)), expectedCommands(expectedCommands) {}
+
+SequenceBuilder &SequenceBuilder::then(const Command &command) {
+    if (commands.capacity() == 0) {
+        commands.reserve(expectedCommands);
+    }
+    commands.push_back(command);
+    return *this;
+}
+
+SequenceBuilder &SequenceBuilder::then(const CommandComponent &acceleration, const CommandComponent &steadyState,
+                                       const CommandComponent &deceleration) {
+    return then(Command{acceleration, steadyState, deceleration});
+}
+
+SequenceBuilder &SequenceBuilder::hold(const pwm_array &thrusterPwms, std::chrono::milliseconds duration) {
+    CommandComponent instant{thrusterPwms, std::chrono::milliseconds(0)};
+    return then(instant, CommandComponent{thrusterPwms, duration}, instant);
+}
+
+std::size_t SequenceBuilder::size() const {
+    return commands.size();
+}
+
+ArenaSequence SequenceBuilder::build() {
+    ArenaSequence sequence(std::move(commands));
+    // Start over with no storage, so nothing is left pointing into the arena if it is reset
+    commands = ArenaSequence::Commands(sequence.commands.get_allocator());
+    return sequence;
+}
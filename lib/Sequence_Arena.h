@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Command.h"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/// @brief A monotonic block of memory for building sequences. Allocating just moves a pointer forward and freeing does
+/// nothing; all the memory is reused at once by reset(). The first block is allocated up front, so as long as
+/// everything fits, building sequences never touches the heap. If it doesn't fit, extra blocks are allocated from the
+/// heap and kept until the arena is destroyed.
+class SequenceArena {
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> memory;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks;
+    std::size_t current = 0; // Index of the block being allocated from
+    std::size_t used = 0; // Bytes used in the current block
+    std::size_t peak = 0;
+
+    void addBlock(std::size_t size);
+
+public:
+    /// @param capacity how many bytes to allocate up front
+    explicit SequenceArena(std::size_t capacity = 64 * 1024);
+
+    SequenceArena(const SequenceArena &) = delete;
+
+    SequenceArena &operator=(const SequenceArena &) = delete;
+
+    /// @brief Reserve memory from the arena. Never returns null.
+    void *allocate(std::size_t bytes, std::size_t alignment);
+
+    /// @brief Make all of the arena's memory available again. Every sequence built from it must be gone by then.
+    void reset();
+
+    /// @brief How many bytes are in use since the last reset
+    std::size_t bytesUsed() const;
+
+    /// @brief The most bytes ever in use at once, useful for sizing the arena
+    std::size_t peakBytesUsed() const;
+
+    /// @brief How many blocks the arena holds. More than 1 means the initial capacity was too small at some point.
+    std::size_t blockCount() const;
+};
+
+/// @brief Standard allocator that takes its memory from a SequenceArena, so standard containers can live in an arena
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    SequenceArena *arena;
+
+    explicit ArenaAllocator(SequenceArena &arena) : arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(std::size_t count) {
+        return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) {}
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T> &left, const ArenaAllocator<U> &right) {
+    return left.arena == right.arena;
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &left, const ArenaAllocator<U> &right) {
+    return left.arena != right.arena;
+}
+
+/// @brief A sequence whose commands live in a SequenceArena. It can only be moved, not copied, so handing it to the
+/// Command Interpreter gives the interpreter the only reference to it. It must not outlive (or be used after a reset
+/// of) its arena.
+class ArenaSequence {
+public:
+    using Commands = std::vector<Command, ArenaAllocator<Command>>;
+
+private:
+    Commands commands;
+
+    friend class SequenceBuilder;
+
+    explicit ArenaSequence(Commands commands) : commands(std::move(commands)) {}
+
+public:
+    ArenaSequence(ArenaSequence &&) = default;
+
+    ArenaSequence &operator=(ArenaSequence &&) = default;
+
+    ArenaSequence(const ArenaSequence &) = delete;
+
+    ArenaSequence &operator=(const ArenaSequence &) = delete;
+
+    const Command *begin() const;
+
+    const Command *end() const;
+
+    std::size_t size() const;
+
+    bool empty() const;
+};
+
+/// @brief Builds an ArenaSequence one command at a time, taking all of its memory from an arena
+class SequenceBuilder {
+private:
+    ArenaSequence::Commands commands;
+    std::size_t expectedCommands;
+
+public:
+    /// @param arena where the commands are stored
+    /// @param expectedCommands how many commands to make room for when the first one is added. Growing past this
+    /// copies the commands within the arena, which wastes arena space but still doesn't touch the heap.
+    explicit SequenceBuilder(SequenceArena &arena, std::size_t expectedCommands = 16);
+
+    /// @brief Append a command to the sequence
+    SequenceBuilder &then(const Command &command);
+
+    /// @brief Append a command made of its three components
+    SequenceBuilder &then(const CommandComponent &acceleration, const CommandComponent &steadyState,
+                          const CommandComponent &deceleration);
+
+    /// @brief Append a command that holds the same pwm values for its whole duration
+    SequenceBuilder &hold(const pwm_array &thrusterPwms, std::chrono::milliseconds duration);
+
+    /// @brief How many commands have been added so far
+    std::size_t size() const;
+
+    /// @brief Hand over the commands added so far. The builder is then empty and can build another sequence (also
+    /// after the arena is reset).
+    ArenaSequence build();
+};
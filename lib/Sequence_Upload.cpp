@@ -0,0 +1,136 @@
+#include "Sequence_Upload.h"
+
+#include <cstdlib>
+#include <utility>
+
+uint32_t uploadChecksum(const char *bytes, std::size_t length, uint32_t hash) {
+    for (std::size_t i = 0; i < length; i++) {
+        hash ^= static_cast<uint8_t>(bytes[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+SequenceUploader::SequenceUploader(PicoLink &link, std::ostream &errorLog, std::chrono::milliseconds replyTimeout,
+                                   std::shared_ptr<InterpreterClock> clock)
+        : link(link), errorLog(errorLog), replyTimeout(replyTimeout), clock(std::move(clock)) {}
+
+bool SequenceUploader::request(const char *message, const std::string &expectedReply) {
+    std::string line(message);
+    line.push_back('\n');
+    if (!link.writeBytes(line.data(), line.size())) {
+        errorLog << "Unable to send " << message << " to the Pico!" << std::endl;
+        return false;
+    }
+    std::string reply;
+    auto deadline = clock->now() + replyTimeout;
+    while (true) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - clock->now());
+        if (remaining.count() < 0 || !link.readLine(reply, remaining)) {
+            errorLog << "Pico did not answer " << message << "!" << std::endl;
+            return false;
+        }
+        if (reply == expectedReply) {
+            return true;
+        }
+        if (reply.find("Failed") != std::string::npos) {
+            errorLog << "Pico refused " << message << ": " << reply << std::endl;
+            return false;
+        }
+    }
+}
+
+bool SequenceUploader::upload(const MissionTimeline &timeline) {
+    if (!timeline.valid()) {
+        errorLog << "Cannot upload an empty timeline!" << std::endl;
+        return false;
+    }
+    const TimelineHeader &header = timeline.header();
+    if (header.entryCount > maxUploadSteps) {
+        errorLog << "Timeline has " << header.entryCount << " steps, but the Pico can only hold " << maxUploadSteps
+                 << "!" << std::endl;
+        return false;
+    }
+
+    std::string transfer = "Upload " + std::to_string(header.entryCount);
+    for (int32_t pin: header.thrusterPins) {
+        transfer += " " + std::to_string(pin);
+    }
+    transfer += "\n";
+
+    std::size_t stepsStart = transfer.size();
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const TimelineEntry &entry = timeline.entry(i);
+        uint64_t endNs = i + 1 < header.entryCount ? timeline.entry(i + 1).offsetNs : header.totalDurationNs;
+        transfer += "Step";
+        for (int32_t pulseWidth: entry.thrusterPwms) {
+            transfer += ' ';
+            transfer += std::to_string(pulseWidth);
+        }
+        transfer += ' ';
+        transfer += std::to_string((endNs - entry.offsetNs) / 1000);
+        transfer += '\n';
+    }
+    uint32_t checksum = uploadChecksum(transfer.data() + stepsStart, transfer.size() - stepsStart);
+    transfer += "End " + std::to_string(checksum) + "\n";
+
+    link.discardInput();
+    if (!link.writeBytes(transfer.data(), transfer.size())) {
+        errorLog << "Unable to send the timeline to the Pico!" << std::endl;
+        return false;
+    }
+    std::string reply;
+    std::string expected = "Uploaded " + std::to_string(header.entryCount) + " " + std::to_string(checksum);
+    auto deadline = clock->now() + replyTimeout;
+    while (true) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - clock->now());
+        if (remaining.count() < 0 || !link.readLine(reply, remaining)) {
+            errorLog << "Pico did not acknowledge the upload!" << std::endl;
+            return false;
+        }
+        if (reply == expected) {
+            return true;
+        }
+        if (reply.compare(0, 9, "Uploaded ") == 0 || reply.compare(0, 13, "Upload Failed") == 0) {
+            errorLog << "Upload was not received intact: " << reply << std::endl;
+            return false;
+        }
+    }
+}
+
+bool SequenceUploader::arm() {
+    return request("Arm", "Armed");
+}
+
+bool SequenceUploader::trigger() {
+    return request("Trigger", "Playing");
+}
+
+SequenceUploader::PlaybackEvent SequenceUploader::waitForEvent(std::chrono::milliseconds timeout, uint32_t &step) {
+    std::string line;
+    auto deadline = clock->now() + timeout;
+    while (true) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - clock->now());
+        if (remaining.count() < 0 || !link.readLine(line, remaining)) {
+            return PlaybackEvent::Timeout;
+        }
+        if (line.compare(0, 9, "Progress ") == 0) {
+            step = static_cast<uint32_t>(std::strtoul(line.c_str() + 9, nullptr, 10));
+            return PlaybackEvent::Progress;
+        }
+        if (line == "Done") {
+            return PlaybackEvent::Done;
+        }
+        if (line.find("Failed") != std::string::npos || line == "Aborted") {
+            errorLog << "Playback stopped: " << line << std::endl;
+            return PlaybackEvent::Failed;
+        }
+    }
+}
+
+bool SequenceUploader::abort() {
+    return request("Abort", "Aborted");
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Interpreter_Clock.h"
+#include "Mission_Compiler.h"
+#include "Pico_Link.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+/*
+ * On-board playback: a compiled timeline is uploaded to the Pico in one transfer, and the Pico times the steps itself.
+ *
+ *   Pi -> Pico  "Upload <steps> <pin0> ... <pin7>\n"
+ *               "Step <pwm0> ... <pwm7> <duration in us>\n"    (once per step)
+ *               "End <checksum>\n"                             (all sent in a single write)
+ *   Pico -> Pi  "Uploaded <steps> <checksum>\n", or "Upload Failed <reason>\n"
+ *   Pi -> Pico  "Arm\n"        Pico replies "Armed\n" and ignores Set messages for the thrusters until playback ends
+ *   Pi -> Pico  "Trigger\n"    Pico replies "Playing\n", then "Progress <step>\n" as each step starts and "Done\n" once
+ *                              the last step's duration is over. Like blind_execute, the thrusters stay at the last
+ *                              step's pwms.
+ *   Pi -> Pico  "Abort\n"      Pico stops playback, sets every thruster to 1500 and replies "Aborted\n"
+ *
+ * The checksum is the 32-bit FNV-1a hash of every Step line, newlines included, in decimal.
+ */
+
+/// @brief The most steps the Pico can hold
+constexpr uint32_t maxUploadSteps = 1024;
+
+/// @brief FNV-1a hash used to check that an upload arrived intact
+uint32_t uploadChecksum(const char *bytes, std::size_t length, uint32_t hash = 2166136261u);
+
+/// @brief Uploads timelines to the Pico and supervises their playback
+class SequenceUploader {
+public:
+    /// @brief What the Pico reported during playback
+    enum class PlaybackEvent {
+        Progress, // A step started
+        Done, // The last step finished
+        Timeout, // Nothing was heard within the timeout
+        Failed // The Pico reported an error, or the link is gone
+    };
+
+private:
+    PicoLink &link;
+    std::ostream &errorLog;
+    std::chrono::milliseconds replyTimeout;
+    std::shared_ptr<InterpreterClock> clock;
+
+    bool request(const char *message, const std::string &expectedReply);
+
+public:
+    /// @param link the connection to the Pico
+    /// @param errorLog where failures are described
+    /// @param replyTimeout how long to wait for the Pico to acknowledge each request
+    /// @param clock what timeouts are measured on
+    SequenceUploader(PicoLink &link, std::ostream &errorLog,
+                     std::chrono::milliseconds replyTimeout = std::chrono::milliseconds(500),
+                     std::shared_ptr<InterpreterClock> clock = std::make_shared<SteadyInterpreterClock>());
+
+    /// @brief Send a timeline to the Pico in a single transfer and check that it arrived intact
+    /// @return True if the Pico acknowledged the right step count and checksum, false otherwise
+    bool upload(const MissionTimeline &timeline);
+
+    /// @brief Hand the thrusters over to the uploaded timeline
+    bool arm();
+
+    /// @brief Start playback. Call after arm().
+    bool trigger();
+
+    /// @brief Wait for the next playback report
+    /// @param timeout how long to wait
+    /// @param step set to the step that started, for PlaybackEvent::Progress
+    PlaybackEvent waitForEvent(std::chrono::milliseconds timeout, uint32_t &step);
+
+    /// @brief Stop playback and send every thruster to neutral
+    bool abort();
+};
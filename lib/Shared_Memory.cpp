@@ -0,0 +1,215 @@
+#include "Shared_Memory.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+    constexpr uint32_t regionMagic = 0x50524f50; // "PROP"
+    constexpr uint32_t regionVersion = 2;
+
+    std::atomic<uint32_t> nextWriterToken{1};
+
+    bool processAlive(int32_t pid) {
+        // EPERM means the process exists but belongs to someone else
+        return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+    }
+
+    int32_t tokenProcess(uint64_t token) {
+        return static_cast<int32_t>(token >> 32);
+    }
+}
+
+PropulsionSharedMemory::PropulsionSharedMemory(std::string name, std::ostream &errorLog,
+                                               std::chrono::milliseconds abandonedWriteTimeout) :
+        name(std::move(name)), errorLog(errorLog), abandonedWriteTimeout(abandonedWriteTimeout),
+        writerToken((static_cast<uint64_t>(getpid()) << 32) | nextWriterToken.fetch_add(1)) {}
+
+bool PropulsionSharedMemory::map(int fd) {
+    void *address = mmap(nullptr, sizeof(PropulsionSharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        errorLog << "Unable to map shared memory " << name << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    region = static_cast<PropulsionSharedRegion *>(address);
+    return true;
+}
+
+bool PropulsionSharedMemory::create() {
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd == -1 && errno == EEXIST) {
+        // Never initialize over a region that a running daemon and its clients have mapped
+        if (!open()) {
+            errorLog << "Shared memory " << name << " already exists and can't be checked; remove it if no daemon is "
+                     << "using it" << std::endl;
+            return false;
+        }
+        int32_t pid = region->daemonPid.load(std::memory_order_acquire);
+        munmap(region, sizeof(PropulsionSharedRegion));
+        region = nullptr;
+        if (processAlive(pid)) {
+            errorLog << "Shared memory " << name << " is already served by process " << pid << "!" << std::endl;
+            return false;
+        }
+        errorLog << "Taking over shared memory " << name << " left behind by a daemon that has exited" << std::endl;
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    }
+    if (fd == -1) {
+        errorLog << "Unable to create shared memory " << name << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, sizeof(PropulsionSharedRegion)) == -1) {
+        errorLog << "Unable to size shared memory " << name << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    if (!map(fd)) {
+        return false;
+    }
+    owner = true;
+    new(region) PropulsionSharedRegion{};
+    region->version = regionVersion;
+    region->daemonPid.store(getpid(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    region->magic = regionMagic;
+    return true;
+}
+
+bool PropulsionSharedMemory::open() {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd == -1) {
+        errorLog << "Unable to open shared memory " << name << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    // Touching a mapping beyond the end of the object would crash, e.g. if its creator died before sizing it
+    struct stat status{};
+    if (fstat(fd, &status) == -1 || status.st_size < static_cast<off_t>(sizeof(PropulsionSharedRegion))) {
+        errorLog << "Shared memory " << name << " has not been set up" << std::endl;
+        close(fd);
+        return false;
+    }
+    if (!map(fd)) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (region->magic != regionMagic || region->version != regionVersion) {
+        errorLog << "Shared memory " << name << " has an unknown layout (version " << region->version << ")"
+                 << std::endl;
+        munmap(region, sizeof(PropulsionSharedRegion));
+        region = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool PropulsionSharedMemory::isOpen() const {
+    return region != nullptr;
+}
+
+bool PropulsionSharedMemory::claimCommandSlot() {
+    if (holdsCommandSlot) {
+        return true;
+    }
+    uint64_t holder = region->commandWriter.load(std::memory_order_acquire);
+    while (holder == 0 || !processAlive(tokenProcess(holder))) {
+        if (region->commandWriter.compare_exchange_weak(holder, writerToken, std::memory_order_acq_rel,
+                                                        std::memory_order_acquire)) {
+            holdsCommandSlot = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PropulsionSharedMemory::writeCommand(const SharedCommand &command) {
+    if (!claimCommandSlot()) {
+        errorLog << "Another client (process " << tokenProcess(region->commandWriter.load()) << ") is commanding the "
+                 << "thrusters through " << name << "; not sending" << std::endl;
+        return false;
+    }
+    region->command.write(command);
+    return true;
+}
+
+bool PropulsionSharedMemory::writeCommand(const pwm_array &pwms) {
+    SharedCommand command{};
+    command.mode = PwmMode;
+    command.pwms = pwms;
+    return writeCommand(command);
+}
+
+bool PropulsionSharedMemory::writeCommand(const force_array &forces) {
+    SharedCommand command{};
+    command.mode = ForceMode;
+    command.forces = forces;
+    return writeCommand(command);
+}
+
+bool PropulsionSharedMemory::readNewCommand(SharedCommand &command, uint32_t &lastVersion) {
+    uint32_t sequence = region->command.version();
+    if ((sequence & 1u) != 0) {
+        auto now = std::chrono::steady_clock::now();
+        if (sequence != stuckSequence) {
+            stuckSequence = sequence;
+            stuckSince = now;
+            return false;
+        }
+        // A write takes nanoseconds, so one that hasn't finished by now was most likely abandoned
+        uint64_t holder = region->commandWriter.load(std::memory_order_acquire);
+        if (now - stuckSince < abandonedWriteTimeout || processAlive(tokenProcess(holder)) ||
+            !region->command.recoverAbandonedWrite(sequence)) {
+            return false;
+        }
+        errorLog << "Client process " << tokenProcess(holder) << " died while writing a command to " << name
+                 << "; skipping it" << std::endl;
+        region->commandWriter.compare_exchange_strong(holder, 0, std::memory_order_acq_rel);
+        // The recovered version holds whatever the client had written so far, so it counts as seen
+        lastVersion = sequence + 1;
+        return false;
+    }
+    uint32_t version = 0;
+    if (sequence == lastVersion || !region->command.tryRead(command, version) || version == lastVersion) {
+        return false;
+    }
+    lastVersion = version;
+    return true;
+}
+
+void PropulsionSharedMemory::writeTelemetry(const std::vector<int> &pinValues, uint64_t commandsApplied) {
+    SharedTelemetry telemetry{};
+    telemetry.pinCount = static_cast<int32_t>(std::min<std::size_t>(pinValues.size(), maxTelemetryPins));
+    for (int i = 0; i < telemetry.pinCount; i++) {
+        telemetry.pinValues[i] = pinValues[i];
+    }
+    telemetry.commandsApplied = commandsApplied;
+    telemetry.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    region->telemetry.write(telemetry);
+}
+
+void PropulsionSharedMemory::readTelemetry(SharedTelemetry &telemetry) const {
+    region->telemetry.read(telemetry);
+}
+
+PropulsionSharedMemory::~PropulsionSharedMemory() {
+    if (region != nullptr && holdsCommandSlot) {
+        uint64_t token = writerToken;
+        region->commandWriter.compare_exchange_strong(token, 0, std::memory_order_acq_rel);
+    }
+    if (region != nullptr) {
+        munmap(region, sizeof(PropulsionSharedRegion));
+    }
+    if (owner) {
+        shm_unlink(name.c_str());
+    }
+}
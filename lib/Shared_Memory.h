@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Command.h"
+#include "Seqlock.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// @brief How the values in a shared command should be interpreted
+enum SharedCommandMode : uint32_t {
+    PwmMode, ForceMode
+};
+
+/// @brief A thruster command as written by a client process into shared memory
+struct SharedCommand {
+    SharedCommandMode mode;
+    pwm_array pwms; // Only meaningful in PwmMode
+    force_array forces; // Only meaningful in ForceMode
+};
+
+/// @brief The maximum number of pin states that fit in the telemetry slot
+constexpr int maxTelemetryPins = 32;
+
+/// @brief Pin states published by the propulsion daemon, in the same order as Command_Interpreter_RPi5::readPins()
+struct SharedTelemetry {
+    int32_t pinCount;
+    int32_t pinValues[maxTelemetryPins];
+    uint64_t commandsApplied; // Total number of commands the daemon has executed
+    int64_t timestampNs; // steady_clock time at which the pin states were read
+};
+
+/// @brief The layout of the shared memory region. Both slots are seqlock protected, so neither side ever blocks
+/// the other and the fast path makes no system calls. Each slot has a single writer: the daemon for telemetry, and
+/// whichever client holds commandWriter for commands.
+struct PropulsionSharedRegion {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<int32_t> daemonPid; // The process serving the region
+    std::atomic<uint64_t> commandWriter; // Token of the client writing commands (process id in the top half), or 0
+    Seqlock<SharedCommand> command;
+    Seqlock<SharedTelemetry> telemetry;
+};
+
+/// @brief A POSIX shared memory region through which other processes can command the thrusters and observe their
+/// state. The propulsion daemon creates the region; clients (planner, vision, etc.) open it. One client at a time
+/// commands the thrusters: the first to write takes the command slot until it is destroyed or its process exits.
+class PropulsionSharedMemory {
+private:
+    std::string name;
+    PropulsionSharedRegion *region = nullptr;
+    bool owner = false;
+    std::ostream &errorLog;
+    std::chrono::milliseconds abandonedWriteTimeout;
+    uint64_t writerToken; // Unique to this object, with the process id in the top half
+    bool holdsCommandSlot = false;
+
+    // Daemon side: an odd command sequence that hasn't moved since stuckSince may be a client that died mid-write
+    uint32_t stuckSequence = 0;
+    std::chrono::steady_clock::time_point stuckSince;
+
+    bool map(int fd);
+
+    bool claimCommandSlot();
+
+    bool writeCommand(const SharedCommand &command);
+
+public:
+    /// @brief Create the region. Should only be called by the propulsion daemon. If a region with this name already
+    /// exists and its daemon is still running, nothing is touched; if its daemon has exited, the region is replaced
+    /// (clients still attached to the old one have to open() again).
+    /// @return True on success, false otherwise (the reason is written to errorLog)
+    bool create();
+
+    /// @brief Attach to an existing region created by the propulsion daemon
+    /// @return True on success, false otherwise (the reason is written to errorLog)
+    bool open();
+
+    /// @brief Whether the region is currently mapped
+    bool isOpen() const;
+
+    /// @brief Send thruster pwm values to the daemon. Call from one thread at a time.
+    /// @param pwms the pwm values, between 1100 and 1900, in the same order as the interpreter's thruster pins
+    /// @return True if sent, false if another live client holds the command slot
+    bool writeCommand(const pwm_array &pwms);
+
+    /// @brief Send thruster forces to the daemon. Call from one thread at a time.
+    /// @param forces the desired force for each thruster, in the same order as the interpreter's thruster pins
+    /// @return True if sent, false if another live client holds the command slot
+    bool writeCommand(const force_array &forces);
+
+    /// @brief Read the latest command if it is newer than the one last seen. If the command slot has been mid-write
+    /// for longer than the abandoned write timeout and its client has exited, the half-written command is skipped and
+    /// the slot is freed for the next client.
+    /// @param command where the command is copied to
+    /// @param lastVersion the version of the last command seen. Updated when a newer command is returned
+    /// @return True if a newer command was copied, false otherwise
+    bool readNewCommand(SharedCommand &command, uint32_t &lastVersion);
+
+    /// @brief Publish the current pin states
+    /// @param pinValues the pin states (see Command_Interpreter_RPi5::readPins()). Extra values beyond
+    /// maxTelemetryPins are dropped
+    /// @param commandsApplied the total number of commands executed so far
+    void writeTelemetry(const std::vector<int> &pinValues, uint64_t commandsApplied);
+
+    /// @brief Read the most recently published pin states
+    /// @param telemetry where the telemetry is copied to
+    void readTelemetry(SharedTelemetry &telemetry) const;
+
+    /// @param name the name of the shared memory object, starting with a slash (e.g. "/propulsion")
+    /// @param errorLog where you want error messages to be logged
+    /// @param abandonedWriteTimeout how long the command slot may look mid-write before the daemon checks whether its
+    /// client has died
+    PropulsionSharedMemory(std::string name, std::ostream &errorLog,
+                           std::chrono::milliseconds abandonedWriteTimeout = std::chrono::milliseconds(100));
+
+    PropulsionSharedMemory(const PropulsionSharedMemory &) = delete;
+
+    PropulsionSharedMemory &operator=(const PropulsionSharedMemory &) = delete;
+
+    /// @brief Gives up the command slot and unmaps the region. The daemon (creator) also unlinks it.
+    ~PropulsionSharedMemory();
+};
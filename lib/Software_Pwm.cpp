@@ -0,0 +1,149 @@
+#include "Software_Pwm.h"
+
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+
+MockGpioBackend::MockGpioBackend(std::size_t expectedEdges, std::shared_ptr<InterpreterClock> edgeClock) :
+        clock(std::move(edgeClock)) {
+    edges.reserve(expectedEdges);
+}
+
+void MockGpioBackend::gpioWrite(int pinNumber, bool high) {
+    auto now = clock->now();
+    std::lock_guard<std::mutex> lock(mutex);
+    edges.push_back(RecordedEdge{pinNumber, high, now});
+}
+
+std::vector<RecordedEdge> MockGpioBackend::recordedEdges() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return edges;
+}
+
+void buildEdgeSchedule(const std::vector<std::pair<int, int>> &pulseWidths, std::chrono::microseconds period,
+                       std::vector<PwmEdge> &edges) {
+    edges.clear();
+    for (const auto &pinAndWidth: pulseWidths) {
+        auto width = std::chrono::microseconds(std::max(0, pinAndWidth.second));
+        if (width.count() == 0) {
+            edges.push_back(PwmEdge{std::chrono::nanoseconds(0), pinAndWidth.first, false});
+            continue;
+        }
+        if (width >= period) {
+            edges.push_back(PwmEdge{std::chrono::nanoseconds(0), pinAndWidth.first, true});
+            continue;
+        }
+        edges.push_back(PwmEdge{std::chrono::nanoseconds(0), pinAndWidth.first, true});
+        edges.push_back(PwmEdge{width, pinAndWidth.first, false});
+    }
+    std::stable_sort(edges.begin(), edges.end(), [](const PwmEdge &a, const PwmEdge &b) {
+        return a.offset < b.offset;
+    });
+}
+
+SoftwarePwmEngine::SoftwarePwmEngine(GpioBackend &backend, std::chrono::microseconds period,
+                                     std::ostream &errorLog, std::shared_ptr<InterpreterClock> engineClock) :
+        backend(backend), period(period), errorLog(errorLog), clock(std::move(engineClock)) {}
+
+void SoftwarePwmEngine::setPulseWidth(int pinNumber, int pulseWidth) {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    auto pin = std::find_if(pendingPulseWidths.begin(), pendingPulseWidths.end(),
+                            [pinNumber](const std::pair<int, int> &entry) { return entry.first == pinNumber; });
+    if (pin == pendingPulseWidths.end()) {
+        pendingPulseWidths.emplace_back(pinNumber, pulseWidth);
+    } else if (pin->second != pulseWidth) {
+        pin->second = pulseWidth;
+    } else {
+        return;
+    }
+    scheduleDirty.store(true, std::memory_order_release);
+}
+
+int SoftwarePwmEngine::pulseWidth(int pinNumber) {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    for (const auto &entry: pendingPulseWidths) {
+        if (entry.first == pinNumber) {
+            return entry.second;
+        }
+    }
+    return -1;
+}
+
+void SoftwarePwmEngine::start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    edgeCount = 0;
+    maximumLatenessNs = 0;
+    totalLatenessNs = 0;
+    scheduleDirty = true;
+    worker = std::thread(&SoftwarePwmEngine::run, this);
+}
+
+void SoftwarePwmEngine::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    worker.join();
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    for (const auto &entry: pendingPulseWidths) {
+        backend.gpioWrite(entry.first, false);
+    }
+}
+
+bool SoftwarePwmEngine::isRunning() const {
+    return running.load();
+}
+
+void SoftwarePwmEngine::recordLateness(std::chrono::nanoseconds lateness) {
+    int64_t latenessNs = std::max<int64_t>(0, lateness.count());
+    edgeCount.fetch_add(1, std::memory_order_relaxed);
+    totalLatenessNs.fetch_add(latenessNs, std::memory_order_relaxed);
+    if (latenessNs > maximumLatenessNs.load(std::memory_order_relaxed)) {
+        maximumLatenessNs.store(latenessNs, std::memory_order_relaxed);
+    }
+}
+
+PwmJitterStats SoftwarePwmEngine::jitter() const {
+    uint64_t count = edgeCount.load();
+    auto total = std::chrono::nanoseconds(totalLatenessNs.load());
+    return PwmJitterStats{count, std::chrono::nanoseconds(maximumLatenessNs.load()),
+                          count == 0 ? std::chrono::nanoseconds(0) : total / static_cast<int64_t>(count)};
+}
+
+void SoftwarePwmEngine::run() {
+    sched_param parameters{};
+    parameters.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters) != 0) {
+        errorLog << "Unable to give the software pwm thread real-time priority; edge jitter may be higher."
+                 << std::endl;
+    }
+
+    auto periodStart = clock->now();
+    while (running.load(std::memory_order_relaxed)) {
+        if (scheduleDirty.exchange(false, std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            buildEdgeSchedule(pendingPulseWidths, period, schedule);
+        }
+
+        for (const PwmEdge &edge: schedule) {
+            auto deadline = periodStart + edge.offset;
+            clock->sleepUntil(deadline);
+            recordLateness(clock->now() - deadline);
+            backend.gpioWrite(edge.pinNumber, edge.high);
+        }
+
+        periodStart += period;
+        auto now = clock->now();
+        if (now > periodStart + period) {
+            // We fell more than a whole period behind (e.g. the thread was suspended); restart the period grid
+            // rather than firing a burst of catch-up pulses.
+            periodStart = now;
+        }
+        clock->sleepUntil(periodStart);
+    }
+}
+
+SoftwarePwmEngine::~SoftwarePwmEngine() {
+    stop();
+}
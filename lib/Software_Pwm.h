@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Interpreter_Clock.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// @brief Something that can set a GPIO pin high or low. The software pwm engine is written against this interface
+/// so it can be run against real hardware or a mock.
+class GpioBackend {
+public:
+    /// @brief Drive a pin to the given level
+    /// @param pinNumber the GPIO number of the pin
+    /// @param high true to drive the pin high, false to drive it low
+    virtual void gpioWrite(int pinNumber, bool high) = 0;
+
+    virtual ~GpioBackend() = default;
+};
+
+/// @brief A single level change recorded by the MockGpioBackend
+struct RecordedEdge {
+    int pinNumber;
+    bool high;
+    std::chrono::steady_clock::time_point time;
+};
+
+/// @brief A GPIO backend that records every edge (with the time it happened) instead of driving hardware
+class MockGpioBackend : public GpioBackend {
+private:
+    mutable std::mutex mutex;
+    std::vector<RecordedEdge> edges;
+    std::shared_ptr<InterpreterClock> clock;
+
+public:
+    void gpioWrite(int pinNumber, bool high) override;
+
+    /// @brief A copy of every edge recorded so far, in the order they happened
+    std::vector<RecordedEdge> recordedEdges() const;
+
+    /// @param expectedEdges how many edges to reserve space for, so recording doesn't allocate while timing
+    /// @param edgeClock what edges are timestamped with. Give it the engine's clock to get exact edge times in tests.
+    explicit MockGpioBackend(std::size_t expectedEdges = 4096,
+                             std::shared_ptr<InterpreterClock> edgeClock = std::make_shared<SteadyInterpreterClock>());
+};
+
+/// @brief A scheduled level change, relative to the start of a pwm period
+struct PwmEdge {
+    std::chrono::nanoseconds offset;
+    int pinNumber;
+    bool high;
+};
+
+/// @brief Compute the edges for one pwm period for all pins at once, sorted by time. Every pin with a non-zero pulse
+/// width rises at the start of the period and falls once its pulse width has elapsed.
+/// @param pulseWidths (pin number, pulse width in microseconds) pairs
+/// @param period the pwm period. Pulse widths are clamped to it
+/// @param edges where the schedule is written. Cleared first; its capacity is reused
+void buildEdgeSchedule(const std::vector<std::pair<int, int>> &pulseWidths, std::chrono::microseconds period,
+                       std::vector<PwmEdge> &edges);
+
+/// @brief How late edges have been written relative to their deadlines
+struct PwmJitterStats {
+    uint64_t edgeCount;
+    std::chrono::nanoseconds maximumLateness;
+    std::chrono::nanoseconds meanLateness;
+};
+
+/// @brief Generates pwm in software for pins without hardware pwm. A single high-priority thread sleeps until
+/// absolute deadlines and writes the edges for every software pwm pin from one sorted schedule, which is only
+/// rebuilt when a pulse width changes.
+class SoftwarePwmEngine {
+private:
+    GpioBackend &backend;
+    std::chrono::microseconds period;
+    std::ostream &errorLog;
+    std::shared_ptr<InterpreterClock> clock;
+
+    std::mutex pendingMutex;
+    std::vector<std::pair<int, int>> pendingPulseWidths;
+    std::atomic<bool> scheduleDirty{false};
+    std::vector<PwmEdge> schedule;
+
+    std::atomic<bool> running{false};
+    std::thread worker;
+
+    std::atomic<uint64_t> edgeCount{0};
+    std::atomic<int64_t> maximumLatenessNs{0};
+    std::atomic<int64_t> totalLatenessNs{0};
+
+    void run();
+
+    void recordLateness(std::chrono::nanoseconds lateness);
+
+public:
+    /// @brief Set the pulse width generated on a pin, adding the pin if it isn't already driven. Takes effect at the
+    /// start of the next period. Safe to call from any thread.
+    /// @param pinNumber the GPIO number of the pin
+    /// @param pulseWidth the pulse width in microseconds (e.g. between 1100 and 1900 for a thruster). 0 holds the pin
+    /// low
+    void setPulseWidth(int pinNumber, int pulseWidth);
+
+    /// @brief The pulse width currently requested for a pin
+    /// @return The pulse width in microseconds, or -1 if the pin isn't driven by this engine
+    int pulseWidth(int pinNumber);
+
+    /// @brief Start the generator thread. Does nothing if it is already running.
+    void start();
+
+    /// @brief Stop the generator thread and drive every pin low
+    void stop();
+
+    /// @brief Whether the generator thread is running
+    bool isRunning() const;
+
+    /// @brief Edge timing measured since the engine was started
+    PwmJitterStats jitter() const;
+
+    /// @param backend what the edges are written to
+    /// @param period the pwm period (20 ms, i.e. 50 Hz, for servo-style thruster controllers)
+    /// @param errorLog where you want error messages to be logged
+    /// @param engineClock what deadlines are measured and slept on. Tests pass a ManualClock-based clock so edge times
+    /// and lateness are exact.
+    SoftwarePwmEngine(GpioBackend &backend, std::chrono::microseconds period, std::ostream &errorLog,
+                      std::shared_ptr<InterpreterClock> engineClock = std::make_shared<SteadyInterpreterClock>());
+
+    SoftwarePwmEngine(const SoftwarePwmEngine &) = delete;
+
+    SoftwarePwmEngine &operator=(const SoftwarePwmEngine &) = delete;
+
+    ~SoftwarePwmEngine();
+};
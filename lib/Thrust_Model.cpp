@@ -0,0 +1,188 @@
+#include "Thrust_Model.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr std::size_t ThrustModel::chunkSize;
+
+void PwmBatch::resize(std::size_t count) {
+    for (auto &column: pulseWidths) {
+        column.resize(count);
+    }
+}
+
+std::size_t PwmBatch::size() const {
+    return pulseWidths[0].size();
+}
+
+void PwmBatch::set(std::size_t index, const pwm_array &pwms) {
+    for (int thruster = 0; thruster < 8; thruster++) {
+        pulseWidths[thruster][index] = static_cast<float>(pwms.pwm_signals[thruster]);
+    }
+}
+
+void ForceBatch::resize(std::size_t count) {
+    for (auto &column: forces) {
+        column.resize(count);
+    }
+}
+
+std::size_t ForceBatch::size() const {
+    return forces[0].size();
+}
+
+void ForceBatch::set(std::size_t index, const force_array &thrusterForces) {
+    for (int thruster = 0; thruster < 8; thruster++) {
+        forces[thruster][index] = thrusterForces.forces[thruster];
+    }
+}
+
+void WrenchBatch::resize(std::size_t count) {
+    for (auto &column: force) {
+        column.resize(count);
+    }
+    for (auto &column: torque) {
+        column.resize(count);
+    }
+    current.resize(count);
+}
+
+std::size_t WrenchBatch::size() const {
+    return current.size();
+}
+
+Wrench WrenchBatch::wrench(std::size_t index) const {
+    return Wrench{{force[0][index], force[1][index], force[2][index]},
+                  {torque[0][index], torque[1][index], torque[2][index]}};
+}
+
+ThrustModel::ThrustModel(const std::array<ThrusterGeometry, 8> &geometry, ThrusterCurve curve) : curve(curve) {
+    for (int thruster = 0; thruster < 8; thruster++) {
+        const float *r = geometry[thruster].position;
+        const float *d = geometry[thruster].direction;
+        columns[thruster][0] = d[0];
+        columns[thruster][1] = d[1];
+        columns[thruster][2] = d[2];
+        columns[thruster][3] = r[1] * d[2] - r[2] * d[1];
+        columns[thruster][4] = r[2] * d[0] - r[0] * d[2];
+        columns[thruster][5] = r[0] * d[1] - r[1] * d[0];
+    }
+}
+
+const ThrusterCurve &ThrustModel::thrusterCurve() const {
+    return curve;
+}
+
+float ThrustModel::thrust(float pulseWidth) const {
+    float forward = std::max(pulseWidth - curve.neutralUs - curve.deadbandUs, 0.0f);
+    float reverse = std::max(curve.neutralUs - curve.deadbandUs - pulseWidth, 0.0f);
+    return curve.forwardThrust * forward * forward - curve.reverseThrust * reverse * reverse;
+}
+
+float ThrustModel::pulseWidth(float thrust) const {
+    if (thrust > 0) {
+        return curve.neutralUs + curve.deadbandUs + std::sqrt(thrust / curve.forwardThrust);
+    }
+    if (thrust < 0) {
+        return curve.neutralUs - curve.deadbandUs - std::sqrt(-thrust / curve.reverseThrust);
+    }
+    return curve.neutralUs;
+}
+
+float ThrustModel::current(float pulseWidth) const {
+    float forward = std::max(pulseWidth - curve.neutralUs - curve.deadbandUs, 0.0f);
+    float reverse = std::max(curve.neutralUs - curve.deadbandUs - pulseWidth, 0.0f);
+    return curve.forwardCurrent * forward * forward + curve.reverseCurrent * reverse * reverse;
+}
+
+Wrench ThrustModel::wrench(const pwm_array &pwms) const {
+    force_array thrusterForces{};
+    for (int thruster = 0; thruster < 8; thruster++) {
+        thrusterForces.forces[thruster] = thrust(static_cast<float>(pwms.pwm_signals[thruster]));
+    }
+    return wrench(thrusterForces);
+}
+
+Wrench ThrustModel::wrench(const force_array &thrusterForces) const {
+    float total[6] = {};
+    for (int thruster = 0; thruster < 8; thruster++) {
+        for (int axis = 0; axis < 6; axis++) {
+            total[axis] += thrusterForces.forces[thruster] * columns[thruster][axis];
+        }
+    }
+    return Wrench{{total[0], total[1], total[2]}, {total[3], total[4], total[5]}};
+}
+
+// The inner loops are branch-free and work on contiguous, non-aliasing floats so the compiler turns them into SIMD
+// (NEON on the Pi 5) without intrinsics
+template<bool FromPwm>
+void ThrustModel::evaluateRange(const std::array<std::vector<float>, 8> &inputs, WrenchBatch &output,
+                                std::size_t begin, std::size_t end) const {
+    const std::size_t count = end - begin;
+    float *__restrict outputs[7] = {output.force[0].data() + begin, output.force[1].data() + begin,
+                                    output.force[2].data() + begin, output.torque[0].data() + begin,
+                                    output.torque[1].data() + begin, output.torque[2].data() + begin,
+                                    output.current.data() + begin};
+    for (float *column: outputs) {
+        std::fill(column, column + count, 0.0f);
+    }
+
+    // For forces, the current comes from the pulse width each force needs: past the deadband both are quadratic,
+    // so current is proportional to force
+    const float forwardCurrentPerNewton = curve.forwardCurrent / curve.forwardThrust;
+    const float reverseCurrentPerNewton = curve.reverseCurrent / curve.reverseThrust;
+    const float forwardStart = curve.neutralUs + curve.deadbandUs;
+    const float reverseStart = curve.neutralUs - curve.deadbandUs;
+
+    float thrusts[chunkSize];
+    for (int thruster = 0; thruster < 8; thruster++) {
+        const float *__restrict input = inputs[thruster].data() + begin;
+        float *__restrict current = outputs[6];
+        for (std::size_t i = 0; i < count; i++) {
+            if (FromPwm) {
+                float forward = std::max(input[i] - forwardStart, 0.0f);
+                float reverse = std::max(reverseStart - input[i], 0.0f);
+                thrusts[i] = curve.forwardThrust * forward * forward - curve.reverseThrust * reverse * reverse;
+                current[i] += curve.forwardCurrent * forward * forward + curve.reverseCurrent * reverse * reverse;
+            } else {
+                thrusts[i] = input[i];
+                current[i] += forwardCurrentPerNewton * std::max(input[i], 0.0f) +
+                              reverseCurrentPerNewton * std::max(-input[i], 0.0f);
+            }
+        }
+        for (int axis = 0; axis < 6; axis++) {
+            const float weight = columns[thruster][axis];
+            float *__restrict column = outputs[axis];
+            for (std::size_t i = 0; i < count; i++) {
+                column[i] += weight * thrusts[i];
+            }
+        }
+    }
+}
+
+namespace {
+    template<typename Evaluate>
+    void forEachChunk(std::size_t count, WorkStealingPool *pool, Evaluate evaluate) {
+        if (pool == nullptr) {
+            for (std::size_t begin = 0; begin < count; begin += ThrustModel::chunkSize) {
+                evaluate(begin, std::min(count, begin + ThrustModel::chunkSize));
+            }
+            return;
+        }
+        pool->parallelFor(count, ThrustModel::chunkSize, evaluate);
+    }
+}
+
+void ThrustModel::evaluate(const PwmBatch &batch, WrenchBatch &output, WorkStealingPool *pool) const {
+    output.resize(batch.size());
+    forEachChunk(batch.size(), pool, [&](std::size_t begin, std::size_t end) {
+        evaluateRange<true>(batch.pulseWidths, output, begin, end);
+    });
+}
+
+void ThrustModel::evaluate(const ForceBatch &batch, WrenchBatch &output, WorkStealingPool *pool) const {
+    output.resize(batch.size());
+    forEachChunk(batch.size(), pool, [&](std::size_t begin, std::size_t end) {
+        evaluateRange<false>(batch.forces, output, begin, end);
+    });
+}
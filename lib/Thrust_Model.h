@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Command.h"
+#include "Parallel_For.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/// @brief Where a thruster is and which way it pushes, in the body frame
+struct ThrusterGeometry {
+    float position[3]; // Meters from the center of mass (x forwards, y left, z up)
+    float direction[3]; // Unit vector of the force produced by a positive thrust
+};
+
+/// @brief Thrust and current as a function of pulse width. Outside the deadband, thrust and current both grow with
+/// the square of the distance from the deadband edge. The defaults are a fit to Blue Robotics' published T200 curve at
+/// 16 V (about 51 N / 24 A at 1900 and 40 N / 20 A at 1100).
+struct ThrusterCurve {
+    float neutralUs = 1500;
+    float deadbandUs = 25; // Either side of neutral
+    float forwardThrust = 3.66e-4f; // Newtons per us^2 past the deadband
+    float reverseThrust = 2.86e-4f;
+    float forwardCurrent = 1.71e-4f; // Amps per us^2 past the deadband
+    float reverseCurrent = 1.42e-4f;
+};
+
+/// @brief Force and torque on the body
+struct Wrench {
+    float force[3]; // Newtons
+    float torque[3]; // Newton meters
+};
+
+/// @brief Many candidate commands laid out column by column (structure of arrays), so each thruster's values are
+/// contiguous
+struct PwmBatch {
+    std::array<std::vector<float>, 8> pulseWidths;
+
+    void resize(std::size_t count);
+
+    std::size_t size() const;
+
+    void set(std::size_t index, const pwm_array &pwms);
+};
+
+/// @brief Many candidate thruster forces, laid out like PwmBatch
+struct ForceBatch {
+    std::array<std::vector<float>, 8> forces; // Newtons, positive along each thruster's direction
+
+    void resize(std::size_t count);
+
+    std::size_t size() const;
+
+    void set(std::size_t index, const force_array &thrusterForces);
+};
+
+/// @brief The result of evaluating a batch, also as structure of arrays
+struct WrenchBatch {
+    std::array<std::vector<float>, 3> force;
+    std::array<std::vector<float>, 3> torque;
+    std::vector<float> current; // Total amps drawn by the thrusters
+
+    void resize(std::size_t count);
+
+    std::size_t size() const;
+
+    Wrench wrench(std::size_t index) const;
+};
+
+/// @brief Forward model from thruster commands to the wrench they put on the body and the current they draw
+class ThrustModel {
+public:
+    /// @brief How many candidates each chunk of a parallel evaluation holds (small enough to stay in L1)
+    static constexpr std::size_t chunkSize = 512;
+
+private:
+    ThrusterCurve curve;
+    float columns[8][6]; // Wrench produced by 1 N from each thruster: direction, then position x direction
+
+    template<bool FromPwm>
+    void evaluateRange(const std::array<std::vector<float>, 8> &inputs, WrenchBatch &output, std::size_t begin,
+                       std::size_t end) const;
+
+public:
+    /// @param geometry the thrusters in the same order as pwm_array and force_array
+    /// @param curve the pwm to thrust and current curve shared by every thruster
+    explicit ThrustModel(const std::array<ThrusterGeometry, 8> &geometry, ThrusterCurve curve = ThrusterCurve{});
+
+    const ThrusterCurve &thrusterCurve() const;
+
+    /// @brief Thrust of one thruster at the given pulse width, in Newtons
+    float thrust(float pulseWidth) const;
+
+    /// @brief The pulse width at which one thruster produces the given thrust (the inverse of thrust()). Zero thrust
+    /// gives neutral. The result isn't limited to the pulse widths the thrusters accept.
+    float pulseWidth(float thrust) const;
+
+    /// @brief Current drawn by one thruster at the given pulse width, in amps
+    float current(float pulseWidth) const;
+
+    Wrench wrench(const pwm_array &pwms) const;
+
+    Wrench wrench(const force_array &thrusterForces) const;
+
+    /// @brief Evaluate every candidate in a batch
+    /// @param batch the candidates
+    /// @param output resized to match the batch and filled in
+    /// @param pool if given, the batch is split across its threads
+    void evaluate(const PwmBatch &batch, WrenchBatch &output, WorkStealingPool *pool = nullptr) const;
+
+    /// @brief Evaluate every candidate in a batch. Current is estimated from the pulse width each force needs.
+    void evaluate(const ForceBatch &batch, WrenchBatch &output, WorkStealingPool *pool = nullptr) const;
+};
@@ -0,0 +1,113 @@
+#include "Watchdog.h"
+
+#include <algorithm>
+#include <utility>
+
+constexpr std::size_t ThrusterWatchdog::maxFrameLength;
+
+ThrusterWatchdog::ThrusterWatchdog(std::chrono::nanoseconds deadline) : deadline(deadline) {}
+
+int64_t ThrusterWatchdog::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ThrusterWatchdog::arm(const std::vector<int> &thrusterPinNumbers, FrameSink frameSink) {
+    if (worker.joinable()) {
+        return false;
+    }
+    std::size_t length = 0;
+    for (int pinNumber: thrusterPinNumbers) {
+        if (length + maxMessageLength > maxFrameLength) {
+            neutralFrameLength = 0;
+            return false;
+        }
+        length += formatPwmMessage(neutralFrame + length, pinNumber, 1500);
+    }
+    neutralFrameLength = length;
+    sink = std::move(frameSink);
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = false;
+    }
+    feed();
+    worker = std::thread(&ThrusterWatchdog::run, this);
+    return true;
+}
+
+void ThrusterWatchdog::disarm() {
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopSignal.notify_all();
+    worker.join();
+}
+
+bool ThrusterWatchdog::armed() const {
+    return worker.joinable();
+}
+
+void ThrusterWatchdog::feed() {
+    lastFeedNs.store(nowNs(), std::memory_order_release);
+}
+
+std::unique_lock<std::mutex> ThrusterWatchdog::holdOffTrip() {
+    return std::unique_lock<std::mutex>(tripMutex);
+}
+
+bool ThrusterWatchdog::consumeTrip() {
+    return tripPending.exchange(false, std::memory_order_acq_rel);
+}
+
+ThrusterWatchdog::Statistics ThrusterWatchdog::statistics() const {
+    return Statistics{trips.load(), std::chrono::nanoseconds(lastReactionNs.load()),
+                      std::chrono::nanoseconds(maximumReactionNs.load())};
+}
+
+void ThrusterWatchdog::run() {
+    // Once tripped, stay quiet until a fresh command arrives rather than resending neutral every deadline
+    int64_t trippedFeedNs = -1;
+    // How often to look for a fresh command after tripping
+    auto idlePoll = std::min<std::chrono::nanoseconds>(deadline, std::chrono::milliseconds(10));
+
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (!stopping) {
+        int64_t feedNs = lastFeedNs.load(std::memory_order_acquire);
+        auto expiry = std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::nanoseconds(feedNs) + deadline));
+
+        if (feedNs == trippedFeedNs) {
+            stopSignal.wait_for(lock, idlePoll);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < expiry) {
+            stopSignal.wait_until(lock, expiry);
+            continue;
+        }
+        {
+            // A command written since the feed was read has been fed by the time this lock is free
+            std::lock_guard<std::mutex> held(tripMutex);
+            if (lastFeedNs.load(std::memory_order_acquire) != feedNs) {
+                continue;
+            }
+            sink(neutralFrame, neutralFrameLength);
+        }
+        int64_t reactionNs = std::max<int64_t>(0, (std::chrono::steady_clock::now() - expiry).count());
+        trippedFeedNs = feedNs;
+        lastReactionNs.store(reactionNs, std::memory_order_relaxed);
+        if (reactionNs > maximumReactionNs.load(std::memory_order_relaxed)) {
+            maximumReactionNs.store(reactionNs, std::memory_order_relaxed);
+        }
+        trips.fetch_add(1, std::memory_order_relaxed);
+        tripPending.store(true, std::memory_order_release);
+    }
+}
+
+ThrusterWatchdog::~ThrusterWatchdog() {
+    disarm();
+}
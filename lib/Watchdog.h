@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Message_Format.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Drives every thruster to neutral (1500) if no fresh command arrives within a deadline, e.g. because the
+/// controlling process hung or the planner stopped sending. Runs on its own timer thread. The neutral frame is
+/// formatted once when the watchdog is armed, so tripping never allocates and costs a single write.
+class ThrusterWatchdog {
+public:
+    /// @brief Writes a whole frame to the Pico in one go
+    using FrameSink = std::function<void(const char *, std::size_t)>;
+
+    /// @brief Room for a neutral message for every Pico pin
+    static constexpr std::size_t maxFrameLength = 30 * maxMessageLength;
+
+private:
+    std::chrono::nanoseconds deadline;
+    FrameSink sink;
+    char neutralFrame[maxFrameLength] = {};
+    std::size_t neutralFrameLength = 0;
+
+    std::atomic<int64_t> lastFeedNs{0};
+    std::atomic<bool> tripPending{false};
+    std::atomic<uint64_t> trips{0};
+    std::atomic<int64_t> lastReactionNs{0};
+    std::atomic<int64_t> maximumReactionNs{0};
+
+    std::mutex tripMutex; // Held by a trip and by whoever writes a command and feeds
+
+    std::mutex stopMutex;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+    std::thread worker;
+
+    void run();
+
+    static int64_t nowNs();
+
+public:
+    /// @brief Reaction statistics since the watchdog was armed
+    struct Statistics {
+        uint64_t trips; // How many times thrusters were driven to neutral
+        std::chrono::nanoseconds lastReaction; // Time from the deadline expiring to the neutral frame being written
+        std::chrono::nanoseconds maximumReaction;
+    };
+
+    /// @brief Preformat the neutral frame and start the timer thread. Counts as a feed.
+    /// @param thrusterPinNumbers the GPIO numbers of the thruster pins to drive to neutral
+    /// @param frameSink what the neutral frame is written through. Called from the timer thread
+    /// @return False if the watchdog is already armed or the pins don't fit in one frame, true otherwise
+    bool arm(const std::vector<int> &thrusterPinNumbers, FrameSink frameSink);
+
+    /// @brief Stop the timer thread. Does nothing if the watchdog isn't armed.
+    void disarm();
+
+    /// @brief Whether the timer thread is running
+    bool armed() const;
+
+    /// @brief Record that a fresh command has been sent, pushing the deadline back. Lock-free; safe to call from
+    /// any thread.
+    void feed();
+
+    /// @brief Keep the watchdog from tripping until the returned lock is released. Hold it while writing a command and
+    /// feeding, so a trip can't land between the two and overwrite the fresh command with neutral. Don't disarm while
+    /// holding it.
+    std::unique_lock<std::mutex> holdOffTrip();
+
+    /// @brief Whether the watchdog has driven the thrusters to neutral since this was last called
+    /// @return True (once per trip) if a trip happened, false otherwise
+    bool consumeTrip();
+
+    /// @brief A snapshot of the trip and reaction time counters
+    Statistics statistics() const;
+
+    /// @param deadline how long without a fresh command before the thrusters are driven to neutral
+    explicit ThrusterWatchdog(std::chrono::nanoseconds deadline);
+
+    ThrusterWatchdog(const ThrusterWatchdog &) = delete;
+
+    ThrusterWatchdog &operator=(const ThrusterWatchdog &) = delete;
+
+    ~ThrusterWatchdog();
+};
@@ -1,21 +1,35 @@
 // William Barber
 
 #include "Wiring.h"
+#include "Software_Pwm.h"
+#include "Coalescing_Writer.h"
+#include "Energy_Accounting.h"
+#include "Frame_Recorder.h"
+#include "Message_Format.h"
+#include "Metrics.h"
 
+#include <chrono>
 #include <iostream>
 #include <string>
+#include <utility>
+
+static_assert(PicoConnection::maxRestoreFrameLength >= 32 * 2 * maxMessageLength,
+              "The restore frame must fit a configure and a state message for every pin");
+static_assert(CoalescingWriter::maxPins >= 32, "Every pin WiringControl accepts must be able to be coalesced");
 
 // When compiling for non-RPI devices which cannot run wiringPi library,
 // use -MOCK_RPI flag to enable mock functions
 #ifdef MOCK_RPI
 
 bool WiringControl::initializeSerial() {
-    return true;
-}
-
-
-void WiringControl::printToSerial(const std::string& message) {
-    output << message;
+    if (connection == nullptr) {
+        return true;
+    }
+    bool connected = connection->connect(this, [this](char *frame, std::size_t capacity) {
+        return formatRestoreFrame(frame, capacity);
+    });
+    attachPicoLink(connection);
+    return connected;
 }
 
 #else
@@ -23,115 +37,425 @@ void WiringControl::printToSerial(const std::string& message) {
 #include "Serial.h"
 
 bool WiringControl::initializeSerial() {
-    if ((serial = serialOpen("/dev/serial/by-id/usb-MicroPython_Board_in_FS_mode_e66130100f198434-if00", 115200)) < 0) {
-        return false;
+    if (recorder != nullptr) {
+        // Nothing to connect to: the recorder stands in for the Pico
+        return true;
     }
-    return true;
+    if (connection == nullptr) {
+        connection = std::make_shared<PicoConnection>([]() {
+            return serialOpen("/dev/serial/by-id/usb-MicroPython_Board_in_FS_mode_e66130100f198434-if00",
+                              defaultBaudRate);
+        }, outLog, errorLog);
+        // The Pico starts at the default rate whenever it is plugged back in
+        connection->setOpenHook([this](PicoLink &link) {
+            negotiateLink(link, LinkNegotiationSettings{});
+        });
+    }
+    bool connected = connection->connect(this, [this](char *frame, std::size_t capacity) {
+        return formatRestoreFrame(frame, capacity);
+    });
+    attachPicoLink(connection);
+    return connected;
+}
+
+#endif
+
+/// @brief The metrics a WiringControl updates, shared by its copies
+struct WiringMetrics {
+    std::shared_ptr<MetricsRegistry> registry;
+    Counter &bytesWritten;
+    Counter &framesWritten;
+    Counter &failedWrites;
+    Histogram &writeLatency;
+    Gauge &coalescingQueueDepth;
+    Gauge *pulseWidths[32] = {}; // Guarded by the state mutex
+
+    explicit WiringMetrics(std::shared_ptr<MetricsRegistry> metricsRegistry) :
+            registry(std::move(metricsRegistry)),
+            bytesWritten(registry->counter("propulsion_bytes_written_total", "Bytes written to the Pico")),
+            framesWritten(registry->counter("propulsion_frames_written_total", "Frames written to the Pico")),
+            failedWrites(registry->counter("propulsion_failed_writes_total",
+                                           "Frames that couldn't be written because the Pico was unreachable")),
+            writeLatency(registry->histogram("propulsion_write_latency_microseconds",
+                                             "How long each frame took to write to the Pico",
+                                             {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000})),
+            coalescingQueueDepth(registry->gauge("propulsion_coalescing_queue_depth",
+                                                 "Pins with a pwm value waiting to be sent in coalescing mode")) {}
+
+    void trackPulseWidth(int pinNumber, int pulseWidth) {
+        if (pinNumber < 0 || pinNumber > 31) {
+            return;
+        }
+        if (pulseWidths[pinNumber] == nullptr) {
+            pulseWidths[pinNumber] = &registry->gauge("propulsion_pwm_pulse_width_microseconds",
+                                                      "The pwm value each pin was last set to",
+                                                      "pin=\"" + std::to_string(pinNumber) + "\"");
+        }
+        pulseWidths[pinNumber]->set(pulseWidth);
+    }
+
+    void recordWrite(std::size_t length, std::chrono::steady_clock::time_point start, bool written) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        writeLatency.observe(static_cast<uint64_t>(
+                                     std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+        if (!written) {
+            failedWrites.add();
+            return;
+        }
+        bytesWritten.add(length);
+        framesWritten.add();
+    }
+};
+
+/// @return False if the connection is down or the write failed
+static bool sendFrame(std::ostream &output, std::mutex &outputMutex, PicoConnection *connection,
+                      FrameRecorder *recorder, const char *frame, std::size_t length) {
+    if (recorder != nullptr) {
+        recorder->record(frame, length);
+        return true;
+    }
+    if (connection == nullptr) {
+        // The control thread, the coalescing writer and the watchdog can all get here at once
+        std::lock_guard<std::mutex> lock(outputMutex);
+        output.write(frame, static_cast<std::streamsize>(length));
+        return true;
+    }
+    // A failed write is reported and recovered from by the connection, and the restore frame carries the change
+    return connection->writeBytes(frame, length);
+}
+
+void WiringControl::enableCoalescing() {
+    std::ostream *sinkOutput = &output;
+    std::shared_ptr<std::mutex> sinkOutputMutex = outputMutex;
+    std::shared_ptr<PicoConnection> sinkConnection = connection;
+    std::shared_ptr<WiringMetrics> sinkMetrics = metrics;
+    std::shared_ptr<FrameRecorder> sinkRecorder = recorder;
+    coalescingWriter = std::make_shared<CoalescingWriter>(
+            [sinkOutput, sinkOutputMutex, sinkConnection, sinkMetrics, sinkRecorder](const char *frame,
+                                                                                     std::size_t length) {
+                auto start = std::chrono::steady_clock::now();
+                bool written = sendFrame(*sinkOutput, *sinkOutputMutex, sinkConnection.get(), sinkRecorder.get(),
+                                         frame, length);
+                if (sinkConnection != nullptr) {
+                    // Wait for the frame to leave so newer values keep merging until the link is free again
+                    sinkConnection->drain();
+                }
+                if (sinkMetrics != nullptr) {
+                    sinkMetrics->recordWrite(length, start, written);
+                }
+            });
+    if (metrics != nullptr) {
+        coalescingWriter->reportQueueDepth(&metrics->coalescingQueueDepth);
+    }
+}
+
+void WiringControl::attachMetrics(std::shared_ptr<MetricsRegistry> registry) {
+    auto attached = std::make_shared<WiringMetrics>(std::move(registry));
+    std::lock_guard<std::mutex> lock(state->mutex);
+    for (int pinNumber = 0; pinNumber < 32; pinNumber++) {
+        if (((state->configuredPins >> pinNumber) & 1u) != 0 &&
+            (state->pinTypes[pinNumber] == HardwarePWM || state->pinTypes[pinNumber] == SoftwarePWM)) {
+            attached->trackPulseWidth(pinNumber, state->pwmPinStatuses[pinNumber].pulseWidth);
+        }
+    }
+    metrics = attached;
+}
+
+void WiringControl::attachEnergyMeter(std::shared_ptr<ThrusterEnergyMeter> meter) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    for (int pinNumber = 0; pinNumber < 32; pinNumber++) {
+        if (((state->configuredPins >> pinNumber) & 1u) != 0 &&
+            (state->pinTypes[pinNumber] == HardwarePWM || state->pinTypes[pinNumber] == SoftwarePWM)) {
+            meter->record(pinNumber, state->pwmPinStatuses[pinNumber].pulseWidth);
+        }
+    }
+    energyMeter = std::move(meter);
 }
 
 void WiringControl::printToSerial(const std::string &message) {
-    if (serial == -1) {
-        output << message;
-    } else {
-        serialPuts(serial, message.c_str());
+    writeFrame(message.data(), message.size());
+}
+
+void WiringControl::writeFrame(const char *frame, std::size_t length) {
+    if (metrics == nullptr) {
+        sendFrame(output, *outputMutex, connection.get(), recorder.get(), frame, length);
+        return;
     }
+    auto start = std::chrono::steady_clock::now();
+    bool written = sendFrame(output, *outputMutex, connection.get(), recorder.get(), frame, length);
+    metrics->recordWrite(length, start, written);
 }
 
-#endif
+void WiringControl::useConnection(std::shared_ptr<PicoConnection> picoConnection) {
+    connection = std::move(picoConnection);
+}
+
+PicoConnection *WiringControl::picoConnection() const {
+    return connection.get();
+}
+
+void WiringControl::recordFramesTo(std::shared_ptr<FrameRecorder> frameRecorder) {
+    recorder = std::move(frameRecorder);
+}
 
-WiringControl::WiringControl(std::ostream &output, std::ostream &outLog, std::ostream &errorLog) : output(output),
-                                                                                                      outLog(outLog),
-                                                                                                      errorLog(
-                                                                                                              errorLog) {};
+std::size_t WiringControl::formatRestoreFrame(char *frame, std::size_t capacity) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    uint32_t digitalPinStatuses = state->digitalPinStatuses.load(std::memory_order_acquire);
+    std::size_t length = 0;
+    for (int pinNumber = 0; pinNumber < 32; pinNumber++) {
+        if (((state->configuredPins >> pinNumber) & 1u) == 0) {
+            continue;
+        }
+        PinType pinType = state->pinTypes[pinNumber];
+        if (length + 2 * maxMessageLength > capacity) {
+            errorLog << "Not enough room to restore pin " << pinNumber << "!" << std::endl;
+            break;
+        }
+        length += formatConfigureMessage(frame + length, pinNumber, pinType, softwarePwmEngine != nullptr);
+        switch (pinType) {
+            case DigitalActiveHigh:
+            case DigitalActiveLow:
+                length += formatDigitalMessage(frame + length, pinNumber,
+                                               (digitalPinStatuses >> pinNumber) & 1u ? High : Low);
+                break;
+            case SoftwarePWM:
+                if (softwarePwmEngine != nullptr) {
+                    break; // Generated here rather than on the Pico
+                }
+                // fall through
+            case HardwarePWM:
+                length += formatPwmMessage(frame + length, pinNumber, state->pwmPinStatuses[pinNumber].pulseWidth);
+                break;
+        }
+    }
+    return length;
+}
+
+WiringControl::WiringControl(std::ostream &output, std::ostream &outLog, std::ostream &errorLog) :
+        state(std::make_shared<CachedState>()), outputMutex(std::make_shared<std::mutex>()), output(output),
+        outLog(outLog), errorLog(errorLog) {};
+
+// The cache is always updated before the message is written. That way a reconnect that happens around a write
+// restores the new state: either the write reaches the new connection, or the restore frame carries the change.
 
 void WiringControl::setPinType(int pinNumber, PinType pinType) {
-    std::string message = "Configure ";
-    message.append(std::to_string(pinNumber));
+    if (pinNumber < 0 || pinNumber > 31) {
+        errorLog << "Invalid pin number " << pinNumber << "! Exiting." << std::endl;
+        exit(42);
+    }
+    char message[maxMessageLength];
+    std::size_t length = formatConfigureMessage(message, pinNumber, pinType, softwarePwmEngine != nullptr);
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        switch (pinType) {
+            case DigitalActiveHigh:
+            case DigitalActiveLow:
+                // Start disabled
+                if (pinType == DigitalActiveLow) {
+                    state->digitalPinStatuses.fetch_or(1u << pinNumber, std::memory_order_release);
+                } else {
+                    state->digitalPinStatuses.fetch_and(~(1u << pinNumber), std::memory_order_release);
+                }
+                break;
+            case HardwarePWM:
+            case SoftwarePWM:
+                state->pwmPinStatuses[pinNumber] = PwmPinStatus{1500, 0};
+                if (energyMeter != nullptr) {
+                    energyMeter->record(pinNumber, 1500);
+                }
+                break;
+            default:
+                errorLog << "Impossible pin type " << pinType << "! Exiting." << std::endl;
+                exit(42);
+        }
+        state->pinTypes[pinNumber] = pinType;
+        state->configuredPins |= 1u << pinNumber;
+    }
+    writeFrame(message, length);
     switch (pinType) {
         case DigitalActiveHigh:
-            message.append(" Digital\n");
-            printToSerial(message);
-            pinTypes[pinNumber] = DigitalActiveHigh;
             digitalWrite(pinNumber, Low);
-            digitalPinStatuses[pinNumber] = Low;
             break;
         case DigitalActiveLow:
-            message.append(" Digital\n");
-            printToSerial(message);
-            pinTypes[pinNumber] = DigitalActiveLow;
             digitalWrite(pinNumber, High);
-            digitalPinStatuses[pinNumber] = High;
             break;
-        case HardwarePWM:
-            message.append(" HardPwm\n");
-            printToSerial(message);
-            pinTypes[pinNumber] = HardwarePWM;
-            pwmWrite(pinNumber, 1500);
-            pwmPinStatuses[pinNumber] = PwmPinStatus{1500, 0};
-            break;
-        case SoftwarePWM:
-            message.append(" SoftPwm\n");
-            printToSerial(message);
-            pinTypes[pinNumber] = SoftwarePWM;
+        default:
             pwmWrite(pinNumber, 1500);
-            pwmPinStatuses[pinNumber] = PwmPinStatus{1500, 0};
             break;
-        default:
-            errorLog << "Impossible pin type " << pinType << "! Exiting." << std::endl;
-            exit(42);
     }
-    pinTypes[pinNumber] = pinType;
 }
 
 void WiringControl::digitalWrite(int pinNumber, DigitalPinStatus digitalPinStatus) {
-    std::string message = "Set ";
-    message.append(std::to_string(pinNumber));
+    if (pinNumber < 0 || pinNumber > 31) {
+        errorLog << "Invalid digital pin number " << pinNumber << "! Exiting." << std::endl;
+        exit(42);
+    }
+    char message[maxMessageLength];
     switch (digitalPinStatus) {
         case Low:
-            message.append(" Digital Low\n");
-            printToSerial(message);
-            digitalPinStatuses[pinNumber] = Low;
-            break;
         case High:
-            message.append(" Digital High\n");
-            printToSerial(message);
-            digitalPinStatuses[pinNumber] = High;
             break;
         default:
             errorLog << "Impossible digital pin status " << digitalPinStatus << "! Exiting." << std::endl;
             exit(42);
     }
-    digitalPinStatuses[pinNumber] = digitalPinStatus;
+    if (digitalPinStatus == High) {
+        state->digitalPinStatuses.fetch_or(1u << pinNumber, std::memory_order_release);
+    } else {
+        state->digitalPinStatuses.fetch_and(~(1u << pinNumber), std::memory_order_release);
+    }
+    writeFrame(message, formatDigitalMessage(message, pinNumber, digitalPinStatus));
 }
 
-DigitalPinStatus WiringControl::digitalRead(int pinNumber) {
-    return digitalPinStatuses[pinNumber];
+void WiringControl::digitalWriteMask(uint32_t highMask, uint32_t lowMask) {
+    lowMask &= ~highMask;
+    uint32_t changed = highMask | lowMask;
+    if (changed == 0) {
+        return;
+    }
+    char frame[32 * maxMessageLength];
+    std::size_t length = 0;
+    for (int pinNumber = 0; pinNumber < 32; pinNumber++) {
+        uint32_t bit = 1u << pinNumber;
+        if ((changed & bit) != 0) {
+            length += formatDigitalMessage(frame + length, pinNumber, (highMask & bit) != 0 ? High : Low);
+        }
+    }
+    // One exchange, so readers see every pin in the masks change at once
+    uint32_t current = state->digitalPinStatuses.load(std::memory_order_relaxed);
+    while (!state->digitalPinStatuses.compare_exchange_weak(current, (current | highMask) & ~lowMask,
+                                                            std::memory_order_release, std::memory_order_relaxed)) {}
+    writeFrame(frame, length);
+}
+
+uint32_t WiringControl::digitalReadMask() const {
+    return state->digitalPinStatuses.load(std::memory_order_acquire);
+}
+
+DigitalPinStatus WiringControl::digitalRead(int pinNumber) const {
+    if (pinNumber < 0 || pinNumber > 31) {
+        return Low;
+    }
+    return (digitalReadMask() >> pinNumber) & 1u ? High : Low;
 }
 
 void WiringControl::pwmWrite(int pinNumber, int pulseWidth) {
-    std::string message = "Set ";
-    message.append(std::to_string(pinNumber));
-    switch (pinTypes[pinNumber]) {
-        case HardwarePWM:
+    if (pinNumber < 0 || pinNumber > 31) {
+        errorLog << "Invalid pwm pin number " << pinNumber << "! Exiting." << std::endl;
+        exit(42);
+    }
+    if (pulseWidth < minimumPulseWidth || pulseWidth > maximumPulseWidth) {
+        errorLog << "Invalid pulse width " << pulseWidth << " for pin " << pinNumber << ", outside of ["
+                 << minimumPulseWidth << ", " << maximumPulseWidth << "]! Not sending it." << std::endl;
+        return;
+    }
+    char message[maxMessageLength];
+    std::unique_lock<std::mutex> lock(state->mutex);
+    PinType pinType = state->pinTypes[pinNumber];
+    if (pinType == HardwarePWM || pinType == SoftwarePWM) {
+        if (metrics != nullptr) {
+            metrics->trackPulseWidth(pinNumber, pulseWidth);
+        }
+        if (energyMeter != nullptr) {
+            energyMeter->record(pinNumber, pulseWidth);
+        }
+    }
+    switch (pinType) {
         case SoftwarePWM:
-            message.append(" PWM ");
-            message.append(std::to_string(pulseWidth));
-            message.append("\n");
-            printToSerial(message);
-            pwmPinStatuses[pinNumber].pulseWidth = pulseWidth;
+            if (softwarePwmEngine != nullptr) {
+                state->pwmPinStatuses[pinNumber].pulseWidth = pulseWidth;
+                lock.unlock();
+                softwarePwmEngine->setPulseWidth(pinNumber, pulseWidth);
+                break;
+            }
+            // fall through
+        case HardwarePWM:
+            state->pwmPinStatuses[pinNumber].pulseWidth = pulseWidth;
+            lock.unlock();
+            if (coalescingWriter != nullptr) {
+                coalescingWriter->submit(pinNumber, pulseWidth);
+                break;
+            }
+            writeFrame(message, formatPwmMessage(message, pinNumber, pulseWidth));
             break;
         case DigitalActiveHigh:
         case DigitalActiveLow:
             errorLog << "Invalid pin type \"Digital\". Digital pin type cannot be used for PWM. Exiting." << std::endl;
             exit(42);
         default:
-            errorLog << "Impossible pin type " << pinTypes[pinNumber] << "! Exiting." << std::endl;
+            errorLog << "Impossible pin type " << pinType << "! Exiting." << std::endl;
             exit(42);
     }
 }
 
-PwmPinStatus WiringControl::pwmRead(int pinNumber) {
-    return pwmPinStatuses[pinNumber];
+PwmPinStatus WiringControl::pwmRead(int pinNumber) const {
+    if (pinNumber < 0 || pinNumber > 31) {
+        return PwmPinStatus{0, 0, 0};
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->pwmPinStatuses[pinNumber];
+}
+
+bool WiringControl::attachSoftwarePwmEngine(SoftwarePwmEngine *engine) {
+#ifndef MOCK_RPI
+    if (engine != nullptr) {
+        // There is no GpioBackend for the Pi's own pins yet, so the Pico would be left holding plain digital outputs
+        // and the thrusters would stop
+        errorLog << "Software pwm can only be generated on the Pi in mock builds; leaving it to the Pico."
+                 << std::endl;
+        return false;
+    }
+#endif
+    softwarePwmEngine = engine;
+    return true;
+}
+
+bool WiringControl::generatesSoftwarePwm() const {
+    return softwarePwmEngine != nullptr;
+}
+
+void WiringControl::setCachedPwm(int pinNumber, int pulseWidth) {
+    if (pinNumber < 0 || pinNumber > 31) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->pwmPinStatuses[pinNumber].pulseWidth = pulseWidth;
+    if (energyMeter != nullptr) {
+        energyMeter->record(pinNumber, pulseWidth);
+    }
+}
+
+LinkStats WiringControl::negotiateLink(PicoLink &link, const LinkNegotiationSettings &settings) {
+    LinkStats negotiated = negotiateBaudRate(link, settings, errorLog);
+    outLog << "Link to Pico at " << negotiated.baudRate << " baud: " << negotiated.throughputBytesPerSecond
+           << " bytes/s, " << negotiated.roundTripLatency.count() << " us round trip"
+           << (negotiated.verified ? "" : " (not verified)") << std::endl;
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->linkStats = negotiated;
+    return negotiated;
+}
+
+LinkStats WiringControl::linkStatistics() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->linkStats;
+}
+
+void WiringControl::attachPicoLink(std::shared_ptr<PicoLink> picoLink) {
+    link = std::move(picoLink);
+}
+
+PicoLink *WiringControl::picoLink() const {
+    return link.get();
+}
+
+void WiringControl::flushCoalesced() {
+    if (coalescingWriter != nullptr) {
+        coalescingWriter->flush();
+    }
+}
+
+CoalescingWriter *WiringControl::coalescer() const {
+    return coalescingWriter.get();
 }
 
 void WiringControl::pwmWriteMaximum(int pinNumber) {
@@ -143,7 +467,10 @@ void WiringControl::pwmWriteOff(int pinNumber) {
 }
 
 WiringControl::~WiringControl() {
-#ifndef MOCK_RPI
-    close(serial);
-#endif
+    if (coalescingWriter.use_count() == 1) {
+        coalescingWriter->flush();
+    }
+    if (connection != nullptr) {
+        connection->stopWatching(this);
+    }
 }
\ No newline at end of file
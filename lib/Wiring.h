@@ -2,8 +2,14 @@
 
 #pragma once
 
-#include <unordered_map>
+#include "Link_Negotiation.h"
+#include "Pico_Connection.h"
+
+#include <atomic>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <cstdint>
 
 /// @brief What purpose the given pin is configured for
 enum PinType {
@@ -22,19 +28,95 @@ struct PwmPinStatus {
     int dutyCycle;
 };
 
+/// @brief The range of pulse widths, in microseconds, that pwmWrite sends to a thruster
+constexpr int minimumPulseWidth = 1100;
+constexpr int maximumPulseWidth = 1900;
+
+class SoftwarePwmEngine;
+
+class CoalescingWriter;
+
+class MetricsRegistry;
+
+struct WiringMetrics;
+
+class ThrusterEnergyMeter;
+
+class FrameRecorder;
+
 class WiringControl {
 private:
-    int serial = -1;
-    std::unordered_map<int, PinType> pinTypes;
-    std::unordered_map<int, PwmPinStatus> pwmPinStatuses;
-    std::unordered_map<int, DigitalPinStatus> digitalPinStatuses;
+    /// @brief What has been sent to the Pico, which a reconnect restores. Shared between copies of a WiringControl, so
+    /// changes made through any of them are restored. Indexed by GPIO number, so copying a WiringControl or looking a
+    /// pin up never touches the heap.
+    struct CachedState {
+        std::mutex mutex; // Guards everything but digitalPinStatuses
+        PinType pinTypes[32] = {}; // Only meaningful for the pins in configuredPins
+        uint32_t configuredPins = 0; // Bit n is set once pin n has been given a type
+        PwmPinStatus pwmPinStatuses[32] = {};
+        std::atomic<uint32_t> digitalPinStatuses{0}; // Bit n is set when pin n is high. Read with a single load
+        LinkStats linkStats = nominalLinkStats(defaultBaudRate);
+    };
+
+    std::shared_ptr<PicoConnection> connection;
+    std::shared_ptr<CachedState> state;
+    std::shared_ptr<std::mutex> outputMutex; // Serializes writes to output when there is no connection to the Pico
+    SoftwarePwmEngine *softwarePwmEngine = nullptr;
+    std::shared_ptr<CoalescingWriter> coalescingWriter;
+    std::shared_ptr<PicoLink> link;
+    std::shared_ptr<WiringMetrics> metrics;
+    std::shared_ptr<ThrusterEnergyMeter> energyMeter;
+    std::shared_ptr<FrameRecorder> recorder;
     std::ostream &output;
     std::ostream &outLog;
     std::ostream &errorLog;
 public:
-    /// @brief Perform necessary steps to configure the serial connection from the Pi 5 to the Pico.
+    /// @brief Perform necessary steps to configure the serial connection from the Pi 5 to the Pico, including
+    /// negotiating the fastest baud rate the link handles reliably. From then on, if the connection is lost it is
+    /// reopened in the background and every pin's configuration and state is restored from the cache.
+    /// @return True if connected, false if the Pico couldn't be reached in time (it is still retried in the
+    /// background, and pins set up in the meantime are configured once it connects)
     bool initializeSerial();
 
+    /// @brief Talk to the Pico through the given connection instead of opening the serial port (e.g. another device,
+    /// or a socket in tests). Call before initializeSerial().
+    void useConnection(std::shared_ptr<PicoConnection> picoConnection);
+
+    /// @brief The connection to the Pico, for its reconnection statistics
+    /// @return The connection, or nullptr if there isn't one (e.g. in mock mode without useConnection())
+    PicoConnection *picoConnection() const;
+
+    /// @brief Record every frame into frameRecorder instead of sending it to the Pico or writing it to output, so a
+    /// test can inspect exactly what was sent and when without capturing stdout. Call before initializeSerial() and
+    /// enableCoalescing().
+    /// @param frameRecorder where frames go. Shared with copies of this WiringControl.
+    void recordFramesTo(std::shared_ptr<FrameRecorder> frameRecorder);
+
+    /// @brief Format the messages that bring a freshly connected Pico to the cached state: the configuration of every
+    /// pin that has been set up (GPIO 0 to 31), followed by its digital state or pwm value
+    /// @param frame where the messages are written
+    /// @param capacity the size of frame
+    /// @return How many bytes were written
+    std::size_t formatRestoreFrame(char *frame, std::size_t capacity);
+
+    /// @brief Negotiate the fastest reliable baud rate with the Pico over the given link, and remember what was
+    /// measured. initializeSerial() does this over the serial port.
+    /// @param link the connection to the Pico
+    /// @param settings which rates to try and how long to wait
+    /// @return What was measured at the rate the link was left at
+    LinkStats negotiateLink(PicoLink &link, const LinkNegotiationSettings &settings);
+
+    /// @brief What is known about the link to the Pico: measured if it has been negotiated, nominal otherwise
+    LinkStats linkStatistics() const;
+
+    /// @brief Use the given link for exchanges that need the Pico's replies (e.g. on-board playback).
+    /// initializeSerial() attaches the serial port; tests can attach an emulator instead.
+    void attachPicoLink(std::shared_ptr<PicoLink> picoLink);
+
+    /// @brief The link to the Pico for exchanges that need its replies
+    /// @return The link, or nullptr if there isn't one (e.g. serial isn't initialized, or in mock mode)
+    PicoLink *picoLink() const;
+
     /// @brief Sets the pin with the given pin number to the purpose specified: either digital or pwm
     /// @param pinNumber the GPIO number of the pin. See https://pinout.xyz/ or https://pico.pinout.xyz/
     /// @param pinType what the pin will be used for: one of either two types of digital pin or two types pwm pin
@@ -45,22 +127,31 @@ public:
     /// @param digitalPinStatus a digital pin state, either high or low
     void digitalWrite(int pinNumber, DigitalPinStatus digitalPinStatus);
 
+    /// @brief Set several digital pins at once, sending all of their messages to the Pico in a single frame
+    /// @param highMask bit n set means pin n goes high
+    /// @param lowMask bit n set means pin n goes low. Pins set in both masks go high
+    void digitalWriteMask(uint32_t highMask, uint32_t lowMask);
+
+    /// @brief Read every digital pin status at once. Relies on cached status within the object
+    /// @return A word where bit n is set if pin n is high
+    uint32_t digitalReadMask() const;
+
     /// @brief Read the specified digital pin status, either high or low. Does not actually read the pins directly: relies
     /// on cached status within the object
     /// @param pinNumber the GPIO number of the pin. See https://pinout.xyz/ or https://pico.pinout.xyz/
     /// @return Whether the specified pin is high or low
-    DigitalPinStatus digitalRead(int pinNumber);
+    DigitalPinStatus digitalRead(int pinNumber) const;
 
     /// @brief Set a pwm pin to the specified frequency
     /// @param pinNumber the GPIO number of the pin. See https://pinout.xyz/ or https://pico.pinout.xyz/
-    /// @param pwmFrequency a pwm frequency between 1100 and 1900
+    /// @param pwmFrequency a pwm frequency between 1100 and 1900. Anything else is logged and not sent.
     void pwmWrite(int pinNumber, int pwmFrequency);
 
     /// @brief Read the specified pwm pin status. Does not actually read the pins directly: relies on cached status
     /// within the object
     /// @param pinNumber the GPIO number of the pin. See https://pinout.xyz/ or https://pico.pinout.xyz/
-    /// @return The specified pin's frequency, pulse width, and duty cycle
-    PwmPinStatus pwmRead(int pinNumber);
+    /// @return The specified pin's frequency, pulse width, and duty cycle (all zero for an invalid pin number)
+    PwmPinStatus pwmRead(int pinNumber) const;
 
     /// @brief Set the specified pin the maximum pwm value (1900)
     /// @param pinNumber the GPIO number of the pin. See https://pinout.xyz/ or https://pico.pinout.xyz/
@@ -70,7 +161,53 @@ public:
     /// @param pinNumber the GPIO number of the pin. See https://pinout.xyz/ or https://pico.pinout.xyz/
     void pwmWriteOff(int pinNumber);
 
-    /// @brief Print message to serial specified by file descriptor (which is initialized by initializeSerial())
+    /// @brief Generate software pwm pins with the given engine rather than on the Pico. Software pwm pins are then
+    /// configured on the Pico as plain digital outputs, and their pulse widths go to the engine instead of serial.
+    /// Must be called before the pins are initialized.
+    /// @param engine the engine to use, or nullptr to go back to sending software pwm values to the Pico
+    /// @return True if the engine was attached. Only mock builds accept an engine (the only GpioBackend is
+    /// MockGpioBackend); other builds log an error and keep generating software pwm on the Pico.
+    bool attachSoftwarePwmEngine(SoftwarePwmEngine *engine);
+
+    /// @brief Whether software pwm pins are generated on the Pi by an attached SoftwarePwmEngine
+    bool generatesSoftwarePwm() const;
+
+    /// @brief Switch pwm writes to "latest wins" mode: values that haven't been sent yet are replaced by newer ones
+    /// for the same pin instead of queueing behind them, and are sent from the coalescing writer's thread. Other
+    /// messages (configuration, digital writes, timelines, the watchdog's neutral frame) don't wait for that thread,
+    /// so they can reach the Pico ahead of pwm values queued before them; call flushCoalesced() first where the order
+    /// matters. Call after initializeSerial().
+    void enableCoalescing();
+
+    /// @brief Block until every coalesced pwm value has been sent. Does nothing if coalescing isn't enabled.
+    void flushCoalesced();
+
+    /// @brief Count the bytes and frames written to the Pico, time each write, and track the coalescing queue depth
+    /// and each pwm pin's value in registry. Call before enableCoalescing().
+    /// @param registry where the metrics are registered. Kept alive for as long as it is being updated
+    void attachMetrics(std::shared_ptr<MetricsRegistry> registry);
+
+    /// @brief Report every pwm change (including ones only made to the cache) to meter, which starts from the values
+    /// the pins are at now
+    /// @param meter the energy meter. Kept alive for as long as it is being updated
+    void attachEnergyMeter(std::shared_ptr<ThrusterEnergyMeter> meter);
+
+    /// @brief The coalescing writer used in "latest wins" mode, for reading its merge counters
+    /// @return The writer, or nullptr if coalescing isn't enabled
+    CoalescingWriter *coalescer() const;
+
+    /// @brief Update the cached pwm status of a pin without sending anything, for when a pwm value reached the Pico
+    /// by some other route (e.g. a preformatted frame)
+    /// @param pinNumber the GPIO number of the pin. See https://pinout.xyz/ or https://pico.pinout.xyz/
+    /// @param pulseWidth the pwm value the pin is now at
+    void setCachedPwm(int pinNumber, int pulseWidth);
+
+    /// @brief Write an already formatted frame (one or more messages) to serial in a single write
+    /// @param frame the bytes to send
+    /// @param length how many bytes to send
+    void writeFrame(const char *frame, std::size_t length);
+
+    /// @brief Print message to the Pico over the connection opened by initializeSerial()
     /// @param message a C++ string containing the message to be sent
     void printToSerial(const std::string &message);
 
@@ -0,0 +1,21 @@
+#include "Allocation_Counter.h"
+
+#include <cstdlib>
+#include <new>
+
+void *operator new(std::size_t size) {
+    allocationCount().fetch_add(1, std::memory_order_relaxed);
+    threadAllocationCount()++;
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Counts heap allocations. Allocation_Counter.cpp replaces the global operator new to do the counting, so link it
+// into any executable that uses these.
+
+#include <atomic>
+#include <cstdint>
+
+/// @brief How many times any thread has allocated from the heap so far
+inline std::atomic<uint64_t> &allocationCount() {
+    static std::atomic<uint64_t> allocations{0};
+    return allocations;
+}
+
+/// @brief How many times the calling thread has allocated from the heap so far, undisturbed by other threads
+inline uint64_t &threadAllocationCount() {
+    thread_local uint64_t allocations = 0;
+    return allocations;
+}
@@ -0,0 +1,78 @@
+#include "Pico_Emulator.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+TEST(ClockSyncTest, EstimatesOffsetAndLatency) {
+    PicoEmulator pico;
+    pico.clockOffsetUs = 123456789;
+    pico.linkLatency = std::chrono::milliseconds(2);
+
+    ClockEstimate estimate = estimateClock(pico, 8, std::chrono::milliseconds(50), std::cerr);
+
+    ASSERT_TRUE(estimate.valid);
+    ASSERT_NEAR(estimate.offsetUs, 123456789, 500);
+    ASSERT_NEAR(estimate.latency.count(), 2000, 500);
+
+    PicoEmulator silent;
+    silent.linkLatency = std::chrono::milliseconds(100);
+    std::ostringstream errorLog;
+    ASSERT_FALSE(estimateClock(silent, 2, std::chrono::milliseconds(10), errorLog).valid);
+    ASSERT_NE(errorLog.str().find("not synchronized"), std::string::npos);
+}
+
+TEST(ClockSyncTest, TimestampedFramesLandOnTime) {
+    auto pico = std::make_shared<PicoEmulator>();
+    pico->clockOffsetUs = -5000000;
+    pico->linkLatency = std::chrono::milliseconds(3);
+    RecordedInterpreter recorded(makeThrusterPins(), {}, [&](WiringControl &wiringControl) {
+        wiringControl.attachPicoLink(pico);
+    });
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+    ASSERT_TRUE(interpreter.enableTimestampedFrames());
+    ASSERT_NEAR(interpreter.picoClock().offsetUs, -5000000, 500);
+
+    MissionTimeline timeline;
+    ASSERT_TRUE(interpreter.compile(testSequence(), timeline));
+    recorded.frames->clear();
+    ASSERT_TRUE(interpreter.execute(timeline));
+
+    // Everything went over the link with a timestamp, and the Pico applied each frame exactly at its time
+    ASSERT_TRUE(recorded.frames->frames().empty());
+    ASSERT_EQ(pico->appliedFrames.size(), 4u);
+    const int64_t expectedOffsetsUs[] = {0, 30000, 50000, 60000};
+    for (std::size_t i = 0; i < pico->appliedFrames.size(); i++) {
+        const auto &frame = pico->appliedFrames[i];
+        ASSERT_EQ(frame.actualUs, frame.requestedUs);
+        ASSERT_EQ(frame.requestedUs - pico->appliedFrames[0].requestedUs, expectedOffsetsUs[i]);
+    }
+    ASSERT_EQ(pico->appliedFrames[2].messages, "Set 4 PWM 1900\nSet 5 PWM 1100\nSet 8 PWM 1900\nSet 6 PWM 1100\n");
+    ASSERT_EQ(pico->pwms[5], 1500);
+
+    auto statistics = interpreter.applicationTimeStatistics();
+    ASSERT_EQ(statistics.framesSent, 4u);
+    ASSERT_EQ(statistics.framesReported, 4u);
+    ASSERT_EQ(statistics.lateFrames, 0u);
+    ASSERT_EQ(statistics.maximumErrorUs, 0);
+}
+
+TEST(ClockSyncTest, LateFramesAreReported) {
+    PicoEmulator pico;
+    pico.linkLatency = std::chrono::milliseconds(1);
+    TimestampedSender sender(pico, std::cerr);
+    ASSERT_TRUE(sender.synchronize());
+
+    // The link gets slower after synchronizing, so frames sent with the old lead arrive 19 ms late
+    pico.linkLatency = std::chrono::milliseconds(20);
+    const char frame[] = "Set 4 PWM 1600\n";
+    auto applyAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+    ASSERT_TRUE(sender.sendAt(applyAt, frame, sizeof(frame) - 1));
+    sender.collectReports(std::chrono::milliseconds(200));
+
+    auto statistics = sender.statistics();
+    ASSERT_EQ(statistics.framesReported, 1u);
+    ASSERT_EQ(statistics.lateFrames, 1u);
+    ASSERT_NEAR(statistics.maximumErrorUs, 19000, 1000);
+    ASSERT_EQ(pico.pwms[4], 1600);
+}
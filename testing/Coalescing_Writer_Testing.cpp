@@ -0,0 +1,152 @@
+#include "Coalescing_Writer.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <thread>
+
+namespace {
+    /// @brief A sink that behaves like a slow serial link: each frame takes frameTime to "transmit"
+    struct SlowLink {
+        std::mutex mutex;
+        std::vector<std::string> frames;
+        std::chrono::milliseconds frameTime;
+
+        explicit SlowLink(std::chrono::milliseconds frameTime) : frameTime(frameTime) {}
+
+        CoalescingWriter::FrameSink sink() {
+            return [this](const char *frame, std::size_t length) {
+                std::this_thread::sleep_for(frameTime);
+                std::lock_guard<std::mutex> lock(mutex);
+                frames.emplace_back(frame, length);
+            };
+        }
+    };
+
+    std::size_t countLines(const std::vector<std::string> &frames) {
+        std::size_t lines = 0;
+        for (const auto &frame: frames) {
+            lines += std::count(frame.begin(), frame.end(), '\n');
+        }
+        return lines;
+    }
+
+    /// @brief The last pulse width sent for each pin, whichever frame it was in
+    std::map<int, int> lastSentPerPin(const std::vector<std::string> &frames) {
+        std::map<int, int> lastSent;
+        for (const auto &frame: frames) {
+            std::istringstream lines(frame);
+            std::string line;
+            int pinNumber, pulseWidth;
+            while (std::getline(lines, line)) {
+                if (std::sscanf(line.c_str(), "Set %d PWM %d", &pinNumber, &pulseWidth) == 2) {
+                    lastSent[pinNumber] = pulseWidth;
+                }
+            }
+        }
+        return lastSent;
+    }
+}
+
+TEST(CoalescingWriterTest, MergesValuesWhileLinkIsBusy) {
+    SlowLink link(std::chrono::milliseconds(5));
+    CoalescingWriter writer(link.sink());
+
+    for (int pulseWidth = 1100; pulseWidth < 1200; pulseWidth++) {
+        writer.submit(4, pulseWidth);
+        writer.submit(5, 3000 - pulseWidth);
+    }
+    writer.flush();
+
+    auto statistics = writer.statistics();
+    ASSERT_EQ(statistics.updatesSubmitted, 200u);
+    ASSERT_GT(statistics.updatesMerged, 0u);
+    ASSERT_LT(statistics.framesSent, 100u);
+    ASSERT_EQ(statistics.framesSent, link.frames.size());
+    ASSERT_EQ(countLines(link.frames) + statistics.updatesMerged, statistics.updatesSubmitted);
+    // Pins are ordered by when they became pending, which depends on scheduling, so only the values are checked
+    ASSERT_EQ(lastSentPerPin(link.frames), (std::map<int, int>{{4, 1199}, {5, 1801}}));
+}
+
+TEST(CoalescingWriterTest, NewestValueWaitsAtMostOneFrame) {
+    const auto frameTime = std::chrono::milliseconds(10);
+    SlowLink link(frameTime);
+    CoalescingWriter writer(link.sink());
+
+    auto burstEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    int pulseWidth = 1100;
+    while (std::chrono::steady_clock::now() < burstEnd) {
+        writer.submit(4, pulseWidth);
+        pulseWidth = pulseWidth == 1900 ? 1100 : pulseWidth + 1;
+    }
+    auto lastSubmission = std::chrono::steady_clock::now();
+    writer.flush();
+    auto delivered = std::chrono::steady_clock::now();
+
+    // At worst the newest value waits for the frame already in flight, then goes out in the next one
+    ASSERT_LE(delivered - lastSubmission, 2 * frameTime + std::chrono::milliseconds(10));
+    ASSERT_LE(link.frames.size(), 100u / 10u + 2u);
+}
+
+TEST(CoalescingWriterTest, InterpreterSendsOnlyNewestCommand) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+    interpreter.enableCoalescing();
+
+    for (int step = 0; step < 50; step++) {
+        interpreter.untimed_execute(pwm_array{1500 + step, 1500 - step, 1500, 1500, 1500, 1500, 1500, 1500 + step});
+    }
+    interpreter.flush();
+
+    auto statistics = interpreter.coalescingStatistics();
+    ASSERT_EQ(statistics.updatesSubmitted, 400u);
+    // The writer may split a command across frames, but the last value sent for each pin must be the newest one
+    ASSERT_EQ(lastSentPerPin({recorded.frames->text()}), (std::map<int, int>{{4, 1549}, {5, 1451}, {2, 1500}, {3, 1500},
+                                            {9, 1500}, {7, 1500}, {8, 1500}, {6, 1549}}));
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1549, 1451, 1500, 1500, 1500, 1500, 1500, 1549}));
+}
+
+TEST(CoalescingWriterTest, SharedOutputIsWrittenOneFrameAtATime) {
+    std::ostringstream serialOutput;
+    std::ofstream outLog("/dev/null");
+    WiringControl wiringControl = WiringControl(serialOutput, outLog, std::cerr);
+    wiringControl.setPinType(4, HardwarePWM);
+    wiringControl.setPinType(31, HardwarePWM);
+    wiringControl.setPinType(10, DigitalActiveHigh);
+    wiringControl.enableCoalescing();
+    WiringControl copy = wiringControl;
+
+    // The coalescing writer's thread and a copy writing digital frames share the same stream
+    std::thread pwmWriter([&wiringControl]() {
+        for (int step = 0; step < 500; step++) {
+            wiringControl.pwmWrite(4, 1100 + step);
+            wiringControl.pwmWrite(31, 1900 - step);
+        }
+    });
+    for (int step = 0; step < 500; step++) {
+        copy.digitalWrite(10, step % 2 == 0 ? High : Low);
+    }
+    pwmWriter.join();
+    wiringControl.flushCoalesced();
+
+    std::istringstream lines(serialOutput.str());
+    std::string line;
+    int digitalWrites = 0;
+    std::map<int, int> lastSent;
+    int pinNumber, pulseWidth;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, 10, "Configure ") == 0 || line == "Set 10 Digital High" || line == "Set 10 Digital Low") {
+            digitalWrites += line[0] == 'S';
+            continue;
+        }
+        ASSERT_EQ(std::sscanf(line.c_str(), "Set %d PWM %d", &pinNumber, &pulseWidth), 2) << line;
+        lastSent[pinNumber] = pulseWidth;
+    }
+    // setPinType() disables pin 10 once before the copy's writes
+    ASSERT_EQ(digitalWrites, 501);
+    // Pin 31 is coalesced like any other
+    ASSERT_EQ(lastSent, (std::map<int, int>{{4, 1599}, {31, 1401}}));
+}
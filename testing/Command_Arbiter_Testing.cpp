@@ -0,0 +1,168 @@
+#include "Command_Arbiter.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+namespace {
+    const pwm_array teleopForwards = {1900, 1900, 1500, 1500, 1500, 1500, 1900, 1900};
+    const pwm_array autonomyTurning = {1900, 1100, 1500, 1500, 1500, 1500, 1900, 1100};
+    const pwm_array safetySurface = {1500, 1500, 1100, 1100, 1100, 1100, 1500, 1500};
+
+    enum Sources {
+        Autonomy, Teleop, Safety
+    };
+
+    const std::vector<CommandSourceSettings> sourceSettings = {
+            {"autonomy", 0, std::chrono::milliseconds(200)},
+            {"teleop",   1, std::chrono::milliseconds(200)},
+            {"safety",   2, std::chrono::milliseconds(50)},
+    };
+
+    std::vector<int> toVector(const pwm_array &pwms) {
+        return std::vector<int>(std::begin(pwms.pwm_signals), std::end(pwms.pwm_signals));
+    }
+}
+
+TEST(CommandArbiterTest, HighestPriorityLiveSourceWins) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+    CommandArbiter arbiter(sourceSettings);
+    auto start = std::chrono::steady_clock::now();
+
+    arbiter.submit(Autonomy, autonomyTurning);
+    ASSERT_EQ(arbiter.tick(interpreter, start), Autonomy);
+    ASSERT_EQ(interpreter.readPins(), toVector(autonomyTurning));
+
+    // Teleop outranks autonomy, and takes over on the very next tick
+    arbiter.submit(Teleop, teleopForwards);
+    ASSERT_EQ(arbiter.tick(interpreter, start + std::chrono::milliseconds(1)), Teleop);
+    ASSERT_EQ(interpreter.readPins(), toVector(teleopForwards));
+
+    // Autonomy keeps submitting, but is ignored while teleop holds its lease
+    arbiter.submit(Autonomy, safetySurface);
+    ASSERT_EQ(arbiter.tick(interpreter, start + std::chrono::milliseconds(2)), Teleop);
+    ASSERT_EQ(interpreter.readPins(), toVector(teleopForwards));
+
+    arbiter.submit(Safety, safetySurface);
+    ASSERT_EQ(arbiter.tick(interpreter, start + std::chrono::milliseconds(3)), Safety);
+    ASSERT_EQ(interpreter.readPins(), toVector(safetySurface));
+
+    // The same command isn't sent twice
+    std::size_t sent = recorded.frames->text().size();
+    ASSERT_EQ(arbiter.tick(interpreter, start + std::chrono::milliseconds(4)), Safety);
+    ASSERT_EQ(recorded.frames->text().size(), sent);
+
+    // Safety's short lease runs out and teleop, still within its lease, gets the thrusters back
+    arbiter.submit(Teleop, teleopForwards);
+    ASSERT_EQ(arbiter.tick(interpreter, start + std::chrono::milliseconds(100)), Teleop);
+    ASSERT_EQ(interpreter.readPins(), toVector(teleopForwards));
+
+    auto switches = arbiter.switches();
+    ASSERT_EQ(switches.size(), 4u);
+    ASSERT_EQ(switches[0].from, -1);
+    ASSERT_EQ(switches[0].to, Autonomy);
+    ASSERT_EQ(switches[1].from, Autonomy);
+    ASSERT_EQ(switches[1].to, Teleop);
+    ASSERT_EQ(switches[2].to, Safety);
+    ASSERT_EQ(switches[3].from, Safety);
+    ASSERT_EQ(switches[3].to, Teleop);
+    ASSERT_EQ(switches[3].timeNs - switches[0].timeNs, 100000000);
+
+    auto statistics = arbiter.statistics();
+    ASSERT_EQ(statistics.ticks, 6u);
+    ASSERT_EQ(statistics.commandsApplied, 4u);
+    ASSERT_EQ(statistics.switches, 4u);
+    ASSERT_EQ(statistics.expiredLeases, 1u);
+    ASSERT_EQ(statistics.activeSource, Teleop);
+}
+
+TEST(CommandArbiterTest, NeutralOnceEveryLeaseRunsOut) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+    CommandArbiter arbiter(sourceSettings);
+    auto start = std::chrono::steady_clock::now();
+
+    arbiter.submit(Teleop, teleopForwards);
+    ASSERT_EQ(arbiter.tick(interpreter, start), Teleop);
+    ASSERT_EQ(arbiter.tick(interpreter, start + std::chrono::milliseconds(250)), -1);
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+
+    // Neutral is only sent once
+    std::size_t sent = recorded.frames->text().size();
+    ASSERT_EQ(arbiter.tick(interpreter, start + std::chrono::milliseconds(260)), -1);
+    ASSERT_EQ(recorded.frames->text().size(), sent);
+
+    // Releasing hands the thrusters on straight away, without counting as an expired lease
+    arbiter.release(Teleop);
+    arbiter.submit(Autonomy, autonomyTurning);
+    arbiter.submit(Safety, safetySurface);
+    auto resubmitted = std::chrono::steady_clock::now();
+    ASSERT_EQ(arbiter.tick(interpreter, resubmitted), Safety);
+    arbiter.release(Safety);
+    ASSERT_EQ(arbiter.tick(interpreter, resubmitted + std::chrono::milliseconds(1)), Autonomy);
+    ASSERT_EQ(interpreter.readPins(), toVector(autonomyTurning));
+
+    auto statistics = arbiter.statistics();
+    ASSERT_EQ(statistics.expiredLeases, 1u);
+    ASSERT_EQ(statistics.switches, 4u);
+    ASSERT_EQ(arbiter.switches()[1].to, -1);
+}
+
+TEST(CommandArbiterTest, ConcurrentSourcesSwitchWithinATick) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+    CommandArbiter arbiter(sourceSettings);
+
+    // Teleop and autonomy hammer their slots with commands whose values are all the same, so a torn read would show
+    std::atomic<bool> submitting{true};
+    std::vector<std::thread> submitters;
+    for (int source: {Autonomy, Teleop}) {
+        submitters.emplace_back([&arbiter, &submitting, source]() {
+            int value = 1100;
+            while (submitting.load()) {
+                value = value >= 1900 ? 1100 : value + 1;
+                arbiter.submit(source, pwm_array{{value, value, value, value, value, value, value, value}});
+            }
+        });
+    }
+    // Both threads have to be submitting before the ticks below mean anything
+    auto started = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (arbiter.tick(interpreter) != Teleop && std::chrono::steady_clock::now() < started) {
+        std::this_thread::yield();
+    }
+    int tornCommands = 0;
+    for (int tick = 0; tick < 2000; tick++) {
+        arbiter.tick(interpreter);
+        std::vector<int> pins = interpreter.readPins();
+        tornCommands += std::count(pins.begin(), pins.end(), pins[0]) != 8;
+    }
+    submitting = false;
+    for (auto &submitter: submitters) {
+        submitter.join();
+    }
+    ASSERT_EQ(tornCommands, 0);
+    ASSERT_EQ(arbiter.tick(interpreter), Teleop);
+
+    // With the executor running on its own, the safety system takes over on the next tick
+    std::atomic<bool> running{true};
+    std::thread executor([&]() { arbiter.run(interpreter, running, std::chrono::microseconds(500)); });
+    arbiter.submit(Safety, safetySurface);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (arbiter.statistics().activeSource != Safety && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    running = false;
+    executor.join();
+
+    auto switches = arbiter.switches();
+    ASSERT_EQ(switches.back().from, Teleop);
+    ASSERT_EQ(switches.back().to, Safety);
+    // Give or take a scheduling hiccup, it waited no longer than a tick
+    ASSERT_LT(switches.back().commandAgeNs, std::chrono::nanoseconds(std::chrono::milliseconds(50)).count());
+    ASSERT_EQ(interpreter.readPins(), toVector(safetySurface));
+}
@@ -1,160 +1,138 @@
-#include "Command_Interpreter.h"
+#include "Test_Fixtures.h"
 #include <gtest/gtest.h>
-
-#ifndef MOCK_RPI
-
-#include "Serial.h"
-
-#else
-
-bool initializeSerial(int* serial) {
-    return true;
-}
-
-int getSerialChar(int* serial) {
-    return EOF;
-}
-
-#endif
-
-TEST(CommandInterpreterTest, CreateCommandInterpreter) {
-    testing::internal::CaptureStdout();
-    std::ofstream outLog("/dev/null");
-    int serial = -1;
-    initializeSerial(&serial);
-
-    auto pinNumbers = std::vector<int>{4, 5, 2, 3, 9, 7, 8, 6};
-
-    auto pins = std::vector<PwmPin *>{};
-
-    for (int pinNumber: pinNumbers) {
-        pins.push_back(new HardwarePwmPin(pinNumber, std::cout, outLog, std::cerr));
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+
+namespace {
+    std::string initializeOutput(const std::string &pinType) {
+        std::string expectedOutput;
+        for (int pinNumber: thrusterPinNumbers) {
+            expectedOutput.append("Configure ");
+            expectedOutput.append(std::to_string(pinNumber));
+            expectedOutput.append(" " + pinType + "\nSet ");
+            expectedOutput.append(std::to_string(pinNumber));
+            expectedOutput.append(" PWM 1500\n");
+        }
+        return expectedOutput;
     }
 
-    WiringControl wiringControl = WiringControl(std::cout, outLog, std::cerr);
-
-    auto interpreter = new Command_Interpreter_RPi5(pins, std::vector<DigitalPin *>{}, wiringControl, std::cout, outLog,
-                                                    std::cerr);
-    interpreter->initializePins();
-    auto pinStatus = interpreter->readPins();
-    std::string output = testing::internal::GetCapturedStdout();
-
-    delete interpreter;
+    /// @brief Whether two recordings put every pin at the same value at all times: after the last message at each time
+    /// either recording sends one, the pins sent a value so far have to match
+    bool samePinsAtAllTimes(const std::vector<RecordedPwm> &first, const std::vector<RecordedPwm> &second) {
+        std::map<int, int> firstPins;
+        std::map<int, int> secondPins;
+        std::size_t i = 0;
+        std::size_t j = 0;
+        while (i < first.size() || j < second.size()) {
+            auto time = j == second.size() || (i < first.size() && first[i].time < second[j].time) ? first[i].time
+                                                                                                      : second[j].time;
+            for (; i < first.size() && first[i].time == time; i++) {
+                firstPins[first[i].pinNumber] = first[i].pulseWidth;
+            }
+            for (; j < second.size() && second[j].time == time; j++) {
+                secondPins[second[j].pinNumber] = second[j].pulseWidth;
+            }
+            if (firstPins != secondPins) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-    std::string expectedOutput;
-    for (int pinNumber: pinNumbers) {
-        expectedOutput.append("Configure ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" HardPwm\nSet ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" PWM 1500\n");
+    CommandComponent randomComponent(std::mt19937 &random) {
+        std::uniform_int_distribution<int> pulseWidth(1100, 1900);
+        // Zero durations are included on purpose: they are easy to get wrong
+        std::uniform_int_distribution<int> duration(0, 3000);
+        CommandComponent component{};
+        for (int &pwm: component.thruster_pwms.pwm_signals) {
+            // Repeated values too, which the timeline doesn't resend
+            pwm = random() % 4 == 0 ? 1500 : pulseWidth(random);
+        }
+        component.duration = std::chrono::milliseconds(random() % 3 == 0 ? 0 : duration(random));
+        return component;
     }
 
-    int charRead = EOF;
-    std::string serialOutput;
-    while ((charRead = getSerialChar(&serial)) != EOF) {
-        serialOutput.push_back((char) charRead);
+    /// @brief Run a random sequence both with blind_execute and as a compiled timeline, and check both put every pin at
+    /// the same value at all times, take exactly the sequence's duration, and end on its last values
+    /// @return An empty string if every check passes, otherwise what went wrong
+    std::string checkRandomSequence(unsigned int seed) {
+        std::mt19937 random(seed);
+        Sequence sequence;
+        std::chrono::milliseconds total(0);
+        int commandCount = 1 + static_cast<int>(random() % 5);
+        for (int i = 0; i < commandCount; i++) {
+            Command command{randomComponent(random), randomComponent(random), randomComponent(random)};
+            total += command.acceleration.duration + command.steadyState.duration + command.deceleration.duration;
+            sequence.commands.push_back(command);
+        }
+
+        RecordedInterpreter blind;
+        RecordedInterpreter timed;
+        blind.interpreter->initializePins();
+        timed.interpreter->initializePins();
+        MissionTimeline timeline;
+        if (!timed.interpreter->compile(sequence, timeline)) {
+            return "seed " + std::to_string(seed) + ": could not compile";
+        }
+        blind.interpreter->blind_execute(sequence);
+        timed.interpreter->execute(timeline);
+
+        if (blind.elapsed() != total || timed.elapsed() != total) {
+            return "seed " + std::to_string(seed) + ": took " + std::to_string(blind.elapsed().count()) + " and " +
+                   std::to_string(timed.elapsed().count()) + " ms instead of " + std::to_string(total.count());
+        }
+        if (!samePinsAtAllTimes(blind.frames->pwmMessages(), timed.frames->pwmMessages())) {
+            return "seed " + std::to_string(seed) + ": the timeline put the pins at different values";
+        }
+        const pwm_array &last = sequence.commands.back().deceleration.thruster_pwms;
+        std::vector<int> expected(last.pwm_signals, last.pwm_signals + 8);
+        if (blind.interpreter->readPins() != expected || timed.interpreter->readPins() != expected) {
+            return "seed " + std::to_string(seed) + ": did not end on the last command's values";
+        }
+        return "";
     }
+}
+
+TEST(CommandInterpreterTest, CreateCommandInterpreter) {
+    RecordedInterpreter recorded;
+    recorded.interpreter->initializePins();
+    auto pinStatus = recorded.interpreter->readPins();
 
     ASSERT_EQ(pinStatus.size(), 8);
     ASSERT_EQ(pinStatus, (std::vector<int>{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
-    if (serialOutput.empty()) {
-        ASSERT_EQ(output, expectedOutput);
-    } else {
-        expectedOutput.insert(0, "echo on\n");
-        ASSERT_EQ(serialOutput, expectedOutput);
-    }
+    ASSERT_EQ(recorded.frames->text(), initializeOutput("HardPwm"));
+    ASSERT_EQ(recorded.output.str(), "");
 }
 
 TEST(CommandInterpreterTest, CreateCommandInterpreterWithDigitalPins) {
-    testing::internal::CaptureStdout();
-    std::ofstream outLog("/dev/null");
-    int serial = -1;
-    initializeSerial(&serial);
-
-    auto pinNumbers = std::vector<int>{4, 5, 2, 3, 9, 7, 8, 6};
-
-    auto pwmPins = std::vector<PwmPin *>{};
-
-    for (int pinNumber: pinNumbers) {
-        pwmPins.push_back(new HardwarePwmPin(pinNumber, std::cout, outLog, std::cerr));
-    }
-
-    WiringControl wiringControl = WiringControl(std::cout, outLog, std::cerr);
-
-    auto digital1 = new DigitalPin(8, ActiveLow, std::cout, outLog, std::cerr);
-    auto digital2 = new DigitalPin(9, ActiveHigh, std::cout, outLog, std::cerr);
-    auto digitalPins = std::vector<DigitalPin *>{digital1, digital2};
-
-    auto interpreter = new Command_Interpreter_RPi5(pwmPins, digitalPins, wiringControl, std::cout, outLog,
-                                                    std::cerr);
-    interpreter->initializePins();
-    std::string output = testing::internal::GetCapturedStdout();
-    auto pinStatus = interpreter->readPins();
+    auto digital1 = DigitalPin(8, ActiveLow);
+    auto digital2 = DigitalPin(9, ActiveHigh);
+    RecordedInterpreter recorded(makeThrusterPins(), {digital1, digital2});
+    recorded.interpreter->initializePins();
+    auto pinStatus = recorded.interpreter->readPins();
 
-    delete interpreter;
-
-    std::string expectedOutput;
-    for (int pinNumber: pinNumbers) {
-        expectedOutput.append("Configure ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" HardPwm\nSet ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" PWM 1500\n");
-    }
+    std::string expectedOutput = initializeOutput("HardPwm");
     expectedOutput.append("Configure 8 Digital\nSet 8 Digital High\n");
     expectedOutput.append("Configure 9 Digital\nSet 9 Digital Low\n");
 
-    int charRead = EOF;
-    std::string serialOutput;
-    while ((charRead = getSerialChar(&serial)) != EOF) {
-        serialOutput.push_back((char) charRead);
-    }
     ASSERT_EQ(pinStatus.size(), 10);
     ASSERT_EQ(pinStatus, (std::vector<int>{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1, 0}));
-    if (serialOutput.empty()) {
-        ASSERT_EQ(output, expectedOutput);
-    } else {
-        expectedOutput.insert(0, "echo on\n");
-        ASSERT_EQ(serialOutput, expectedOutput);
-    }
+    ASSERT_EQ(recorded.frames->text(), expectedOutput);
 }
 
 TEST(CommandInterpreterTest, UntimedExecute) {
-    testing::internal::CaptureStdout();
-    std::ofstream outLog("/dev/null");
-    int serial = -1;
-    initializeSerial(&serial);
-
     const pwm_array pwms = {1900, 1900, 1100, 1250, 1300, 1464, 1535, 1536};
+    RecordedInterpreter recorded;
+    recorded.interpreter->initializePins();
+    recorded.interpreter->untimed_execute(pwms);
+    auto pinStatus = recorded.interpreter->readPins();
 
-    auto pinNumbers = std::vector<int>{4, 5, 2, 3, 9, 7, 8, 6};
-
-    auto pins = std::vector<PwmPin *>{};
-
-    for (int pinNumber: pinNumbers) {
-        pins.push_back(new HardwarePwmPin(pinNumber, std::cout, outLog, std::cerr));
-    }
-
-    WiringControl wiringControl = WiringControl(std::cout, outLog, std::cerr);
-
-    auto interpreter = new Command_Interpreter_RPi5(pins, std::vector<DigitalPin *>{}, wiringControl, std::cout, outLog,
-                                                    std::cerr);
-    interpreter->initializePins();
-    interpreter->untimed_execute(pwms);
-    std::string output = testing::internal::GetCapturedStdout();
-    auto pinStatus = interpreter->readPins();
-
-    delete interpreter;
-
-    std::string expectedOutput;
-    for (int pinNumber: pinNumbers) {
-        expectedOutput.append("Configure ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" HardPwm\nSet ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" PWM 1500\n");
-    }
+    std::string expectedOutput = initializeOutput("HardPwm");
     expectedOutput.append("Set 4 PWM 1900\n");
     expectedOutput.append("Set 5 PWM 1900\n");
     expectedOutput.append("Set 2 PWM 1100\n");
@@ -164,59 +142,39 @@ TEST(CommandInterpreterTest, UntimedExecute) {
     expectedOutput.append("Set 8 PWM 1535\n");
     expectedOutput.append("Set 6 PWM 1536\n");
 
-    int charRead = EOF;
-    std::string serialOutput;
-    while ((charRead = getSerialChar(&serial)) != EOF) {
-        serialOutput.push_back((char) charRead);
-    }
     ASSERT_EQ(pinStatus, (std::vector<int>{1900, 1900, 1100, 1250, 1300, 1464, 1535, 1536}));
-    if (serialOutput.empty()) {
-        ASSERT_EQ(output, expectedOutput);
-    } else {
-        expectedOutput.insert(0, "echo on\n");
-        ASSERT_EQ(serialOutput, expectedOutput);
-    }
+    ASSERT_EQ(recorded.frames->text(), expectedOutput);
+    ASSERT_EQ(recorded.elapsed(), std::chrono::milliseconds(0));
 }
 
-TEST(CommandInterpreterTest, BlindExecuteHardwarePwm) {
-    testing::internal::CaptureStdout();
-    std::ofstream outLog("/dev/null");
-    int serial = -1;
-    initializeSerial(&serial);
+TEST(CommandInterpreterTest, OutOfRangePwmIsNotSent) {
+    RecordedInterpreter recorded;
+    recorded.interpreter->initializePins();
+    recorded.frames->clear();
+    recorded.interpreter->untimed_execute(pwm_array{1900, 1099, 1500, 1500, 1500, 1500, 1500, 12000});
+
+    // The thrusters outside [1100, 1900] keep their previous value
+    ASSERT_EQ(recorded.frames->text(), "Set 4 PWM 1900\nSet 2 PWM 1500\nSet 3 PWM 1500\n"
+                                       "Set 9 PWM 1500\nSet 7 PWM 1500\nSet 8 PWM 1500\n");
+    ASSERT_EQ(recorded.interpreter->readPins(), (std::vector<int>{1900, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+    ASSERT_NE(recorded.errorLog.str().find("Invalid pulse width 1099 for pin 5"), std::string::npos);
+    ASSERT_NE(recorded.errorLog.str().find("Invalid pulse width 12000 for pin 6"), std::string::npos);
+    // The log shows what the thrusters were left at, not the rejected values
+    ASSERT_NE(recorded.outLog.str().find("Thruster at pin 4: 1900\n"), std::string::npos);
+    ASSERT_NE(recorded.outLog.str().find("Thruster at pin 5: 1500 (rejected 1099)\n"), std::string::npos);
+    ASSERT_NE(recorded.outLog.str().find("Thruster at pin 6: 1500 (rejected 12000)\n"), std::string::npos);
+}
 
+TEST(CommandInterpreterTest, BlindExecuteHardwarePwm) {
     const CommandComponent acceleration = {1900, 1900, 1100,
                                            1250, 1300, 1464, 1535,
                                            1536, std::chrono::milliseconds(2000)};
+    RecordedInterpreter recorded;
+    recorded.interpreter->initializePins();
+    recorded.interpreter->blind_execute(acceleration);
+    auto pinStatus = recorded.interpreter->readPins();
 
-    auto pinNumbers = std::vector<int>{4, 5, 2, 3, 9, 7, 8, 6};
-
-    auto pins = std::vector<PwmPin *>{};
-
-    for (int pinNumber: pinNumbers) {
-        pins.push_back(new HardwarePwmPin(pinNumber, std::cout, outLog, std::cerr));
-    }
-
-    WiringControl wiringControl = WiringControl(std::cout, outLog, std::cerr);
-
-    auto interpreter = new Command_Interpreter_RPi5(pins, std::vector<DigitalPin *>{}, wiringControl, std::cout, outLog,
-                                                    std::cerr);
-    interpreter->initializePins();
-    auto startTime = std::chrono::system_clock::now();
-    interpreter->blind_execute(acceleration);
-    auto endTime = std::chrono::system_clock::now();
-    std::string output = testing::internal::GetCapturedStdout();
-    auto pinStatus = interpreter->readPins();
-
-    delete interpreter;
-
-    std::string expectedOutput;
-    for (int pinNumber: pinNumbers) {
-        expectedOutput.append("Configure ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" HardPwm\nSet ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" PWM 1500\n");
-    }
+    std::string expectedOutput = initializeOutput("HardPwm");
     expectedOutput.append("Set 4 PWM 1900\n");
     expectedOutput.append("Set 5 PWM 1900\n");
     expectedOutput.append("Set 2 PWM 1100\n");
@@ -226,62 +184,27 @@ TEST(CommandInterpreterTest, BlindExecuteHardwarePwm) {
     expectedOutput.append("Set 8 PWM 1535\n");
     expectedOutput.append("Set 6 PWM 1536\n");
 
-    int charRead = EOF;
-    std::string serialOutput;
-    while ((charRead = getSerialChar(&serial)) != EOF) {
-        serialOutput.push_back((char) charRead);
-    }
-    ASSERT_NEAR((endTime - startTime) / std::chrono::milliseconds(1), std::chrono::milliseconds(2000) /
-                                                                      std::chrono::milliseconds(1),
-                std::chrono::milliseconds(10) / std::chrono::milliseconds(1));
+    // The command is sent straight away, then held for exactly its duration
+    ASSERT_EQ(recorded.elapsed(), std::chrono::milliseconds(2000));
+    ASSERT_EQ(recorded.frames->frames().back().time, std::chrono::steady_clock::time_point{});
     ASSERT_EQ(pinStatus, (std::vector<int>{1900, 1900, 1100, 1250, 1300, 1464, 1535, 1536}));
-    if (serialOutput.empty()) {
-        ASSERT_EQ(output, expectedOutput);
-    } else {
-        expectedOutput.insert(0, "echo on\n");
-        ASSERT_EQ(serialOutput, expectedOutput);
-    }
+    ASSERT_EQ(recorded.frames->text(), expectedOutput);
 }
 
 TEST(CommandInterpreterTest, BlindExecuteSoftwarePwm) {
-    testing::internal::CaptureStdout();
-    std::ofstream outLog("/dev/null");
-    int serial = -1;
-    initializeSerial(&serial);
-
     const CommandComponent acceleration = {1100, 1900, 1100,
                                            1250, 1300, 1464, 1535,
                                            1536, std::chrono::milliseconds(2000)};
-
-    auto pinNumbers = std::vector<int>{4, 5, 2, 3, 9, 7, 8, 6};
-
-    auto pins = std::vector<PwmPin *>{};
-
-    for (int pinNumber: pinNumbers) {
-        pins.push_back(new SoftwarePwmPin(pinNumber, std::cout, outLog, std::cerr));
+    auto pins = std::vector<PwmPin>{};
+    for (int pinNumber: thrusterPinNumbers) {
+        pins.push_back(SoftwarePwmPin(pinNumber));
     }
+    RecordedInterpreter recorded(pins, {});
+    recorded.interpreter->initializePins();
+    recorded.interpreter->blind_execute(acceleration);
+    auto pinStatus = recorded.interpreter->readPins();
 
-    WiringControl wiringControl = WiringControl(std::cout, outLog, std::cerr);
-
-    auto interpreter = new Command_Interpreter_RPi5(pins, std::vector<DigitalPin *>{}, wiringControl, std::cout, outLog,
-                                                    std::cerr);
-    interpreter->initializePins();
-    auto startTime = std::chrono::system_clock::now();
-    interpreter->blind_execute(acceleration);
-    auto endTime = std::chrono::system_clock::now();
-    std::string output = testing::internal::GetCapturedStdout();
-    auto pinStatus = interpreter->readPins();
-
-    delete interpreter;
-
-    std::string expectedOutput;
-    for (int pinNumber: pinNumbers) {
-        expectedOutput.append("Configure ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" SoftPwm\nSet ");
-        expectedOutput.append(std::to_string(pinNumber));
-        expectedOutput.append(" PWM 1500\n");
-    }
+    std::string expectedOutput = initializeOutput("SoftPwm");
     expectedOutput.append("Set 4 PWM 1100\n");
     expectedOutput.append("Set 5 PWM 1900\n");
     expectedOutput.append("Set 2 PWM 1100\n");
@@ -291,21 +214,99 @@ TEST(CommandInterpreterTest, BlindExecuteSoftwarePwm) {
     expectedOutput.append("Set 8 PWM 1535\n");
     expectedOutput.append("Set 6 PWM 1536\n");
 
-    int charRead = EOF;
-    std::string serialOutput;
-    while ((charRead = getSerialChar(&serial)) != EOF) {
-        serialOutput.push_back((char) charRead);
-    }
-    ASSERT_NEAR((endTime - startTime) / std::chrono::milliseconds(1), std::chrono::milliseconds(2000) /
-                                                                      std::chrono::milliseconds(1),
-                std::chrono::milliseconds(10) / std::chrono::milliseconds(1));
-
+    ASSERT_EQ(recorded.elapsed(), std::chrono::milliseconds(2000));
     ASSERT_EQ(pinStatus, (std::vector<int>{1100, 1900, 1100, 1250, 1300, 1464, 1535, 1536}));
-    if (serialOutput.empty()) {
-        ASSERT_EQ(output, expectedOutput);
-    } else {
-        expectedOutput.insert(0, "echo on\n");
-        ASSERT_EQ(serialOutput, expectedOutput);
+    ASSERT_EQ(recorded.frames->text(), expectedOutput);
+}
+
+TEST(CommandInterpreterTest, SetDigitalPinsAtOnce) {
+    auto lights = DigitalPin(10, ActiveLow);
+    auto dropper = DigitalPin(11, ActiveHigh);
+    auto torpedo = DigitalPin(12, ActiveHigh);
+    RecordedInterpreter recorded(makeThrusterPins(), {lights, dropper, torpedo});
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+    ASSERT_EQ(interpreter.enabledDigitalPins(), 0u);
+
+    recorded.frames->clear();
+    interpreter.setDigitalPins((1u << 10) | (1u << 11) | (1u << 12), 0);
+    std::string enableOutput = recorded.frames->text();
+    ASSERT_EQ(interpreter.enabledDigitalPins(), (1u << 10) | (1u << 11) | (1u << 12));
+
+    recorded.frames->clear();
+    interpreter.setDigitalPins(1u << 12, (1u << 10) | (1u << 11));
+    std::string mixedOutput = recorded.frames->text();
+    auto pinStatus = interpreter.readPins();
+
+    ASSERT_EQ(enableOutput, "Set 10 Digital Low\nSet 11 Digital High\nSet 12 Digital High\n");
+    ASSERT_EQ(mixedOutput, "Set 10 Digital High\nSet 11 Digital Low\nSet 12 Digital High\n");
+    ASSERT_EQ(pinStatus, (std::vector<int>{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1, 0, 1}));
+}
+
+static_assert(std::is_trivially_copyable<PwmPin>::value && std::is_trivially_copyable<DigitalPin>::value,
+              "Pins are plain values");
+
+TEST(CommandInterpreterTest, InterpreterOwnsCopiesOfItsPins) {
+    std::unique_ptr<RecordedInterpreter> recorded;
+    {
+        // The pins given to the interpreter can go away straight after
+        std::vector<PwmPin> pins = {HardwarePwmPin(4), HardwarePwmPin(5), HardwarePwmPin(2), HardwarePwmPin(3),
+                                    SoftwarePwmPin(9), SoftwarePwmPin(7), SoftwarePwmPin(8), SoftwarePwmPin(6)};
+        recorded.reset(new RecordedInterpreter(pins, {DigitalPin(10, ActiveLow)}));
     }
+    Command_Interpreter_RPi5 &interpreter = *recorded->interpreter;
+    interpreter.initializePins();
+    interpreter.untimed_execute(pwm_array{{1900, 1100, 1500, 1500, 1600, 1400, 1500, 1500}});
+
+    std::string output = recorded->frames->text();
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1900, 1100, 1500, 1500, 1600, 1400, 1500, 1500, 1}));
+    ASSERT_EQ(output.find("Configure 4 HardPwm\n"), 0u);
+    ASSERT_NE(output.find("Configure 9 SoftPwm\n"), std::string::npos);
+    ASSERT_NE(output.find("Set 7 PWM 1400\n"), std::string::npos);
+}
+
+TEST(CommandInterpreterTest, SequenceComponentsAreSentAtTheirOffsets) {
+    RecordedInterpreter recorded;
+    recorded.interpreter->initializePins();
+    recorded.frames->clear();
+    pwm_array forward = {1600, 1600, 1600, 1600, 1500, 1500, 1500, 1500};
+    pwm_array neutral = {1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500};
+    Sequence sequence{{Command{{forward, std::chrono::milliseconds(250)},
+                               {forward, std::chrono::milliseconds(10000)},
+                               {neutral, std::chrono::milliseconds(500)}}}};
+    recorded.interpreter->blind_execute(sequence);
+
+    // Every component sends all 8 pins at the time the previous one ended
+    std::vector<RecordedFrame> frames = recorded.frames->frames();
+    ASSERT_EQ(frames.size(), 24u);
+    auto start = std::chrono::steady_clock::time_point{};
+    ASSERT_EQ(frames[0].time, start);
+    ASSERT_EQ(frames[8].time, start + std::chrono::milliseconds(250));
+    ASSERT_EQ(frames[16].time, start + std::chrono::milliseconds(10250));
+    ASSERT_EQ(frames[16].bytes, "Set 4 PWM 1500\n");
+    ASSERT_EQ(recorded.elapsed(), std::chrono::milliseconds(10750));
 }
 
+TEST(CommandInterpreterTest, RandomSequencesMatchTheirTimelines) {
+    // Each scenario has its own recorder and clock, so they can all run at once
+    const unsigned int scenarios = 400;
+    std::atomic<unsigned int> nextSeed{0};
+    std::mutex failuresMutex;
+    std::vector<std::string> failures;
+    std::vector<std::thread> workers;
+    for (unsigned int worker = 0; worker < std::max(2u, std::thread::hardware_concurrency()); worker++) {
+        workers.emplace_back([&]() {
+            for (unsigned int seed = nextSeed++; seed < scenarios; seed = nextSeed++) {
+                std::string failure = checkRandomSequence(seed);
+                if (!failure.empty()) {
+                    std::lock_guard<std::mutex> lock(failuresMutex);
+                    failures.push_back(failure);
+                }
+            }
+        });
+    }
+    for (std::thread &worker: workers) {
+        worker.join();
+    }
+    ASSERT_EQ(failures, std::vector<std::string>{});
+}
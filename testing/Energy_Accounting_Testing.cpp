@@ -0,0 +1,129 @@
+#include "Energy_Accounting.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cmath>
+#include <sstream>
+#include <thread>
+
+namespace {
+    ThrustModel makeModel() {
+        // Only the curve matters for energy
+        return ThrustModel(std::array<ThrusterGeometry, 8>{});
+    }
+}
+
+TEST(EnergyAccountingTest, IntegratesEachIntervalAtItsPulseWidth) {
+    ThrustModel model = makeModel();
+    auto start = std::chrono::steady_clock::time_point(std::chrono::seconds(1000));
+    ThrusterEnergyMeter meter(model, {4, 5}, 100, 16, start);
+    const double fullAmps = model.current(1900);
+    const double partAmps = model.current(1200);
+
+    meter.record(4, 1900, start + std::chrono::seconds(2));
+    meter.record(5, 1200, start + std::chrono::seconds(1));
+    // Not a thruster
+    meter.record(7, 1900, start + std::chrono::seconds(1));
+
+    // The interval still running is included
+    ThrusterUsage running = meter.usage(0, start + std::chrono::seconds(4));
+    ASSERT_EQ(running.pulseWidth, 1900);
+    ASSERT_NEAR(running.watts, 16 * fullAmps, 1e-3);
+    ASSERT_NEAR(running.joules, 16 * fullAmps * 2, 1e-3);
+
+    meter.record(4, 1500, start + std::chrono::seconds(5));
+    // Setting the same value again doesn't start a new interval
+    meter.record(4, 1500, start + std::chrono::seconds(6));
+    auto now = start + std::chrono::seconds(10);
+    ThrusterUsage first = meter.usage(0, now);
+    ASSERT_EQ(first.pulseWidth, 1500);
+    ASSERT_EQ(first.watts, 0);
+    ASSERT_NEAR(first.joules, 16 * fullAmps * 3, 1e-3);
+    ASSERT_NEAR(first.coulombs, fullAmps * 3, 1e-4);
+    ASSERT_NEAR(first.heatLoad, fullAmps * fullAmps * 3, 1e-3);
+    ASSERT_NEAR(first.secondsAtThrottle[0], 7, 1e-9);
+    ASSERT_NEAR(first.secondsAtThrottle[4], 3, 1e-9);
+
+    ThrusterUsage second = meter.usage(1, now);
+    ASSERT_NEAR(second.joules, 16 * partAmps * 9, 1e-3);
+    ASSERT_NEAR(second.secondsAtThrottle[0], 1, 1e-9);
+    ASSERT_NEAR(second.secondsAtThrottle[3], 9, 1e-9);
+
+    ASSERT_EQ(meter.size(), 2);
+    ASSERT_NEAR(meter.totalJoules(now), first.joules + second.joules, 1e-6);
+    ASSERT_NEAR(meter.remainingJoules(now), 100 * 3600 - first.joules - second.joules, 1e-6);
+    ASSERT_NEAR(meter.totalWatts(), 16 * partAmps, 1e-3);
+}
+
+TEST(EnergyAccountingTest, InterpreterReportsCommandsAndWatchdogTrips) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    ASSERT_EQ(interpreter.energyAccounting(), nullptr);
+    interpreter.initializePins();
+    ThrustModel model = makeModel();
+    interpreter.enableEnergyAccounting(model, 100);
+    std::shared_ptr<const ThrusterEnergyMeter> meter = interpreter.energyAccounting();
+    ASSERT_NE(meter, nullptr);
+    ASSERT_EQ(meter->size(), 8);
+    ASSERT_EQ(meter->totalWatts(), 0);
+
+    // Energy is charged by the interpreter's clock, so the manual clock's ten second hold counts in full
+    interpreter.blind_execute(component(pwm_array{{1900, 1500, 1500, 1500, 1500, 1500, 1500, 1100}}, 10000));
+    ThrusterUsage usage = meter->usage(0);
+    ASSERT_EQ(usage.pulseWidth, 1900);
+    ASSERT_NEAR(meter->totalWatts(), 16 * (model.current(1900) + model.current(1100)), 1e-3);
+    ASSERT_NEAR(usage.joules, 16 * model.current(1900) * 10, 1e-3);
+    ASSERT_NEAR(meter->totalJoules(), 16 * (model.current(1900) + model.current(1100)) * 10, 1e-3);
+    ASSERT_EQ(meter->usage(1).joules, 0);
+
+    // The watchdog driving the thrusters to neutral stops the energy use
+    interpreter.enableWatchdog(std::chrono::milliseconds(10));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (meter->totalWatts() != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(meter->usage(0).pulseWidth, 1500);
+    ASSERT_EQ(meter->usage(7).pulseWidth, 1500);
+    double used = meter->totalJoules();
+    ASSERT_GT(used, usage.joules);
+    recorded.clock->advance(std::chrono::seconds(10));
+    ASSERT_EQ(meter->totalJoules(), used);
+    ASSERT_NEAR(meter->remainingJoules(), 100 * 3600 - used, 1e-6);
+}
+
+TEST(EnergyAccountingTest, ReadersNeverSeeATornAccount) {
+    ThrustModel model = makeModel();
+    auto start = std::chrono::steady_clock::time_point(std::chrono::seconds(1000));
+    ThrusterEnergyMeter meter(model, {4}, 100, 16, start);
+    const double fullAmps = model.current(1900);
+    const double partAmps = model.current(1200);
+    const int changes = 200000;
+    auto now = start + std::chrono::milliseconds(changes + 1);
+
+    std::atomic<bool> writing{true};
+    std::thread writer([&]() {
+        for (int change = 1; change <= changes; change++) {
+            meter.record(4, change % 2 == 1 ? 1900 : 1200, start + std::chrono::milliseconds(change));
+        }
+        writing = false;
+    });
+
+    // Every consistent account splits the same time between its bands, and its charge matches that split
+    int inconsistent = 0;
+    int reads = 0;
+    while (writing.load() || reads == 0) {
+        ThrusterUsage usage = meter.usage(0, now);
+        double seconds = 0;
+        for (double bandSeconds: usage.secondsAtThrottle) {
+            seconds += bandSeconds;
+        }
+        double coulombs = fullAmps * usage.secondsAtThrottle[4] + partAmps * usage.secondsAtThrottle[3];
+        if (std::abs(seconds - (changes + 1) * 1e-3) > 1e-6 || std::abs(usage.coulombs - coulombs) > 1e-3) {
+            inconsistent++;
+        }
+        reads++;
+    }
+    writer.join();
+    ASSERT_EQ(inconsistent, 0);
+    ASSERT_EQ(meter.usage(0, now).pulseWidth, 1200);
+}
@@ -0,0 +1,102 @@
+#include "Link_Negotiation.h"
+#include "Pico_Emulator.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace {
+    LinkNegotiationSettings fastSettings() {
+        LinkNegotiationSettings settings;
+        settings.replyTimeout = std::chrono::milliseconds(10);
+        settings.settleTime = std::chrono::milliseconds(0);
+        settings.picoRevertTimeout = std::chrono::milliseconds(10);
+        return settings;
+    }
+
+    /// @brief A Pico that negotiates and passes the echo checks above the base rate, then stops answering in the
+    /// middle of the throughput burst. Records how long each read was allowed to wait while it was stalled.
+    class StallingPico : public PicoEmulator {
+    public:
+        std::vector<std::chrono::milliseconds> stalledReadTimeouts;
+
+        bool writeBytes(const char *bytes, std::size_t length) override {
+            if (hostRate != defaultBaudRate && std::string(bytes, length).find("Echo t") != std::string::npos) {
+                stalled = true;
+                return true;
+            }
+            return PicoEmulator::writeBytes(bytes, length);
+        }
+
+        bool readLine(std::string &line, std::chrono::milliseconds timeout) override {
+            if (stalled) {
+                stalledReadTimeouts.push_back(timeout);
+                stalled = false;
+                return false;
+            }
+            return PicoEmulator::readLine(line, timeout);
+        }
+
+    private:
+        bool stalled = false;
+    };
+}
+
+TEST(LinkNegotiationTest, SettlesOnFastestReliableRate) {
+    PicoEmulator pico;
+    pico.supportedRates = {2000000, 1000000, 460800};
+    pico.maxReliableRate = 1000000;
+    std::ostringstream errorLog;
+
+    LinkStats stats = negotiateBaudRate(pico, fastSettings(), errorLog);
+
+    ASSERT_EQ(stats.baudRate, 1000000);
+    ASSERT_TRUE(stats.verified);
+    ASSERT_GT(stats.throughputBytesPerSecond, 0);
+    ASSERT_EQ(pico.hostRate, 1000000);
+    ASSERT_EQ(pico.picoRate, 1000000);
+    ASSERT_NE(errorLog.str().find("2000000"), std::string::npos);
+}
+
+TEST(LinkNegotiationTest, FallsBackWhenPicoCannotNegotiate) {
+    std::ostringstream errorLog;
+    PicoEmulator oldFirmware;
+    oldFirmware.answersBaud = false;
+    LinkStats stats = negotiateBaudRate(oldFirmware, fastSettings(), errorLog);
+    ASSERT_EQ(stats.baudRate, defaultBaudRate);
+    ASSERT_TRUE(stats.verified);
+    ASSERT_EQ(oldFirmware.hostRate, defaultBaudRate);
+
+    PicoEmulator silent;
+    silent.answersEcho = false;
+    stats = negotiateBaudRate(silent, fastSettings(), errorLog);
+    ASSERT_EQ(stats.baudRate, defaultBaudRate);
+    ASSERT_FALSE(stats.verified);
+    ASSERT_DOUBLE_EQ(stats.throughputBytesPerSecond, defaultBaudRate / 10.0);
+}
+
+TEST(LinkNegotiationTest, StalledBurstGivesUpAfterOneTransferTime) {
+    StallingPico pico;
+    pico.supportedRates = {2000000};
+    std::ostringstream errorLog;
+
+    LinkStats stats = negotiateBaudRate(pico, fastSettings(), errorLog);
+
+    ASSERT_EQ(stats.baudRate, defaultBaudRate);
+    ASSERT_EQ(pico.stalledReadTimeouts.size(), 1u);
+    // A burst of about 4 KB takes about 21 ms at 2000000 baud, plus the 10 ms reply timeout
+    ASSERT_LE(pico.stalledReadTimeouts.front().count(), 32);
+}
+
+TEST(LinkNegotiationTest, ThrusterUpdateRateFollowsLink) {
+    LinkStats measured{1000000, true, 96000, std::chrono::microseconds(200)};
+    ASSERT_DOUBLE_EQ(maxUpdateRate(measured, 120), 800);
+    ASSERT_DOUBLE_EQ(maxUpdateRate(measured, 0), 0);
+
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+
+    // "Set 4 PWM 1500\n" is 15 bytes, so a nominal 11520 bytes/s carries 96 updates of all 8 thrusters
+    ASSERT_FALSE(interpreter.linkStatistics().verified);
+    ASSERT_DOUBLE_EQ(interpreter.maxThrusterUpdateRate(), 96);
+}
@@ -0,0 +1,54 @@
+// Compares the preformatted text protocol path (Message_Format.h) with building messages out of std::string and
+// std::to_string, which is how WiringControl used to format every pwm message.
+
+#include "Allocation_Counter.h"
+#include "Message_Format.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+    volatile std::size_t sink = 0;
+
+    std::string stringPwmMessage(int pinNumber, int pulseWidth) {
+        std::string message = "Set ";
+        message.append(std::to_string(pinNumber));
+        message.append(" PWM ");
+        message.append(std::to_string(pulseWidth));
+        message.append("\n");
+        return message;
+    }
+
+    template<typename Body>
+    void benchmark(const char *name, int rounds, Body body) {
+        uint64_t allocationsBefore = allocationCount().load();
+        auto start = std::chrono::steady_clock::now();
+        std::size_t messages = 0;
+        for (int round = 0; round < rounds; round++) {
+            for (int pinNumber = 0; pinNumber < 30; pinNumber++) {
+                for (int pulseWidth = 1100; pulseWidth <= 1900; pulseWidth += 8) {
+                    sink = sink + body(pinNumber, pulseWidth);
+                    messages++;
+                }
+            }
+        }
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+        std::cout << name << ": " << elapsed.count() / static_cast<double>(messages) << " ns/message, "
+                  << static_cast<double>(allocationCount().load() - allocationsBefore) / static_cast<double>(messages)
+                  << " allocations/message" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+    benchmark("std::string + std::to_string", rounds, [](int pinNumber, int pulseWidth) {
+        return stringPwmMessage(pinNumber, pulseWidth).size();
+    });
+    benchmark("formatPwmMessage (stack buffer)", rounds, [](int pinNumber, int pulseWidth) {
+        char buffer[maxMessageLength];
+        return formatPwmMessage(buffer, pinNumber, pulseWidth);
+    });
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "Message_Format.h"
+#include <gtest/gtest.h>
+#include <string>
+
+TEST(MessageFormatTest, PwmMessagesMatchStringFormatting) {
+    char buffer[maxMessageLength];
+    for (int pinNumber = 0; pinNumber < 30; pinNumber++) {
+        for (int pulseWidth = 1100; pulseWidth <= 1900; pulseWidth++) {
+            std::string expected = "Set " + std::to_string(pinNumber) + " PWM " + std::to_string(pulseWidth) + "\n";
+            std::size_t length = formatPwmMessage(buffer, pinNumber, pulseWidth);
+            ASSERT_EQ(std::string(buffer, length), expected);
+        }
+    }
+}
+
+TEST(MessageFormatTest, NumbersOfEveryWidth) {
+    char buffer[4];
+    for (int value: {0, 7, 10, 42, 99, 100, 305, 999, 1000, 1500, 9999}) {
+        std::size_t length = formatNumber(buffer, value);
+        ASSERT_EQ(std::string(buffer, length), std::to_string(value));
+    }
+}
+
+TEST(MessageFormatTest, DigitalAndConfigureMessages) {
+    char buffer[maxMessageLength];
+    ASSERT_EQ(std::string(buffer, formatDigitalMessage(buffer, 8, High)), "Set 8 Digital High\n");
+    ASSERT_EQ(std::string(buffer, formatDigitalMessage(buffer, 29, Low)), "Set 29 Digital Low\n");
+    ASSERT_EQ(std::string(buffer, formatConfigureMessage(buffer, 4, HardwarePWM)), "Configure 4 HardPwm\n");
+    ASSERT_EQ(std::string(buffer, formatConfigureMessage(buffer, 12, SoftwarePWM)), "Configure 12 SoftPwm\n");
+    ASSERT_EQ(std::string(buffer, formatConfigureMessage(buffer, 12, SoftwarePWM, true)), "Configure 12 Digital\n");
+    ASSERT_EQ(std::string(buffer, formatConfigureMessage(buffer, 9, DigitalActiveLow)), "Configure 9 Digital\n");
+}
+
+TEST(MessageFormatTest, OutOfRangeValuesFormatToNothing) {
+    char buffer[maxMessageLength];
+    ASSERT_EQ(formatNumber(buffer, -1), 0u);
+    ASSERT_EQ(formatNumber(buffer, 10000), 0u);
+    ASSERT_EQ(formatPwmMessage(buffer, 4, 12000), 0u);
+    ASSERT_EQ(formatPwmMessage(buffer, -4, 1500), 0u);
+    ASSERT_EQ(formatDigitalMessage(buffer, -1, High), 0u);
+    ASSERT_EQ(formatConfigureMessage(buffer, 10000, HardwarePWM), 0u);
+}
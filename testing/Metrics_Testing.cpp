@@ -0,0 +1,136 @@
+#include "Metrics_Server.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    /// @brief Connect to a metrics socket, send request and read until the server hangs up
+    std::string scrape(const std::string &path, const std::string &request) {
+        int client = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", path.c_str());
+        if (connect(client, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            close(client);
+            return "";
+        }
+        if (!request.empty()) {
+            send(client, request.data(), request.size(), MSG_NOSIGNAL);
+        }
+        std::string response;
+        char buffer[4096];
+        pollfd readable{client, POLLIN, 0};
+        while (poll(&readable, 1, 1000) > 0) {
+            ssize_t count = read(client, buffer, sizeof(buffer));
+            if (count <= 0) {
+                break;
+            }
+            response.append(buffer, static_cast<std::size_t>(count));
+        }
+        close(client);
+        return response;
+    }
+
+    bool contains(const std::string &text, const std::string &part) {
+        return text.find(part) != std::string::npos;
+    }
+}
+
+TEST(MetricsTest, RendersPrometheusText) {
+    MetricsRegistry registry;
+    registry.counter("frames_total", "Frames sent").add(3);
+    registry.gauge("pulse_width", "Pulse width", "pin=\"4\"").set(1900);
+    registry.histogram("latency_us", "Latency", {10, 100}).observe(5);
+    registry.gauge("pulse_width", "Pulse width", "pin=\"5\"").set(1100);
+    registry.histogram("latency_us", "Latency", {10, 100}).observe(50);
+    registry.histogram("latency_us", "Latency", {10, 100}).observe(5000);
+
+    // Registering again returns the same metric
+    ASSERT_EQ(&registry.counter("frames_total", "Frames sent"), &registry.counter("frames_total", "Frames sent"));
+    ASSERT_EQ(registry.size(), 4u);
+    // A name can't be reused for a different kind of metric
+    registry.gauge("frames_total", "Not a counter").set(7);
+
+    ASSERT_EQ(registry.render(),
+              "# HELP frames_total Frames sent\n"
+              "# TYPE frames_total counter\n"
+              "frames_total 3\n"
+              "# HELP pulse_width Pulse width\n"
+              "# TYPE pulse_width gauge\n"
+              "pulse_width{pin=\"4\"} 1900\n"
+              "pulse_width{pin=\"5\"} 1100\n"
+              "# HELP latency_us Latency\n"
+              "# TYPE latency_us histogram\n"
+              "latency_us_bucket{le=\"10\"} 1\n"
+              "latency_us_bucket{le=\"100\"} 2\n"
+              "latency_us_bucket{le=\"+Inf\"} 3\n"
+              "latency_us_sum 5055\n"
+              "latency_us_count 3\n");
+}
+
+TEST(MetricsTest, InterpreterAndWiringReportWrites) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    auto metrics = std::make_shared<MetricsRegistry>();
+    interpreter.attachMetrics(metrics);
+    interpreter.initializePins();
+    interpreter.untimed_execute(pwm_array{{1900, 1100, 1500, 1500, 1500, 1500, 1600, 1400}});
+
+    std::string text = metrics->render();
+    ASSERT_TRUE(contains(text, "propulsion_bytes_written_total " + std::to_string(recorded.frames->text().size()) + "\n"));
+    // A configure and a neutral message per pin, then the command
+    ASSERT_TRUE(contains(text, "propulsion_frames_written_total 24\n"));
+    ASSERT_TRUE(contains(text, "propulsion_write_latency_microseconds_count 24\n"));
+    ASSERT_TRUE(contains(text, "propulsion_commands_total 1\n"));
+    ASSERT_TRUE(contains(text, "propulsion_pwm_pulse_width_microseconds{pin=\"4\"} 1900\n"));
+    ASSERT_TRUE(contains(text, "propulsion_pwm_pulse_width_microseconds{pin=\"6\"} 1400\n"));
+    ASSERT_TRUE(contains(text, "propulsion_failed_writes_total 0\n"));
+
+    // In coalescing mode the queue depth is tracked too
+    interpreter.enableCoalescing();
+    interpreter.untimed_execute(pwm_array{{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}});
+    interpreter.flush();
+    text = metrics->render();
+    ASSERT_TRUE(contains(text, "propulsion_coalescing_queue_depth 0\n"));
+    ASSERT_TRUE(contains(text, "propulsion_commands_total 2\n"));
+    ASSERT_TRUE(contains(text, "propulsion_pwm_pulse_width_microseconds{pin=\"4\"} 1500\n"));
+    ASSERT_TRUE(contains(text, "propulsion_bytes_written_total " + std::to_string(recorded.frames->text().size()) + "\n"));
+}
+
+TEST(MetricsTest, ServesOverUnixSocketWhileUpdating) {
+    MetricsRegistry registry;
+    Counter &updates = registry.counter("updates_total", "Updates");
+    std::ostringstream outLog;
+    std::ostringstream errorLog;
+    MetricsServer server(registry, outLog, errorLog);
+    const std::string path = "/tmp/propulsion_metrics_test_" + std::to_string(getpid()) + ".sock";
+    ASSERT_TRUE(server.start(path));
+
+    // The control thread keeps updating while being scraped
+    std::atomic<bool> updating{true};
+    std::thread control([&]() {
+        while (updating.load()) {
+            updates.add();
+        }
+    });
+
+    std::string http = scrape(path, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    std::string plain = scrape(path, "");
+    updating = false;
+    control.join();
+
+    ASSERT_EQ(http.find("HTTP/1.0 200 OK\r\n"), 0u);
+    ASSERT_TRUE(contains(http, "\r\n\r\n# HELP updates_total Updates\n# TYPE updates_total counter\nupdates_total "));
+    ASSERT_EQ(plain.find("# HELP updates_total Updates\n"), 0u);
+    ASSERT_EQ(server.scrapeCount(), 2u);
+    ASSERT_EQ(errorLog.str(), "");
+
+    server.stop();
+    ASSERT_EQ(access(path.c_str(), F_OK), -1);
+    ASSERT_EQ(scrape(path, ""), "");
+}
@@ -0,0 +1,134 @@
+#include "Software_Pwm.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+TEST(MissionCompilerTest, CompilesOnlyChangedThrusters) {
+    MissionTimeline timeline;
+    ASSERT_TRUE(compileSequence(testSequence(), thrusterPinNumbers, timeline, std::cerr));
+
+    const TimelineHeader &header = timeline.header();
+    ASSERT_EQ(header.entryCount, 4u);
+    ASSERT_EQ(header.totalDurationNs, 80000000u);
+
+    const TimelineEntry &first = timeline.entry(0);
+    ASSERT_EQ(first.offsetNs, 0u);
+    ASSERT_EQ(std::string(timeline.bytes(first), first.byteLength),
+              "Set 4 PWM 1900\nSet 5 PWM 1900\nSet 2 PWM 1500\nSet 3 PWM 1500\n"
+              "Set 9 PWM 1500\nSet 7 PWM 1500\nSet 8 PWM 1900\nSet 6 PWM 1900\n");
+
+    const TimelineEntry &turn = timeline.entry(2);
+    ASSERT_EQ(turn.offsetNs, 50000000u);
+    ASSERT_EQ(std::string(timeline.bytes(turn), turn.byteLength), "Set 4 PWM 1900\nSet 5 PWM 1100\n"
+                                                                    "Set 8 PWM 1900\nSet 6 PWM 1100\n");
+    ASSERT_EQ(turn.thrusterPwms[1], 1100);
+    ASSERT_EQ(turn.thrusterPwms[2], 1500);
+}
+
+TEST(MissionCompilerTest, RejectsOutOfRangePwm) {
+    Sequence sequence = testSequence();
+    sequence.commands[1].steadyState.thruster_pwms.pwm_signals[3] = 2000;
+    std::ostringstream errorLog;
+    MissionTimeline timeline;
+    ASSERT_FALSE(compileSequence(sequence, thrusterPinNumbers, timeline, errorLog));
+    ASSERT_FALSE(timeline.valid());
+    ASSERT_NE(errorLog.str().find("2000"), std::string::npos);
+}
+
+TEST(MissionCompilerTest, SavedTimelineExecutesLikeTheSequence) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+
+    MissionTimeline compiled;
+    ASSERT_TRUE(interpreter.compile(testSequence(), compiled));
+    std::string path = "/tmp/propulsion_timeline_" + std::to_string(getpid()) + ".bin";
+    ASSERT_TRUE(compiled.save(path, std::cerr));
+    MissionTimeline loaded;
+    ASSERT_TRUE(loaded.load(path, std::cerr));
+    unlink(path.c_str());
+    ASSERT_EQ(loaded.header().entryCount, compiled.header().entryCount);
+
+    recorded.frames->clear();
+    auto start = recorded.clock->now();
+    ASSERT_TRUE(interpreter.execute(loaded));
+
+    ASSERT_EQ(recorded.clock->now() - start, std::chrono::milliseconds(80));
+    std::vector<RecordedFrame> sent = recorded.frames->frames();
+    ASSERT_EQ(sent.size(), 4u);
+    const int expectedOffsetsMs[] = {0, 30, 50, 60};
+    const char *expectedBytes[] = {"Set 4 PWM 1900\nSet 5 PWM 1900\nSet 2 PWM 1500\nSet 3 PWM 1500\n"
+                                   "Set 9 PWM 1500\nSet 7 PWM 1500\nSet 8 PWM 1900\nSet 6 PWM 1900\n",
+                                   "Set 4 PWM 1500\nSet 5 PWM 1500\nSet 8 PWM 1500\nSet 6 PWM 1500\n",
+                                   "Set 4 PWM 1900\nSet 5 PWM 1100\nSet 8 PWM 1900\nSet 6 PWM 1100\n",
+                                   "Set 4 PWM 1500\nSet 5 PWM 1500\nSet 8 PWM 1500\nSet 6 PWM 1500\n"};
+    for (std::size_t i = 0; i < sent.size(); i++) {
+        ASSERT_EQ(sent[i].time - start, std::chrono::milliseconds(expectedOffsetsMs[i]));
+        ASSERT_EQ(sent[i].bytes, expectedBytes[i]);
+    }
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+}
+
+// Only mock builds accept a software pwm engine on the Pi
+#ifdef MOCK_RPI
+TEST(MissionCompilerTest, RejectsTimelineForSoftwarePwmEngine) {
+    std::ostringstream engineLog;
+    MockGpioBackend backend;
+    SoftwarePwmEngine engine(backend, std::chrono::microseconds(20000), engineLog);
+    auto pins = std::vector<PwmPin>{};
+    for (int pinNumber: thrusterPinNumbers) {
+        pins.push_back(SoftwarePwmPin(pinNumber));
+    }
+    bool attached = false;
+    RecordedInterpreter recorded(pins, {}, [&](WiringControl &wiringControl) {
+        attached = wiringControl.attachSoftwarePwmEngine(&engine);
+    });
+    ASSERT_TRUE(attached);
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+
+    // The Pico only has digital outputs on these pins, so the timeline's pwm messages would do nothing
+    MissionTimeline timeline;
+    ASSERT_TRUE(interpreter.compile(testSequence(), timeline));
+    recorded.frames->clear();
+    ASSERT_FALSE(interpreter.execute(timeline));
+    ASSERT_TRUE(recorded.frames->frames().empty());
+    ASSERT_NE(recorded.errorLog.str().find("software pwm"), std::string::npos);
+}
+#endif
+
+TEST(MissionCompilerTest, RejectsTimelineWithImpossibleEntryCount) {
+    MissionTimeline compiled;
+    ASSERT_TRUE(compileSequence(testSequence(), thrusterPinNumbers, compiled, std::cerr));
+    std::string path = "/tmp/propulsion_timeline_corrupt_" + std::to_string(getpid()) + ".bin";
+    ASSERT_TRUE(compiled.save(path, std::cerr));
+
+    // An entry count whose size in bytes wraps around to make the sizes add up again
+    TimelineHeader header = compiled.header();
+    header.entryCount = 0x80000000u;
+    header.byteCount -= static_cast<uint64_t>(header.entryCount) * sizeof(TimelineEntry);
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+    std::ostringstream errorLog;
+    MissionTimeline loaded;
+    ASSERT_FALSE(loaded.load(path, errorLog));
+    unlink(path.c_str());
+    ASSERT_FALSE(loaded.valid());
+    ASSERT_NE(errorLog.str().find("corrupt"), std::string::npos);
+}
+
+TEST(MissionCompilerTest, RejectsTimelineForOtherPins) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+
+    MissionTimeline timeline;
+    ASSERT_TRUE(compileSequence(testSequence(), {10, 11, 12, 13, 14, 15, 16, 17}, timeline, recorded.errorLog));
+    recorded.frames->clear();
+    ASSERT_FALSE(interpreter.execute(timeline));
+    ASSERT_TRUE(recorded.frames->frames().empty());
+}
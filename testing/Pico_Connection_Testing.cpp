@@ -0,0 +1,211 @@
+#include "Pico_Connection.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <csignal>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    /// @brief Stands in for the Pico's USB device: each open creates a socketpair, and unplugging closes the Pico's end,
+    /// which the Pi's end sees as a hang-up
+    class UnpluggablePico {
+    private:
+        std::mutex mutex;
+        int picoEnd = -1;
+        bool pluggedIn = true;
+
+    public:
+        PicoConnection::Opener opener() {
+            return [this]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                int ends[2];
+                if (!pluggedIn || socketpair(AF_UNIX, SOCK_STREAM, 0, ends) != 0) {
+                    return -1;
+                }
+                picoEnd = ends[1];
+                return ends[0];
+            };
+        }
+
+        void unplug() {
+            std::lock_guard<std::mutex> lock(mutex);
+            pluggedIn = false;
+            close(picoEnd);
+            picoEnd = -1;
+        }
+
+        void plugIn() {
+            std::lock_guard<std::mutex> lock(mutex);
+            pluggedIn = true;
+        }
+
+        /// @brief Read what the Pi sends until it ends with the given text or the timeout runs out
+        std::string receive(const std::string &ending, std::chrono::milliseconds timeout) {
+            int fd;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                fd = picoEnd;
+            }
+            std::string received;
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (received.size() < ending.size() ||
+                   received.compare(received.size() - ending.size(), ending.size(), ending) != 0) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now());
+                pollfd readable{fd, POLLIN, 0};
+                if (remaining.count() <= 0 || poll(&readable, 1, static_cast<int>(remaining.count())) <= 0) {
+                    break;
+                }
+                char buffer[512];
+                ssize_t count = read(fd, buffer, sizeof(buffer));
+                if (count <= 0) {
+                    break;
+                }
+                received.append(buffer, static_cast<std::size_t>(count));
+            }
+            return received;
+        }
+
+        ~UnpluggablePico() {
+            close(picoEnd);
+        }
+    };
+
+    const ReconnectSettings fastRetries{std::chrono::milliseconds(1), std::chrono::milliseconds(10),
+                                        std::chrono::milliseconds(1000), std::chrono::milliseconds(5)};
+
+    bool waitForReconnects(Command_Interpreter_RPi5 &interpreter, uint64_t reconnects) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (interpreter.connectionStatistics().reconnects < reconnects) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    const std::string restoredThrusters = "Configure 2 HardPwm\nSet 2 PWM 1500\nConfigure 3 HardPwm\nSet 3 PWM 1500\n"
+                                          "Configure 4 HardPwm\nSet 4 PWM 1900\nConfigure 5 HardPwm\nSet 5 PWM 1100\n"
+                                          "Configure 6 HardPwm\nSet 6 PWM 1400\nConfigure 7 HardPwm\nSet 7 PWM 1500\n"
+                                          "Configure 8 HardPwm\nSet 8 PWM 1600\nConfigure 9 HardPwm\nSet 9 PWM 1500\n";
+}
+
+TEST(PicoConnectionTest, RestoresPinsAfterHangUp) {
+    signal(SIGPIPE, SIG_IGN);
+    UnpluggablePico pico;
+    std::ofstream outLog("/dev/null");
+    std::ostringstream errorLog;
+    auto connection = std::make_shared<PicoConnection>(pico.opener(), outLog, errorLog, fastRetries);
+    WiringControl wiringControl(std::cout, outLog, errorLog);
+    wiringControl.useConnection(connection);
+    Command_Interpreter_RPi5 interpreter(makeThrusterPins(),
+                                         {DigitalPin(10, ActiveLow)}, wiringControl,
+                                         std::cout, outLog, errorLog);
+    interpreter.initializePins();
+    ASSERT_NE(pico.receive("Configure 10 Digital\nSet 10 Digital High\n", std::chrono::seconds(1)), "");
+
+    interpreter.untimed_execute(pwm_array{{1900, 1100, 1500, 1500, 1500, 1500, 1600, 1400}});
+    interpreter.setDigitalPins(1u << 10, 0);
+    ASSERT_NE(pico.receive("Set 10 Digital Low\n", std::chrono::seconds(1)), "");
+
+    pico.unplug();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    pico.plugIn();
+    ASSERT_TRUE(waitForReconnects(interpreter, 1));
+
+    // Everything comes back in one frame, in pin order
+    const std::string restored = restoredThrusters + "Configure 10 Digital\nSet 10 Digital Low\n";
+    ASSERT_EQ(pico.receive(restored, std::chrono::seconds(1)), restored);
+    auto statistics = interpreter.connectionStatistics();
+    ASSERT_EQ(statistics.disconnects, 1u);
+    ASSERT_GT(statistics.failedAttempts, 0u);
+    ASSERT_GT(statistics.lastRecoveryTime.count(), 0);
+    ASSERT_LT(statistics.lastRecoveryTime, std::chrono::seconds(1));
+    ASSERT_TRUE(statistics.connected);
+    ASSERT_NE(errorLog.str().find("Lost the connection"), std::string::npos);
+
+    // Commands carry on over the new connection
+    interpreter.untimed_execute(pwm_array{{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}});
+    ASSERT_EQ(pico.receive("Set 6 PWM 1500\n", std::chrono::seconds(1)),
+              "Set 4 PWM 1500\nSet 5 PWM 1500\nSet 2 PWM 1500\nSet 3 PWM 1500\n"
+              "Set 9 PWM 1500\nSet 7 PWM 1500\nSet 8 PWM 1500\nSet 6 PWM 1500\n");
+}
+
+TEST(PicoConnectionTest, WatchdogTripDuringOutageRestoresNeutral) {
+    signal(SIGPIPE, SIG_IGN);
+    UnpluggablePico pico;
+    std::ofstream outLog("/dev/null");
+    std::ostringstream errorLog;
+    auto connection = std::make_shared<PicoConnection>(pico.opener(), outLog, errorLog, fastRetries);
+    WiringControl wiringControl(std::cout, outLog, errorLog);
+    wiringControl.useConnection(connection);
+    Command_Interpreter_RPi5 interpreter(makeThrusterPins(), std::vector<DigitalPin>{}, wiringControl,
+                                         std::cout, outLog, errorLog);
+    interpreter.initializePins();
+    interpreter.enableWatchdog(std::chrono::milliseconds(20));
+    interpreter.untimed_execute(pwm_array{{1900, 1100, 1500, 1500, 1500, 1500, 1600, 1400}});
+    ASSERT_NE(pico.receive("Set 6 PWM 1400\n", std::chrono::seconds(1)), "");
+
+    // The watchdog's neutral frame can't get through while unplugged, so the restore frame has to carry it
+    pico.unplug();
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    pico.plugIn();
+    ASSERT_TRUE(waitForReconnects(interpreter, 1));
+
+    std::string restored = pico.receive("Set 9 PWM 1500\n", std::chrono::seconds(1));
+    ASSERT_GE(interpreter.watchdogStatistics().trips, 1u);
+    ASSERT_EQ(restored.find("1900"), std::string::npos);
+    ASSERT_NE(restored.find("Set 4 PWM 1500\n"), std::string::npos);
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+}
+
+TEST(PicoConnectionTest, ConfiguresPinsOnceLatePicoConnects) {
+    signal(SIGPIPE, SIG_IGN);
+    UnpluggablePico pico;
+    pico.unplug();
+    std::ofstream outLog("/dev/null");
+    std::ostringstream errorLog;
+    ReconnectSettings settings = fastRetries;
+    settings.connectTimeout = std::chrono::milliseconds(20);
+    auto connection = std::make_shared<PicoConnection>(pico.opener(), outLog, errorLog, settings);
+    WiringControl wiringControl(std::cout, outLog, errorLog);
+    wiringControl.useConnection(connection);
+    Command_Interpreter_RPi5 interpreter(makeThrusterPins(), std::vector<DigitalPin>{}, wiringControl,
+                                         std::cout, outLog, errorLog);
+
+    // Carries on without the Pico instead of exiting
+    interpreter.initializePins();
+    ASSERT_NE(errorLog.str().find("Unable to reach the Pico"), std::string::npos);
+    ASSERT_FALSE(interpreter.connectionStatistics().connected);
+    interpreter.untimed_execute(pwm_array{{1900, 1100, 1500, 1500, 1500, 1500, 1600, 1400}});
+
+    pico.plugIn();
+    ASSERT_TRUE(connection->waitUntilConnected(std::chrono::seconds(1)));
+    ASSERT_EQ(pico.receive(restoredThrusters, std::chrono::seconds(1)), restoredThrusters);
+    auto statistics = interpreter.connectionStatistics();
+    ASSERT_EQ(statistics.reconnects, 0u);
+    ASSERT_GT(statistics.failedAttempts, 0u);
+}
+
+TEST(PicoConnectionTest, RestoresChangesMadeThroughCopies) {
+    std::ostringstream output;
+    std::ofstream outLog("/dev/null");
+    std::ostringstream errorLog;
+    WiringControl restoring(output, outLog, errorLog);
+    restoring.setPinType(4, HardwarePWM);
+    WiringControl copy = restoring;
+    copy.setPinType(10, DigitalActiveHigh);
+    copy.pwmWrite(4, 1700);
+    copy.digitalWrite(10, High);
+
+    // Whichever copy the reconnect asks, it sees every change
+    char frame[PicoConnection::maxRestoreFrameLength];
+    ASSERT_EQ(std::string(frame, restoring.formatRestoreFrame(frame, sizeof(frame))),
+              "Configure 4 HardPwm\nSet 4 PWM 1700\nConfigure 10 Digital\nSet 10 Digital High\n");
+    ASSERT_EQ(restoring.digitalRead(10), High);
+    ASSERT_EQ(restoring.pwmRead(4).pulseWidth, 1700);
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+#include "Clock_Sync.h"
+#include "Interpreter_Clock.h"
+#include "Link_Negotiation.h"
+#include "Pico_Link.h"
+#include "Sequence_Upload.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// @brief Plays the Pico's side of the serial protocol in-process, for tests. Lines are handled as soon as they are
+/// written, but take linkLatency to arrive in either direction; on-board playback runs inside readLine(). Time comes
+/// from clock, so a test can put the emulator and the interpreter on the same ManualClock and nothing sleeps for real.
+class PicoEmulator : public PicoLink {
+public:
+    /// @brief A step of on-board playback being applied
+    struct AppliedStep {
+        uint32_t index;
+        std::chrono::steady_clock::time_point time;
+        std::array<int, 8> pwms;
+    };
+
+    // Baud rate negotiation: lines sent while the two ends are at different rates are lost, and above
+    // maxReliableRate every echo comes back corrupted
+    std::set<int> supportedRates;
+    int maxReliableRate = 4000000;
+    bool answersEcho = true;
+    bool answersBaud = true;
+    int hostRate = defaultBaudRate;
+    int picoRate = defaultBaudRate;
+
+    // On-board playback
+    bool corruptsUploads = false; // Flip a bit in every received Step line
+    int stallsAtStep = -1; // Stop reporting (as if the Pico had hung) when this step is due
+
+    // Clock synchronization and timestamped frames
+    int64_t clockOffsetUs = 0; // Pico time = Pi time + clockOffsetUs
+    std::chrono::microseconds linkLatency{0}; // One way, in both directions
+
+    std::shared_ptr<InterpreterClock> clock = std::make_shared<SteadyInterpreterClock>(); // The Pi's clock
+
+    /// @brief A timestamped frame being applied
+    struct AppliedFrame {
+        int64_t requestedUs; // Pico time
+        int64_t actualUs; // Pico time
+        std::string messages;
+    };
+
+    std::map<int, int> pwms; // Current pwm of each pin, from Set messages and playback
+    std::vector<AppliedStep> appliedSteps;
+    std::vector<AppliedFrame> appliedFrames;
+
+private:
+    struct Reply {
+        std::string line;
+        std::chrono::steady_clock::time_point available;
+    };
+
+    bool waitingForIntactLine = false;
+    std::string received;
+    std::deque<Reply> replies;
+
+    int64_t timedFrameUs = 0;
+    std::size_t timedFrameRemaining = 0;
+    std::string timedFrame;
+
+    /// @brief The Pico's clock when a line written now arrives
+    int64_t arrivalUs() const {
+        return piMicros(clock->now() + linkLatency) + clockOffsetUs;
+    }
+
+    /// @brief Queue a reply the Pico sends at the given time (on the Pi's clock)
+    void reply(const std::string &line, std::chrono::steady_clock::time_point sent) {
+        replies.push_back(Reply{line, sent + linkLatency});
+    }
+
+    /// @brief Queue a reply to a line written just now
+    void reply(const std::string &line) {
+        reply(line, clock->now() + linkLatency);
+    }
+
+    void applySet(std::istringstream &words) {
+        int pin = 0, pulseWidth = 0;
+        std::string type;
+        words >> pin >> type >> pulseWidth;
+        bool thruster = std::find(uploadPins.begin(), uploadPins.end(), pin) != uploadPins.end();
+        if (type == "PWM" && !(armed && thruster)) {
+            pwms[pin] = pulseWidth;
+        }
+    }
+
+    /// @brief Apply a complete timestamped frame at its time, or as soon as it arrives if that is later
+    void applyTimedFrame() {
+        int64_t actual = std::max(timedFrameUs, arrivalUs());
+        std::istringstream lines(timedFrame);
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::istringstream words(line);
+            std::string command;
+            words >> command;
+            if (command == "Set") {
+                applySet(words);
+            }
+        }
+        appliedFrames.push_back(AppliedFrame{timedFrameUs, actual, timedFrame});
+        auto appliedAt = std::chrono::steady_clock::time_point(std::chrono::microseconds(actual - clockOffsetUs));
+        reply("Applied " + std::to_string(timedFrameUs) + " " + std::to_string(actual), appliedAt);
+        timedFrame.clear();
+    }
+
+    struct Step {
+        std::array<int, 8> pwms;
+        uint64_t durationUs;
+    };
+    std::array<int, 8> uploadPins{};
+    std::vector<Step> steps;
+    uint32_t expectedSteps = 0;
+    uint32_t stepChecksum = 2166136261u;
+    bool uploading = false;
+    bool uploaded = false;
+    bool armed = false;
+    bool playing = false;
+    uint32_t nextStep = 0;
+    std::chrono::steady_clock::time_point stepDue;
+
+    void handle(std::string line) {
+        if (hostRate != picoRate) {
+            return;
+        }
+        if (timedFrameRemaining > 0) {
+            timedFrame += line + "\n";
+            timedFrameRemaining -= std::min(timedFrameRemaining, line.size() + 1);
+            if (timedFrameRemaining == 0) {
+                applyTimedFrame();
+            }
+            return;
+        }
+        bool reliable = picoRate <= maxReliableRate;
+        std::istringstream words(line);
+        std::string command;
+        words >> command;
+
+        if (command == "Echo" && answersEcho) {
+            if (!reliable) {
+                line.back() ^= 0x01;
+            } else {
+                waitingForIntactLine = false;
+            }
+            reply(line);
+        } else if (command == "Baud" && answersBaud) {
+            int rate = 0;
+            words >> rate;
+            if (supportedRates.count(rate) == 0) {
+                reply(line + " Unsupported");
+                return;
+            }
+            reply(line + " OK");
+            picoRate = rate;
+            waitingForIntactLine = true;
+        } else if (command == "Set") {
+            applySet(words);
+        } else if (command == "Ping") {
+            std::string sent;
+            words >> sent;
+            int64_t receivedUs = arrivalUs();
+            reply("Pong " + sent + " " + std::to_string(receivedUs) + " " + std::to_string(receivedUs + 10),
+                  clock->now() + linkLatency + std::chrono::microseconds(10));
+        } else if (command == "At") {
+            words >> timedFrameUs >> timedFrameRemaining;
+        } else if (command == "Upload") {
+            words >> expectedSteps;
+            for (int &pin: uploadPins) {
+                words >> pin;
+            }
+            steps.clear();
+            stepChecksum = 2166136261u;
+            uploading = true;
+            uploaded = false;
+        } else if (command == "Step" && uploading) {
+            std::string stepLine = line + "\n";
+            if (corruptsUploads) {
+                stepLine[5] ^= 0x01;
+            }
+            stepChecksum = uploadChecksum(stepLine.data(), stepLine.size(), stepChecksum);
+            Step step{};
+            for (int &pulseWidth: step.pwms) {
+                words >> pulseWidth;
+            }
+            words >> step.durationUs;
+            steps.push_back(step);
+        } else if (command == "End" && uploading) {
+            uint32_t checksum = 0;
+            words >> checksum;
+            uploading = false;
+            if (steps.size() != expectedSteps || checksum != stepChecksum) {
+                reply("Upload Failed checksum");
+                return;
+            }
+            uploaded = true;
+            reply("Uploaded " + std::to_string(steps.size()) + " " + std::to_string(stepChecksum));
+        } else if (command == "Arm") {
+            armed = uploaded;
+            reply(armed ? "Armed" : "Arm Failed nothing uploaded");
+        } else if (command == "Trigger") {
+            if (!armed) {
+                reply("Trigger Failed not armed");
+                return;
+            }
+            reply("Playing");
+            playing = true;
+            nextStep = 0;
+            stepDue = clock->now() + linkLatency;
+        } else if (command == "Abort") {
+            playing = false;
+            armed = false;
+            for (int pin: uploadPins) {
+                pwms[pin] = 1500;
+            }
+            reply("Aborted");
+        }
+    }
+
+    /// @brief Carry out the next playback event if it is due within the timeout
+    bool play(std::chrono::milliseconds timeout) {
+        if (!playing || (stallsAtStep >= 0 && nextStep >= static_cast<uint32_t>(stallsAtStep))) {
+            return false;
+        }
+        if (stepDue > clock->now() + timeout) {
+            return false;
+        }
+        clock->sleepUntil(stepDue);
+        if (nextStep == steps.size()) {
+            playing = false;
+            armed = false;
+            reply("Done", stepDue);
+            return true;
+        }
+        const Step &step = steps[nextStep];
+        for (int thruster = 0; thruster < 8; thruster++) {
+            pwms[uploadPins[thruster]] = step.pwms[thruster];
+        }
+        appliedSteps.push_back(AppliedStep{nextStep, clock->now(), step.pwms});
+        reply("Progress " + std::to_string(nextStep), stepDue);
+        // Time steps from when they were due, not when they happened, like a hardware timer would
+        stepDue += std::chrono::microseconds(step.durationUs);
+        nextStep++;
+        return true;
+    }
+
+public:
+    bool writeBytes(const char *bytes, std::size_t length) override {
+        received.append(bytes, length);
+        std::size_t newline;
+        while ((newline = received.find('\n')) != std::string::npos) {
+            handle(received.substr(0, newline));
+            received.erase(0, newline + 1);
+        }
+        return true;
+    }
+
+    bool readLine(std::string &line, std::chrono::milliseconds timeout) override {
+        if (replies.empty() || replies.front().available > clock->now() + timeout) {
+            play(timeout);
+        }
+        if (replies.empty() || replies.front().available > clock->now() + timeout) {
+            if (playing) {
+                clock->sleepUntil(clock->now() + timeout);
+            }
+            // Nothing more is coming, so this is as good as the Pico's revert timeout running out
+            if (waitingForIntactLine) {
+                picoRate = defaultBaudRate;
+                waitingForIntactLine = false;
+            }
+            return false;
+        }
+        clock->sleepUntil(replies.front().available);
+        line = replies.front().line;
+        replies.pop_front();
+        return true;
+    }
+
+    bool setBaudRate(int baudRate) override {
+        hostRate = baudRate;
+        return true;
+    }
+
+    void discardInput() override {
+        replies.clear();
+    }
+};
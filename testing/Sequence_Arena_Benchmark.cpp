@@ -0,0 +1,70 @@
+// Compares building candidate sequences the way a planner does (many per cycle, most thrown away) with a
+// std::vector-backed Sequence and with SequenceBuilder in a SequenceArena.
+
+#include "Allocation_Counter.h"
+#include "Sequence_Arena.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+    volatile int sink = 0;
+
+    const int commandsPerCandidate = 8;
+    const int candidatesPerCycle = 64;
+
+    pwm_array candidatePwms(int candidate, int command) {
+        pwm_array pwms{};
+        for (int thruster = 0; thruster < 8; thruster++) {
+            pwms.pwm_signals[thruster] = 1100 + (candidate * 37 + command * 11 + thruster * 53) % 800;
+        }
+        return pwms;
+    }
+
+    template<typename Cycle>
+    void benchmark(const char *name, int cycles, Cycle cycle) {
+        uint64_t allocationsBefore = allocationCount().load();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < cycles; i++) {
+            cycle();
+        }
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+        double candidates = static_cast<double>(cycles) * candidatesPerCycle;
+        std::cout << name << ": " << elapsed.count() / candidates << " ns/candidate, "
+                  << static_cast<double>(allocationCount().load() - allocationsBefore) / candidates
+                  << " allocations/candidate" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    int cycles = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const auto duration = std::chrono::milliseconds(100);
+
+    benchmark("Sequence (std::vector)", cycles, [&]() {
+        for (int candidate = 0; candidate < candidatesPerCycle; candidate++) {
+            Sequence sequence;
+            for (int command = 0; command < commandsPerCandidate; command++) {
+                pwm_array pwms = candidatePwms(candidate, command);
+                sequence.commands.push_back(Command{{pwms, std::chrono::milliseconds(0)}, {pwms, duration},
+                                                    {pwms, std::chrono::milliseconds(0)}});
+            }
+            sink = sink + sequence.commands.back().steadyState.thruster_pwms.pwm_signals[0];
+        }
+    });
+
+    SequenceArena arena;
+    SequenceBuilder builder(arena, commandsPerCandidate);
+    benchmark("ArenaSequence (SequenceBuilder)", cycles, [&]() {
+        for (int candidate = 0; candidate < candidatesPerCycle; candidate++) {
+            for (int command = 0; command < commandsPerCandidate; command++) {
+                builder.hold(candidatePwms(candidate, command), duration);
+            }
+            ArenaSequence sequence = builder.build();
+            sink = sink + (sequence.end() - 1)->steadyState.thruster_pwms.pwm_signals[0];
+        }
+        arena.reset();
+    });
+    std::cout << "Arena: " << arena.peakBytesUsed() << " bytes at peak, " << arena.blockCount() << " block(s)"
+              << std::endl;
+    return 0;
+}
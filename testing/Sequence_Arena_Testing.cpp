@@ -0,0 +1,133 @@
+#include "Allocation_Counter.h"
+#include "Sequence_Arena.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <type_traits>
+
+namespace {
+    /// @brief Discards everything written to it, without allocating
+    class DiscardBuffer : public std::streambuf {
+    public:
+        std::size_t bytes = 0;
+
+    protected:
+        int overflow(int character) override {
+            bytes++;
+            return traits_type::not_eof(character);
+        }
+
+        std::streamsize xsputn(const char *, std::streamsize count) override {
+            bytes += static_cast<std::size_t>(count);
+            return count;
+        }
+    };
+
+    const pwm_array stopped = {1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500};
+    const pwm_array forwards = {1900, 1900, 1500, 1500, 1500, 1500, 1900, 1900};
+    const pwm_array turning = {1900, 1100, 1500, 1500, 1500, 1500, 1900, 1100};
+}
+
+static_assert(!std::is_copy_constructible<ArenaSequence>::value, "Arena sequences are handed over, not shared");
+static_assert(std::is_nothrow_move_constructible<ArenaSequence>::value, "Arena sequences move without allocating");
+
+// Frames have to go to the discarding stream, because a frame recorder allocates, and only mock builds write to the
+// stream instead of looking for the Pico
+#ifdef MOCK_RPI
+TEST(SequenceArenaTest, BuildingAndExecutingDoesNotAllocate) {
+    DiscardBuffer serialBuffer;
+    std::ostream serialOutput(&serialBuffer);
+    std::ofstream outLog("/dev/null");
+    WiringControl wiringControl = WiringControl(serialOutput, outLog, std::cerr);
+    Command_Interpreter_RPi5 interpreter(makeThrusterPins(), std::vector<DigitalPin>{},
+                                         wiringControl, serialOutput, outLog, std::cerr);
+    interpreter.initializePins();
+
+    SequenceArena arena(16 * 1024);
+    SequenceBuilder builder(arena, 4);
+    uint64_t before = threadAllocationCount();
+    for (int cycle = 0; cycle < 100; cycle++) {
+        // Like a planner: build a few candidates, throw most of them away and execute the best
+        for (int candidate = 0; candidate < 10; candidate++) {
+            builder.hold(forwards, std::chrono::milliseconds(0))
+                    .then(component(turning, 0), component(turning, 0), component(stopped, 0))
+                    .hold(stopped, std::chrono::milliseconds(0));
+            ArenaSequence discarded = builder.build();
+            ASSERT_EQ(discarded.size(), 3u);
+        }
+        interpreter.blind_execute(builder.hold(forwards, std::chrono::milliseconds(0)).build());
+        arena.reset();
+    }
+    uint64_t arenaAllocations = threadAllocationCount() - before;
+
+    // The same work with std::vector, to show that the allocations would be counted
+    before = threadAllocationCount();
+    for (int candidate = 0; candidate < 10; candidate++) {
+        Sequence sequence;
+        sequence.commands.push_back(Command{component(forwards, 0), component(forwards, 0), component(forwards, 0)});
+        interpreter.blind_execute(sequence);
+    }
+    uint64_t vectorAllocations = threadAllocationCount() - before;
+
+    ASSERT_EQ(arenaAllocations, 0u);
+    ASSERT_GE(vectorAllocations, 10u);
+    ASSERT_EQ(arena.blockCount(), 1u);
+    ASSERT_GT(serialBuffer.bytes, 0u);
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1900, 1900, 1500, 1500, 1500, 1500, 1900, 1900}));
+}
+#endif
+
+TEST(SequenceArenaTest, ResetReusesMemoryAndOverflowGrows) {
+    SequenceArena arena(256);
+    void *first = arena.allocate(100, 8);
+    void *second = arena.allocate(1, 1);
+    void *aligned = arena.allocate(8, 8);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % 8, 0u);
+    ASSERT_EQ(static_cast<char *>(second), static_cast<char *>(first) + 100);
+    ASSERT_EQ(arena.bytesUsed(), 112u);
+
+    arena.reset();
+    ASSERT_EQ(arena.bytesUsed(), 0u);
+    ASSERT_EQ(arena.allocate(100, 8), first);
+
+    // Too big for what is left: a second, bigger block is added and kept after a reset
+    ASSERT_NE(arena.allocate(1000, 8), nullptr);
+    ASSERT_EQ(arena.blockCount(), 2u);
+    ASSERT_EQ(arena.peakBytesUsed(), 256u + 1000u);
+    arena.reset();
+    arena.allocate(200, 8);
+    uint64_t before = threadAllocationCount();
+    arena.allocate(1000, 8);
+    ASSERT_EQ(threadAllocationCount() - before, 0u);
+    ASSERT_EQ(arena.blockCount(), 2u);
+}
+
+TEST(SequenceArenaTest, CompilesLikeAnOrdinarySequence) {
+    SequenceArena arena;
+    SequenceBuilder builder(arena, 1);
+    Sequence sequence;
+    for (int i = 0; i < 20; i++) {
+        Command command{component(forwards, i), component(i % 2 ? turning : forwards, 10), component(stopped, 5)};
+        builder.then(command);
+        sequence.commands.push_back(command);
+    }
+    ArenaSequence built = builder.build();
+    ASSERT_EQ(builder.size(), 0u);
+    ASSERT_EQ(built.size(), 20u);
+
+    ArenaSequence moved = std::move(built);
+    ASSERT_TRUE(built.empty());
+    MissionTimeline fromArena;
+    MissionTimeline fromVector;
+    ASSERT_TRUE(compileSequence(moved.begin(), moved.size(), thrusterPinNumbers, fromArena, std::cerr));
+    ASSERT_TRUE(compileSequence(sequence, thrusterPinNumbers, fromVector, std::cerr));
+    ASSERT_EQ(fromArena.header().entryCount, fromVector.header().entryCount);
+    ASSERT_EQ(fromArena.header().totalDurationNs, fromVector.header().totalDurationNs);
+    for (uint32_t i = 0; i < fromArena.header().entryCount; i++) {
+        const TimelineEntry &arenaEntry = fromArena.entry(i);
+        const TimelineEntry &vectorEntry = fromVector.entry(i);
+        ASSERT_EQ(arenaEntry.offsetNs, vectorEntry.offsetNs);
+        ASSERT_EQ(std::string(fromArena.bytes(arenaEntry), arenaEntry.byteLength),
+                  std::string(fromVector.bytes(vectorEntry), vectorEntry.byteLength));
+    }
+}
@@ -0,0 +1,63 @@
+#include "Pico_Emulator.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+TEST(SequenceUploadTest, PicoPlaysSequenceOnItsOwnClock) {
+    auto pico = std::make_shared<PicoEmulator>();
+    RecordedInterpreter recorded(makeThrusterPins(), {}, [&](WiringControl &wiringControl) {
+        wiringControl.attachPicoLink(pico);
+    });
+    pico->clock = recorded.clock;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+
+    auto startTime = recorded.clock->now();
+    ASSERT_TRUE(interpreter.onboard_execute(testSequence()));
+    ASSERT_EQ(recorded.clock->now() - startTime, std::chrono::milliseconds(80));
+
+    ASSERT_EQ(pico->appliedSteps.size(), 4u);
+    const std::chrono::milliseconds expectedOffsets[] = {std::chrono::milliseconds(0), std::chrono::milliseconds(30),
+                                                         std::chrono::milliseconds(50), std::chrono::milliseconds(60)};
+    for (std::size_t i = 0; i < pico->appliedSteps.size(); i++) {
+        ASSERT_EQ(pico->appliedSteps[i].index, i);
+        ASSERT_EQ(pico->appliedSteps[i].time - startTime, expectedOffsets[i]);
+    }
+    ASSERT_EQ(pico->appliedSteps[2].pwms, (std::array<int, 8>{1900, 1100, 1500, 1500, 1500, 1500, 1900, 1100}));
+    ASSERT_EQ(pico->pwms[5], 1500);
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+}
+
+TEST(SequenceUploadTest, CorruptedUploadIsNotPlayed) {
+    ASSERT_EQ(uploadChecksum("", 0), 2166136261u);
+    ASSERT_EQ(uploadChecksum("a", 1), 0xe40c292cu);
+
+    PicoEmulator pico;
+    pico.corruptsUploads = true;
+    std::ostringstream errorLog;
+    MissionTimeline timeline;
+    ASSERT_TRUE(compileSequence(testSequence(), thrusterPinNumbers, timeline, errorLog));
+
+    SequenceUploader uploader(pico, errorLog, std::chrono::milliseconds(10));
+    ASSERT_FALSE(uploader.upload(timeline));
+    ASSERT_FALSE(uploader.arm());
+    ASSERT_TRUE(pico.appliedSteps.empty());
+    ASSERT_NE(errorLog.str().find("Upload Failed"), std::string::npos);
+}
+
+TEST(SequenceUploadTest, AbortsWhenPicoStopsReporting) {
+    auto pico = std::make_shared<PicoEmulator>();
+    pico->stallsAtStep = 2;
+    RecordedInterpreter recorded(makeThrusterPins(), {}, [&](WiringControl &wiringControl) {
+        wiringControl.attachPicoLink(pico);
+    });
+    pico->clock = recorded.clock;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+
+    ASSERT_FALSE(interpreter.onboard_execute(testSequence()));
+    ASSERT_EQ(pico->appliedSteps.size(), 2u);
+    ASSERT_NE(recorded.errorLog.str().find("before step 2"), std::string::npos);
+    ASSERT_EQ(pico->pwms[4], 1500);
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+}
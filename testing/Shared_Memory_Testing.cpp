@@ -0,0 +1,205 @@
+#include "Propulsion_Daemon.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+
+static std::string uniqueRegionName() {
+    return "/propulsion_test_" + std::to_string(getpid());
+}
+
+/// @brief Run body in a child process that then exits without cleaning up, as if it had crashed
+template<typename Body>
+static void runInExitedProcess(Body body) {
+    pid_t child = fork();
+    if (child == 0) {
+        body();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+}
+
+/// @brief Leave the command slot as a client that died partway through a write would
+static void abandonCommandWrite(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    ASSERT_NE(fd, -1);
+    void *address = mmap(nullptr, sizeof(PropulsionSharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    ASSERT_NE(address, MAP_FAILED);
+    auto *region = static_cast<PropulsionSharedRegion *>(address);
+    // The sequence number is the Seqlock's first member; an odd one means a write is in progress
+    static_assert(std::is_standard_layout<Seqlock<SharedCommand>>::value, "Seqlock layout is relied on here");
+    auto &sequence = *reinterpret_cast<std::atomic<uint32_t> *>(&region->command);
+    sequence.fetch_add(1);
+    munmap(address, sizeof(PropulsionSharedRegion));
+}
+
+TEST(SharedMemoryTest, ClientCommandReachesDaemonSide) {
+    PropulsionSharedMemory daemonSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(daemonSide.create());
+    PropulsionSharedMemory clientSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(clientSide.open());
+
+    SharedCommand command{};
+    uint32_t lastVersion = 0;
+    ASSERT_FALSE(daemonSide.readNewCommand(command, lastVersion));
+
+    clientSide.writeCommand(pwm_array{1900, 1100, 1500, 1500, 1250, 1750, 1500, 1500});
+    ASSERT_TRUE(daemonSide.readNewCommand(command, lastVersion));
+    ASSERT_EQ(command.mode, PwmMode);
+    ASSERT_EQ(command.pwms.pwm_signals[0], 1900);
+    ASSERT_EQ(command.pwms.pwm_signals[5], 1750);
+    ASSERT_FALSE(daemonSide.readNewCommand(command, lastVersion));
+
+    clientSide.writeCommand(force_array{1.5f, -2.0f, 0, 0, 0, 0, 0, 0});
+    ASSERT_TRUE(daemonSide.readNewCommand(command, lastVersion));
+    ASSERT_EQ(command.mode, ForceMode);
+    ASSERT_FLOAT_EQ(command.forces.forces[1], -2.0f);
+}
+
+TEST(SharedMemoryTest, OpenWithoutDaemonFails) {
+    std::ofstream errorLog("/dev/null");
+    PropulsionSharedMemory clientSide("/propulsion_test_missing_region", errorLog);
+    ASSERT_FALSE(clientSide.open());
+    ASSERT_FALSE(clientSide.isOpen());
+}
+
+TEST(SharedMemoryTest, DaemonExecutesSharedCommands) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+
+    PropulsionSharedMemory daemonSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(daemonSide.create());
+    PropulsionSharedMemory clientSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(clientSide.open());
+    PropulsionDaemon daemon(interpreter, daemonSide, recorded.outLog, std::cerr);
+
+    clientSide.writeCommand(pwm_array{1900, 1900, 1100, 1250, 1300, 1464, 1535, 1536});
+    ASSERT_TRUE(daemon.pollOnce());
+    ASSERT_FALSE(daemon.pollOnce());
+    std::string output = recorded.frames->text();
+
+    SharedTelemetry telemetry{};
+    clientSide.readTelemetry(telemetry);
+    ASSERT_EQ(telemetry.pinCount, 8);
+    ASSERT_EQ(telemetry.commandsApplied, 1u);
+    ASSERT_EQ(std::vector<int>(telemetry.pinValues, telemetry.pinValues + 8),
+              (std::vector<int>{1900, 1900, 1100, 1250, 1300, 1464, 1535, 1536}));
+    ASSERT_NE(output.find("Set 6 PWM 1536\n"), std::string::npos);
+}
+
+TEST(SharedMemoryTest, DaemonTurnsForcesIntoPulseWidths) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+
+    PropulsionSharedMemory daemonSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(daemonSide.create());
+    PropulsionSharedMemory clientSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(clientSide.open());
+    ThrustModel model(std::array<ThrusterGeometry, 8>{});
+    PropulsionDaemon daemon(interpreter, daemonSide, recorded.outLog, std::cerr, model);
+
+    // More than the thrusters can give is limited to full thrust
+    ASSERT_TRUE(clientSide.writeCommand(force_array{model.thrust(1700), model.thrust(1300), 0, 0, 0, 0, 1000, -1000}));
+    ASSERT_TRUE(daemon.pollOnce());
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1700, 1300, 1500, 1500, 1500, 1500, 1900, 1100}));
+    ASSERT_EQ(daemon.appliedCount(), 1u);
+    ASSERT_NE(recorded.frames->text().find("Set 8 PWM 1900\nSet 6 PWM 1100\n"), std::string::npos);
+}
+
+TEST(SharedMemoryTest, SecondDaemonLeavesRunningRegionAlone) {
+    std::ostringstream errorLog;
+    PropulsionSharedMemory daemonSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(daemonSide.create());
+    PropulsionSharedMemory clientSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(clientSide.open());
+    ASSERT_TRUE(clientSide.writeCommand(pwm_array{1900, 1100, 1500, 1500, 1500, 1500, 1500, 1500}));
+
+    PropulsionSharedMemory secondDaemon(uniqueRegionName(), errorLog);
+    ASSERT_FALSE(secondDaemon.create());
+    ASSERT_NE(errorLog.str().find("already served by process " + std::to_string(getpid())), std::string::npos);
+
+    // The first daemon's region (and the command waiting in it) is untouched
+    SharedCommand command{};
+    uint32_t lastVersion = 0;
+    ASSERT_TRUE(daemonSide.readNewCommand(command, lastVersion));
+    ASSERT_EQ(command.pwms.pwm_signals[0], 1900);
+}
+
+TEST(SharedMemoryTest, TakesOverRegionOfExitedDaemon) {
+    const std::string name = uniqueRegionName();
+    runInExitedProcess([&name]() {
+        // Never destroyed, so the region is left behind
+        auto *crashedDaemon = new PropulsionSharedMemory(name, std::cerr);
+        crashedDaemon->create();
+    });
+
+    std::ostringstream errorLog;
+    PropulsionSharedMemory daemonSide(uniqueRegionName(), errorLog);
+    ASSERT_TRUE(daemonSide.create());
+    ASSERT_NE(errorLog.str().find("Taking over"), std::string::npos);
+    PropulsionSharedMemory clientSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(clientSide.open());
+}
+
+TEST(SharedMemoryTest, OneClientCommandsAtATime) {
+    std::ostringstream errorLog;
+    PropulsionSharedMemory daemonSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(daemonSide.create());
+    SharedCommand command{};
+    uint32_t lastVersion = 0;
+
+    PropulsionSharedMemory other(uniqueRegionName(), errorLog);
+    ASSERT_TRUE(other.open());
+    {
+        PropulsionSharedMemory first(uniqueRegionName(), errorLog);
+        ASSERT_TRUE(first.open());
+        ASSERT_TRUE(first.writeCommand(pwm_array{1900, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+        ASSERT_FALSE(other.writeCommand(pwm_array{1100, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+        ASSERT_TRUE(daemonSide.readNewCommand(command, lastVersion));
+        ASSERT_EQ(command.pwms.pwm_signals[0], 1900);
+    }
+
+    // Once the first client is gone, the slot is free
+    ASSERT_TRUE(other.writeCommand(pwm_array{1100, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+    ASSERT_TRUE(daemonSide.readNewCommand(command, lastVersion));
+    ASSERT_EQ(command.pwms.pwm_signals[0], 1100);
+}
+
+TEST(SharedMemoryTest, SkipsWriteAbandonedByDeadClient) {
+    std::ostringstream errorLog;
+    PropulsionSharedMemory daemonSide(uniqueRegionName(), errorLog, std::chrono::milliseconds(5));
+    ASSERT_TRUE(daemonSide.create());
+    const std::string name = uniqueRegionName();
+    runInExitedProcess([&name]() {
+        // Never destroyed, so the command slot is never given back
+        auto *crashedClient = new PropulsionSharedMemory(name, std::cerr);
+        if (crashedClient->open()) {
+            crashedClient->writeCommand(pwm_array{1900, 1900, 1900, 1900, 1900, 1900, 1900, 1900});
+        }
+    });
+    abandonCommandWrite(uniqueRegionName());
+
+    SharedCommand command{};
+    uint32_t lastVersion = 0;
+    ASSERT_FALSE(daemonSide.readNewCommand(command, lastVersion));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(daemonSide.readNewCommand(command, lastVersion));
+    ASSERT_NE(errorLog.str().find("died while writing"), std::string::npos);
+
+    // The half-written command is never executed, and the next client can take over without waiting
+    ASSERT_FALSE(daemonSide.readNewCommand(command, lastVersion));
+    PropulsionSharedMemory clientSide(uniqueRegionName(), std::cerr);
+    ASSERT_TRUE(clientSide.open());
+    ASSERT_TRUE(clientSide.writeCommand(pwm_array{1600, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+    ASSERT_TRUE(daemonSide.readNewCommand(command, lastVersion));
+    ASSERT_EQ(command.pwms.pwm_signals[0], 1600);
+}
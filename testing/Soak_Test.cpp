@@ -0,0 +1,294 @@
+// Long-duration soak and throughput stress test for the Command Interpreter, run against the mock serial backend.
+//
+// Drives one of the execute paths at a fixed rate for a given time and tracks command latency (p99/p999), timing
+// drift, dropped ticks, resident memory growth and heap allocations. Exits with 1 if any threshold is exceeded.
+//
+// Usage: propulsion_soak [--mode untimed|blind|sequence|timeline] [--rate Hz] [--duration seconds]
+//                        [--max-p99-us N] [--max-p999-us N] [--max-drift-us N] [--max-dropped-percent N]
+//                        [--max-rss-growth-kb N] [--max-allocations-per-command N]
+
+#include "Allocation_Counter.h"
+#include "Test_Fixtures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    struct Options {
+        std::string mode = "untimed";
+        double rate = 1000;
+        double duration = 10;
+        double maxP99Us = 2000;
+        double maxP999Us = 10000;
+        double maxDriftUs = 20000;
+        double maxDroppedPercent = 5;
+        double maxRssGrowthKb = 1024;
+        double maxAllocationsPerCommand = 0;
+    };
+
+    /// @brief Counts the bytes the interpreter would have sent to the Pico, then throws them away
+    class CountingBuffer : public std::streambuf {
+    public:
+        uint64_t bytes = 0;
+
+    protected:
+        int overflow(int character) override {
+            bytes++;
+            return character;
+        }
+
+        std::streamsize xsputn(const char *, std::streamsize count) override {
+            bytes += static_cast<uint64_t>(count);
+            return count;
+        }
+    };
+
+    /// @brief Latencies in 1 microsecond buckets up to 100 ms, so recording never allocates
+    class LatencyHistogram {
+        static constexpr int bucketCount = 100000;
+        uint64_t buckets[bucketCount + 1] = {};
+        uint64_t count = 0;
+        double maximum = 0;
+
+    public:
+        void record(std::chrono::nanoseconds latency) {
+            double microseconds = std::max(0.0, static_cast<double>(latency.count()) / 1000.0);
+            buckets[microseconds >= bucketCount ? bucketCount : static_cast<int>(microseconds)]++;
+            maximum = std::max(maximum, microseconds);
+            count++;
+        }
+
+        double percentile(double fraction) const {
+            if (count == 0) {
+                return 0;
+            }
+            auto target = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(count)));
+            uint64_t seen = 0;
+            for (int bucket = 0; bucket <= bucketCount; bucket++) {
+                seen += buckets[bucket];
+                if (seen >= target) {
+                    return bucket == bucketCount ? maximum : bucket + 1;
+                }
+            }
+            return maximum;
+        }
+
+        double max() const {
+            return maximum;
+        }
+
+        uint64_t samples() const {
+            return count;
+        }
+    };
+
+    long residentKb() {
+        long pages = 0, resident = 0;
+        FILE *statm = std::fopen("/proc/self/statm", "r");
+        if (statm == nullptr) {
+            return 0;
+        }
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(statm);
+        return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    bool parse(int argc, char **argv, Options &options) {
+        for (int i = 1; i < argc; i++) {
+            std::string flag = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << flag << std::endl;
+                return false;
+            }
+            std::string value = argv[++i];
+            if (flag == "--mode") {
+                options.mode = value;
+            } else if (flag == "--rate") {
+                options.rate = std::atof(value.c_str());
+            } else if (flag == "--duration") {
+                options.duration = std::atof(value.c_str());
+            } else if (flag == "--max-p99-us") {
+                options.maxP99Us = std::atof(value.c_str());
+            } else if (flag == "--max-p999-us") {
+                options.maxP999Us = std::atof(value.c_str());
+            } else if (flag == "--max-drift-us") {
+                options.maxDriftUs = std::atof(value.c_str());
+            } else if (flag == "--max-dropped-percent") {
+                options.maxDroppedPercent = std::atof(value.c_str());
+            } else if (flag == "--max-rss-growth-kb") {
+                options.maxRssGrowthKb = std::atof(value.c_str());
+            } else if (flag == "--max-allocations-per-command") {
+                options.maxAllocationsPerCommand = std::atof(value.c_str());
+            } else {
+                std::cerr << "Unknown option " << flag << std::endl;
+                return false;
+            }
+        }
+        if (options.rate <= 0 || options.duration <= 0) {
+            std::cerr << "Rate and duration must be positive" << std::endl;
+            return false;
+        }
+        if (options.mode != "untimed" && options.mode != "blind" && options.mode != "sequence" &&
+            options.mode != "timeline") {
+            std::cerr << "Unknown mode " << options.mode << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    pwm_array pwmsForTick(uint64_t tick) {
+        pwm_array pwms{};
+        for (int thruster = 0; thruster < 8; thruster++) {
+            pwms.pwm_signals[thruster] = 1100 + static_cast<int>((tick * 7 + thruster * 101) % 801);
+        }
+        return pwms;
+    }
+
+    bool check(const char *name, double value, double limit) {
+        bool passed = value <= limit;
+        std::cout << "  " << name << ": " << value << " (limit " << limit << ")" << (passed ? "" : "  FAILED")
+                  << std::endl;
+        return passed;
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        return 2;
+    }
+
+    CountingBuffer serialBuffer;
+    std::ostream serialOutput(&serialBuffer);
+    std::ofstream outLog("/dev/null");
+
+    WiringControl wiringControl = WiringControl(serialOutput, outLog, std::cerr);
+    Command_Interpreter_RPi5 interpreter(makeThrusterPins(), std::vector<DigitalPin>{}, wiringControl, serialOutput,
+                                         outLog, std::cerr);
+    interpreter.initializePins();
+
+    const auto period = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::duration<double>(1.0 / options.rate));
+    const auto componentDuration = std::chrono::duration_cast<std::chrono::milliseconds>(period);
+    if ((options.mode != "untimed") && componentDuration.count() == 0) {
+        std::cerr << "Mode " << options.mode << " holds each command for whole milliseconds; use a rate of at most "
+                  << "1000 Hz" << std::endl;
+        return 2;
+    }
+    // The command is held for whole milliseconds in the timed modes, so that is what each tick should take
+    const auto tickPeriod = options.mode == "untimed" ? period : std::chrono::nanoseconds(componentDuration);
+    const auto expectedHold = options.mode == "untimed" ? std::chrono::nanoseconds(0) : tickPeriod;
+
+    // The sequence modes play one component per tick, three per command
+    Sequence sequence;
+    sequence.commands.push_back(Command{CommandComponent{pwmsForTick(0), componentDuration},
+                                        CommandComponent{pwmsForTick(1), componentDuration},
+                                        CommandComponent{pwmsForTick(2), componentDuration}});
+    MissionTimeline timeline;
+    if (!interpreter.compile(sequence, timeline)) {
+        return 2;
+    }
+
+    auto *histogram = new LatencyHistogram();
+    auto runTick = [&](uint64_t tick) {
+        if (options.mode == "untimed") {
+            interpreter.untimed_execute(pwmsForTick(tick));
+        } else if (options.mode == "blind") {
+            interpreter.blind_execute(CommandComponent{pwmsForTick(tick), componentDuration});
+        } else if (options.mode == "sequence") {
+            interpreter.blind_execute(sequence);
+        } else {
+            interpreter.execute(timeline);
+        }
+    };
+    const uint64_t commandsPerTick = options.mode == "sequence" || options.mode == "timeline" ? 3 : 1;
+    const auto opPeriod = tickPeriod * static_cast<int64_t>(commandsPerTick);
+
+    // Warm up (first-touch allocations, page faults) before taking the baselines
+    for (uint64_t tick = 0; tick < 100; tick++) {
+        runTick(tick);
+    }
+
+    const long baselineRssKb = residentKb();
+    long peakRssKb = baselineRssKb;
+    const uint64_t baselineAllocations = allocationCount().load();
+    const uint64_t baselineBytes = serialBuffer.bytes;
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto end = start + std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::duration<double>(options.duration));
+    auto nextRssSample = start + std::chrono::seconds(1);
+    uint64_t tick = 0;
+    uint64_t executed = 0;
+    uint64_t dropped = 0;
+    double maxDriftUs = 0;
+    // The untimed mode runs on a fixed grid. The timed modes hold each command themselves, from whenever they are
+    // called, so their next tick is due when the last hold should have ended; on a fixed grid every hold's wake-up
+    // latency would push them further behind until the harness counted its own backlog as dropped ticks.
+    const bool holdsCommands = options.mode != "untimed";
+    auto scheduled = start;
+
+    while (scheduled < end) {
+        auto now = std::chrono::steady_clock::now();
+        if (now > scheduled + opPeriod) {
+            // More than a whole tick behind: count the missed ticks and pick up at the next one
+            auto missed = static_cast<uint64_t>((now - scheduled) / opPeriod);
+            dropped += missed;
+            tick += missed;
+            scheduled += opPeriod * static_cast<int64_t>(missed);
+            continue;
+        }
+        std::this_thread::sleep_until(scheduled);
+        auto tickStart = std::chrono::steady_clock::now();
+        maxDriftUs = std::max(maxDriftUs, static_cast<double>((tickStart - scheduled).count()) / 1000.0);
+
+        runTick(tick);
+        auto tickEnd = std::chrono::steady_clock::now();
+        // Latency is per command, so a tick of several commands records their average overshoot
+        histogram->record((tickEnd - tickStart - expectedHold * static_cast<int64_t>(commandsPerTick)) /
+                          static_cast<int64_t>(commandsPerTick));
+        executed++;
+        tick++;
+        scheduled = (holdsCommands ? tickStart : scheduled) + opPeriod;
+
+        if (tickEnd >= nextRssSample) {
+            peakRssKb = std::max(peakRssKb, residentKb());
+            nextRssSample += std::chrono::seconds(1);
+        }
+    }
+    peakRssKb = std::max(peakRssKb, residentKb());
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t commands = executed * commandsPerTick;
+    const double allocationsPerCommand =
+            commands == 0 ? 0 : static_cast<double>(allocationCount().load() - baselineAllocations) / commands;
+    const double droppedPercent = tick == 0 ? 0 : 100.0 * static_cast<double>(dropped) / static_cast<double>(tick);
+
+    std::cout << "Soak (" << options.mode << ", " << options.rate << " Hz, " << elapsed << " s): " << commands
+              << " commands, " << static_cast<double>(commands) / elapsed << " commands/s, "
+              << static_cast<double>(serialBuffer.bytes - baselineBytes) / elapsed << " bytes/s" << std::endl;
+    std::cout << "  latency p50/p99/p999/max (us): " << histogram->percentile(0.5) << " / "
+              << histogram->percentile(0.99) << " / " << histogram->percentile(0.999) << " / " << histogram->max()
+              << " over " << histogram->samples() << " ticks" << std::endl;
+
+    bool passed = true;
+    passed &= check("p99 latency (us)", histogram->percentile(0.99), options.maxP99Us);
+    passed &= check("p999 latency (us)", histogram->percentile(0.999), options.maxP999Us);
+    passed &= check("max drift (us)", maxDriftUs, options.maxDriftUs);
+    passed &= check("dropped ticks (%)", droppedPercent, options.maxDroppedPercent);
+    passed &= check("RSS growth (kB)", static_cast<double>(peakRssKb - baselineRssKb), options.maxRssGrowthKb);
+    passed &= check("allocations per command", allocationsPerCommand, options.maxAllocationsPerCommand);
+    delete histogram;
+
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
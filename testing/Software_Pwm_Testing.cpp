@@ -0,0 +1,168 @@
+#include "Software_Pwm.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+
+TEST(SoftwarePwmTest, EdgeScheduleIsSortedByTime) {
+    std::vector<PwmEdge> edges;
+    buildEdgeSchedule({{4, 1500}, {5, 1100}, {6, 1900}, {7, 0}}, std::chrono::microseconds(20000), edges);
+
+    ASSERT_EQ(edges.size(), 7);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(edges[i].offset.count(), 0);
+    }
+    ASSERT_FALSE(edges[3].high);
+    ASSERT_EQ(edges[3].pinNumber, 7);
+    ASSERT_EQ(edges[4].pinNumber, 5);
+    ASSERT_EQ(edges[4].offset, std::chrono::microseconds(1100));
+    ASSERT_EQ(edges[5].pinNumber, 4);
+    ASSERT_EQ(edges[5].offset, std::chrono::microseconds(1500));
+    ASSERT_EQ(edges[6].pinNumber, 6);
+    ASSERT_EQ(edges[6].offset, std::chrono::microseconds(1900));
+    ASSERT_FALSE(edges[6].high);
+}
+
+namespace {
+    /// @brief A manual clock for the engine's thread. Every wait overshoots its deadline by oversleep, and the first
+    /// wait that reaches end parks the thread until the engine is stopped, so a test sees exactly the periods before
+    /// end however long it takes to get around to stopping it.
+    class EngineTestClock : public InterpreterClock {
+    private:
+        ManualClock clock;
+        std::chrono::steady_clock::time_point end;
+        std::chrono::nanoseconds oversleep;
+        std::atomic<const SoftwarePwmEngine *> engine{nullptr};
+        std::atomic<bool> parked{false};
+
+    public:
+        EngineTestClock(std::chrono::milliseconds runFor, std::chrono::nanoseconds oversleep) :
+                end(std::chrono::steady_clock::time_point{} + runFor), oversleep(oversleep) {}
+
+        std::chrono::steady_clock::time_point now() override {
+            return clock.now();
+        }
+
+        void sleepUntil(std::chrono::steady_clock::time_point time) override {
+            const SoftwarePwmEngine *stoppable = engine.load();
+            if (time >= end && stoppable != nullptr) {
+                parked = true;
+                while (stoppable->isRunning()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            clock.sleepUntil(time + oversleep);
+        }
+
+        /// @brief Run engine until the clock reaches end, then stop it
+        void runUntilEnd(SoftwarePwmEngine &pwmEngine) {
+            engine = &pwmEngine;
+            pwmEngine.start();
+            while (!parked) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            pwmEngine.stop();
+        }
+    };
+}
+
+TEST(SoftwarePwmTest, GeneratesServoPulsesAgainstMockBackend) {
+    std::ofstream errorLog("/dev/null");
+    auto clock = std::make_shared<EngineTestClock>(std::chrono::milliseconds(200), std::chrono::nanoseconds(0));
+    MockGpioBackend backend(4096, clock);
+    SoftwarePwmEngine engine(backend, std::chrono::microseconds(20000), errorLog, clock);
+    engine.setPulseWidth(4, 1100);
+    engine.setPulseWidth(5, 1900);
+    clock->runUntilEnd(engine);
+
+    std::map<int, std::vector<RecordedEdge>> edgesByPin;
+    for (const auto &edge: backend.recordedEdges()) {
+        edgesByPin[edge.pinNumber].push_back(edge);
+    }
+    // Ten whole periods, each pin rising at the start of the period and falling once its pulse width has elapsed,
+    // then driven low when the engine stops
+    const auto start = std::chrono::steady_clock::time_point{};
+    const std::map<int, int> expectedWidths = {{4, 1100}, {5, 1900}};
+    for (const auto &expected: expectedWidths) {
+        const auto &edges = edgesByPin[expected.first];
+        ASSERT_EQ(edges.size(), 21u);
+        for (std::size_t period = 0; period < 10; period++) {
+            auto periodStart = start + std::chrono::microseconds(20000 * period);
+            ASSERT_TRUE(edges[2 * period].high);
+            ASSERT_EQ(edges[2 * period].time, periodStart);
+            ASSERT_FALSE(edges[2 * period + 1].high);
+            ASSERT_EQ(edges[2 * period + 1].time, periodStart + std::chrono::microseconds(expected.second));
+        }
+        ASSERT_FALSE(edges.back().high);
+    }
+
+    auto jitter = engine.jitter();
+    ASSERT_EQ(jitter.edgeCount, 40u);
+    ASSERT_EQ(jitter.maximumLateness.count(), 0);
+    ASSERT_EQ(jitter.meanLateness.count(), 0);
+}
+
+TEST(SoftwarePwmTest, ReportsEdgeLateness) {
+    std::ofstream errorLog("/dev/null");
+    auto clock = std::make_shared<EngineTestClock>(std::chrono::milliseconds(100), std::chrono::microseconds(50));
+    MockGpioBackend backend(4096, clock);
+    SoftwarePwmEngine engine(backend, std::chrono::microseconds(20000), errorLog, clock);
+    engine.setPulseWidth(4, 1100);
+    engine.setPulseWidth(5, 1900);
+    clock->runUntilEnd(engine);
+
+    // Every wait overshoots by 50 us, so every edge is exactly that late
+    auto jitter = engine.jitter();
+    ASSERT_EQ(jitter.edgeCount, 20u);
+    ASSERT_EQ(jitter.maximumLateness, std::chrono::microseconds(50));
+    ASSERT_EQ(jitter.meanLateness, std::chrono::microseconds(50));
+    auto edges = backend.recordedEdges();
+    ASSERT_EQ(edges[2].pinNumber, 4);
+    ASSERT_EQ(edges[2].time, std::chrono::steady_clock::time_point{} + std::chrono::microseconds(1150));
+}
+
+#ifdef MOCK_RPI
+TEST(SoftwarePwmTest, SoftwarePinsAreDrivenByAttachedEngine) {
+    MockGpioBackend backend;
+    SoftwarePwmEngine engine(backend, std::chrono::microseconds(20000), std::cerr);
+
+    auto pins = std::vector<PwmPin>{};
+    for (int pinNumber: thrusterPinNumbers) {
+        pins.push_back(SoftwarePwmPin(pinNumber));
+    }
+    bool attached = false;
+    RecordedInterpreter recorded(pins, {}, [&](WiringControl &wiringControl) {
+        attached = wiringControl.attachSoftwarePwmEngine(&engine);
+    });
+    ASSERT_TRUE(attached);
+
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+    interpreter.untimed_execute(pwm_array{1100, 1900, 1100, 1250, 1300, 1464, 1535, 1536});
+    std::string output = recorded.frames->text();
+
+    std::string expectedOutput;
+    for (int pinNumber: thrusterPinNumbers) {
+        expectedOutput.append("Configure ");
+        expectedOutput.append(std::to_string(pinNumber));
+        expectedOutput.append(" Digital\n");
+    }
+    ASSERT_EQ(output, expectedOutput);
+    ASSERT_EQ(engine.pulseWidth(4), 1100);
+    ASSERT_EQ(engine.pulseWidth(6), 1536);
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1100, 1900, 1100, 1250, 1300, 1464, 1535, 1536}));
+}
+#else
+TEST(SoftwarePwmTest, EngineIsRefusedOutsideMockBuilds) {
+    MockGpioBackend backend;
+    SoftwarePwmEngine engine(backend, std::chrono::microseconds(20000), std::cerr);
+    bool attached = true;
+    RecordedInterpreter recorded(makeThrusterPins(), {}, [&](WiringControl &wiringControl) {
+        attached = wiringControl.attachSoftwarePwmEngine(&engine);
+    });
+
+    // There is no backend for the Pi's own pins, so software pwm stays on the Pico
+    ASSERT_FALSE(attached);
+    ASSERT_NE(recorded.errorLog.str().find("only be generated on the Pi in mock builds"), std::string::npos);
+}
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Command_Interpreter.h"
+#include "Frame_Recorder.h"
+#include "Interpreter_Clock.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+/// @brief The thrusters' GPIO pins, in thruster order
+const std::vector<int> thrusterPinNumbers = {4, 5, 2, 3, 9, 7, 8, 6};
+
+/// @brief A hardware pwm pin for each thruster
+inline std::vector<PwmPin> makeThrusterPins() {
+    auto pins = std::vector<PwmPin>{};
+    for (int pinNumber: thrusterPinNumbers) {
+        pins.push_back(HardwarePwmPin(pinNumber));
+    }
+    return pins;
+}
+
+inline CommandComponent component(pwm_array pwms, int milliseconds) {
+    return CommandComponent{pwms, std::chrono::milliseconds(milliseconds)};
+}
+
+/// @brief Forwards, then a turn, each ramping down to a stop: 80 ms in all, sending four different frames at 0, 30, 50
+/// and 60 ms (the zero-length components repeat the value before them)
+inline Sequence testSequence() {
+    const pwm_array stopped = {1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500};
+    const pwm_array forwards = {1900, 1900, 1500, 1500, 1500, 1500, 1900, 1900};
+    const pwm_array turning = {1900, 1100, 1500, 1500, 1500, 1500, 1900, 1100};
+    return Sequence{{
+                            Command{component(forwards, 0), component(forwards, 30), component(stopped, 20)},
+                            Command{component(turning, 10), component(turning, 0), component(stopped, 20)}
+                    }};
+}
+
+/// @brief An interpreter whose frames go to its own recorder and whose time only moves when it waits, so tests
+/// neither capture stdout nor sleep and can run side by side
+struct RecordedInterpreter {
+    std::shared_ptr<ManualClock> clock = std::make_shared<ManualClock>();
+    std::shared_ptr<FrameRecorder> frames = std::make_shared<FrameRecorder>(clock);
+    std::ostringstream output;
+    std::ostringstream outLog;
+    std::ostringstream errorLog;
+    std::unique_ptr<Command_Interpreter_RPi5> interpreter;
+
+    /// @param setUp attaches whatever else the test needs (a Pico link, a software pwm engine) to the wiring before
+    /// the interpreter takes a copy of it
+    explicit RecordedInterpreter(std::vector<PwmPin> thrusterPins = makeThrusterPins(),
+                                 std::vector<DigitalPin> digitalPins = {},
+                                 const std::function<void(WiringControl &)> &setUp = nullptr) {
+        WiringControl wiringControl = WiringControl(output, outLog, errorLog);
+        wiringControl.recordFramesTo(frames);
+        if (setUp) {
+            setUp(wiringControl);
+        }
+        interpreter.reset(new Command_Interpreter_RPi5(std::move(thrusterPins), std::move(digitalPins),
+                                                       wiringControl, output, outLog, errorLog));
+        interpreter->useClock(clock);
+    }
+
+    /// @brief How far the clock has moved since the interpreter was created
+    std::chrono::milliseconds elapsed() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(clock->now().time_since_epoch());
+    }
+};
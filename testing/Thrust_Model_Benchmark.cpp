@@ -0,0 +1,54 @@
+// Measures how many candidate commands per second the batched thrust model evaluates, with 1 thread up to every core.
+
+#include "Thrust_Model.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+int main() {
+    const float diagonal = 0.70710678f;
+    ThrustModel model(std::array<ThrusterGeometry, 8>{{
+            {{0.3f, 0.2f, 0}, {diagonal, -diagonal, 0}},
+            {{0.3f, -0.2f, 0}, {diagonal, diagonal, 0}},
+            {{-0.3f, 0.2f, 0}, {diagonal, diagonal, 0}},
+            {{-0.3f, -0.2f, 0}, {diagonal, -diagonal, 0}},
+            {{0.2f, 0.25f, 0.05f}, {0, 0, 1}},
+            {{0.2f, -0.25f, 0.05f}, {0, 0, 1}},
+            {{-0.2f, 0.25f, 0.05f}, {0, 0, 1}},
+            {{-0.2f, -0.25f, 0.05f}, {0, 0, 1}},
+    }});
+
+    const std::size_t count = 1 << 16;
+    PwmBatch batch;
+    batch.resize(count);
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> pulseWidths(1100, 1900);
+    for (auto &column: batch.pulseWidths) {
+        for (float &pulseWidth: column) {
+            pulseWidth = static_cast<float>(pulseWidths(random));
+        }
+    }
+    WrenchBatch output;
+    output.resize(count);
+
+    double singleThreadRate = 0;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= cores; threads++) {
+        WorkStealingPool pool(threads);
+        model.evaluate(batch, output, &pool);
+        const int rounds = 200;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++) {
+            model.evaluate(batch, output, &pool);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rate = static_cast<double>(count) * rounds / seconds;
+        if (threads == 1) {
+            singleThreadRate = rate;
+        }
+        std::cout << threads << " thread(s): " << rate / 1e6 << " M candidates/s (" << rate / singleThreadRate
+                  << "x)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "Thrust_Model.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <random>
+
+namespace {
+    /// @brief Four vectored horizontal thrusters at the corners and four vertical ones
+    std::array<ThrusterGeometry, 8> testLayout() {
+        const float diagonal = 0.70710678f;
+        return std::array<ThrusterGeometry, 8>{{
+                {{0.3f, 0.2f, 0}, {diagonal, -diagonal, 0}},
+                {{0.3f, -0.2f, 0}, {diagonal, diagonal, 0}},
+                {{-0.3f, 0.2f, 0}, {diagonal, diagonal, 0}},
+                {{-0.3f, -0.2f, 0}, {diagonal, -diagonal, 0}},
+                {{0.2f, 0.25f, 0.05f}, {0, 0, 1}},
+                {{0.2f, -0.25f, 0.05f}, {0, 0, 1}},
+                {{-0.2f, 0.25f, 0.05f}, {0, 0, 1}},
+                {{-0.2f, -0.25f, 0.05f}, {0, 0, 1}},
+        }};
+    }
+
+    void expectSameWrench(const Wrench &actual, const Wrench &expected) {
+        for (int axis = 0; axis < 3; axis++) {
+            ASSERT_NEAR(actual.force[axis], expected.force[axis], 1e-3);
+            ASSERT_NEAR(actual.torque[axis], expected.torque[axis], 1e-3);
+        }
+    }
+}
+
+TEST(ThrustModelTest, FollowsThrusterCurveAndGeometry) {
+    ThrustModel model(testLayout());
+    ASSERT_FLOAT_EQ(model.thrust(1500), 0);
+    ASSERT_FLOAT_EQ(model.thrust(1520), 0);
+    ASSERT_NEAR(model.thrust(1900), 51.5, 0.5);
+    ASSERT_NEAR(model.thrust(1100), -40.2, 0.5);
+    ASSERT_NEAR(model.current(1900), 24, 0.2);
+    ASSERT_FLOAT_EQ(model.current(1500), 0);
+    ASSERT_FLOAT_EQ(model.pulseWidth(0), 1500);
+    ASSERT_NEAR(model.pulseWidth(model.thrust(1900)), 1900, 0.01);
+    ASSERT_NEAR(model.pulseWidth(model.thrust(1100)), 1100, 0.01);
+
+    // Only the front left vertical thruster, pushing up: lifts, rolls right side down, pitches nose up
+    force_array forces{};
+    forces.forces[4] = 10;
+    expectSameWrench(model.wrench(forces), Wrench{{0, 0, 10}, {2.5f, -2.0f, 0}});
+
+    // All vertical thrusters equally: pure lift
+    pwm_array lift = {1500, 1500, 1500, 1500, 1900, 1900, 1900, 1900};
+    Wrench lifted = model.wrench(lift);
+    ASSERT_NEAR(lifted.force[2], 4 * model.thrust(1900), 1e-3);
+    ASSERT_NEAR(lifted.torque[0], 0, 1e-4);
+    ASSERT_NEAR(lifted.torque[1], 0, 1e-4);
+}
+
+TEST(ThrustModelTest, ParallelBatchMatchesSingleEvaluation) {
+    ThrustModel model(testLayout());
+    WorkStealingPool pool(4);
+    std::mt19937 random(37);
+    std::uniform_int_distribution<int> pulseWidths(1100, 1900);
+    std::uniform_real_distribution<float> forces(-40, 50);
+
+    const std::size_t count = 5000;
+    std::vector<pwm_array> candidates(count);
+    std::vector<force_array> forceCandidates(count);
+    PwmBatch batch;
+    ForceBatch forceBatch;
+    batch.resize(count);
+    forceBatch.resize(count);
+    for (std::size_t i = 0; i < count; i++) {
+        for (int thruster = 0; thruster < 8; thruster++) {
+            candidates[i].pwm_signals[thruster] = pulseWidths(random);
+            forceCandidates[i].forces[thruster] = forces(random);
+        }
+        batch.set(i, candidates[i]);
+        forceBatch.set(i, forceCandidates[i]);
+    }
+
+    WrenchBatch serial, parallel, fromForces;
+    model.evaluate(batch, serial);
+    model.evaluate(batch, parallel, &pool);
+    model.evaluate(forceBatch, fromForces, &pool);
+    ASSERT_EQ(parallel.size(), count);
+    for (std::size_t i = 0; i < count; i++) {
+        expectSameWrench(parallel.wrench(i), model.wrench(candidates[i]));
+        expectSameWrench(serial.wrench(i), parallel.wrench(i));
+        expectSameWrench(fromForces.wrench(i), model.wrench(forceCandidates[i]));
+        float current = 0;
+        for (int pulseWidth: candidates[i].pwm_signals) {
+            current += model.current(static_cast<float>(pulseWidth));
+        }
+        ASSERT_NEAR(parallel.current[i], current, 1e-3);
+    }
+
+    // A force needs the pulse width that produces it, so it draws that pulse width's current
+    ForceBatch full;
+    full.resize(1);
+    full.set(0, force_array{{model.thrust(1900), 0, 0, 0, 0, 0, 0, model.thrust(1100)}});
+    model.evaluate(full, fromForces);
+    ASSERT_NEAR(fromForces.current[0], model.current(1900) + model.current(1100), 1e-2);
+}
+
+TEST(ThrustModelTest, PoolRunsEveryIndexOnce) {
+    WorkStealingPool pool(4);
+    ASSERT_EQ(pool.size(), 4u);
+    const std::size_t count = 10007;
+    std::vector<std::atomic<int>> visits(count);
+    for (int round = 0; round < 20; round++) {
+        pool.parallelFor(count, 64, [&](std::size_t begin, std::size_t end) {
+            // The first share is much slower, so the other threads have to steal from it
+            if (begin < count / 4) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            for (std::size_t i = begin; i < end; i++) {
+                visits[i]++;
+            }
+        });
+    }
+    for (std::size_t i = 0; i < count; i++) {
+        ASSERT_EQ(visits[i].load(), 20);
+    }
+    pool.parallelFor(0, 64, [&](std::size_t, std::size_t) { FAIL(); });
+
+    // Without helper threads the caller still gets chunks no bigger than the grain
+    WorkStealingPool alone(1);
+    std::size_t covered = 0;
+    alone.parallelFor(1000, 64, [&](std::size_t begin, std::size_t end) {
+        EXPECT_EQ(begin, covered);
+        EXPECT_LE(end - begin, 64u);
+        covered = end;
+    });
+    EXPECT_EQ(covered, 1000u);
+}
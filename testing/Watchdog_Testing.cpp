@@ -0,0 +1,122 @@
+#include "Allocation_Counter.h"
+#include "Test_Fixtures.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+TEST(WatchdogTest, StalledCommandsDriveThrustersToNeutral) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    interpreter.initializePins();
+    interpreter.enableWatchdog(std::chrono::milliseconds(50));
+
+    interpreter.untimed_execute(pwm_array{1900, 1900, 1100, 1250, 1300, 1464, 1535, 1536});
+    recorded.frames->clear();
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+    std::string expectedOutput;
+    for (int pinNumber: thrusterPinNumbers) {
+        expectedOutput.append("Set ");
+        expectedOutput.append(std::to_string(pinNumber));
+        expectedOutput.append(" PWM 1500\n");
+    }
+    ASSERT_EQ(recorded.frames->text(), expectedOutput);
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500}));
+    ASSERT_NE(recorded.errorLog.str().find("watchdog"), std::string::npos);
+
+    auto statistics = interpreter.watchdogStatistics();
+    ASSERT_EQ(statistics.trips, 1u);
+    ASSERT_LT(statistics.maximumReaction, std::chrono::milliseconds(20));
+}
+
+TEST(WatchdogTest, FreshCommandsKeepThrustersRunning) {
+    RecordedInterpreter recorded;
+    Command_Interpreter_RPi5 &interpreter = *recorded.interpreter;
+    // The watchdog runs on real time, so the blind_execute below has to take real time too
+    interpreter.useClock(std::make_shared<SteadyInterpreterClock>());
+    interpreter.initializePins();
+    interpreter.enableWatchdog(std::chrono::milliseconds(50));
+
+    const pwm_array pwms = {1900, 1900, 1100, 1250, 1300, 1464, 1535, 1536};
+    for (int i = 0; i < 15; i++) {
+        interpreter.untimed_execute(pwms);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // A blind_execute that outlasts the deadline is still a live command
+    interpreter.blind_execute(CommandComponent{pwms, std::chrono::milliseconds(120)});
+
+    ASSERT_EQ(interpreter.watchdogStatistics().trips, 0u);
+    ASSERT_EQ(interpreter.readPins(), (std::vector<int>{1900, 1900, 1100, 1250, 1300, 1464, 1535, 1536}));
+}
+
+TEST(WatchdogTest, TripsOncePerStall) {
+    std::vector<std::string> frames;
+    std::mutex framesMutex;
+    ThrusterWatchdog watchdog(std::chrono::milliseconds(20));
+    ASSERT_TRUE(watchdog.arm({4, 5}, [&](const char *frame, std::size_t length) {
+        std::lock_guard<std::mutex> lock(framesMutex);
+        frames.emplace_back(frame, length);
+    }));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(watchdog.consumeTrip());
+    ASSERT_FALSE(watchdog.consumeTrip());
+    watchdog.feed();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    watchdog.disarm();
+
+    ASSERT_EQ(watchdog.statistics().trips, 2u);
+    ASSERT_EQ(frames, (std::vector<std::string>{"Set 4 PWM 1500\nSet 5 PWM 1500\n",
+                                                "Set 4 PWM 1500\nSet 5 PWM 1500\n"}));
+}
+
+TEST(WatchdogTest, CommandWrittenAtExpiryIsNotOverwritten) {
+    std::vector<std::string> frames;
+    std::mutex framesMutex;
+    ThrusterWatchdog watchdog(std::chrono::milliseconds(20));
+    ASSERT_TRUE(watchdog.arm({4}, [&](const char *frame, std::size_t length) {
+        std::lock_guard<std::mutex> lock(framesMutex);
+        frames.emplace_back(frame, length);
+    }));
+
+    {
+        // The deadline runs out while the command is being written, but the trip has to wait for it
+        auto tripHeldOff = watchdog.holdOffTrip();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::lock_guard<std::mutex> lock(framesMutex);
+        frames.emplace_back("Set 4 PWM 1700\n");
+        watchdog.feed();
+    }
+    watchdog.disarm();
+
+    ASSERT_EQ(watchdog.statistics().trips, 0u);
+    ASSERT_EQ(frames, (std::vector<std::string>{"Set 4 PWM 1700\n"}));
+}
+
+TEST(WatchdogTest, TrippingDoesNotAllocate) {
+    // Written from the timer thread, so it counts that thread's allocations
+    std::atomic<uint64_t> allocationsAtTrip[2] = {{0}, {0}};
+    std::atomic<int> tripsSeen{0};
+    ThrusterWatchdog watchdog(std::chrono::milliseconds(10));
+    ASSERT_TRUE(watchdog.arm({4, 5, 2, 3, 9, 7, 8, 6}, [&](const char *, std::size_t) {
+        int trip = tripsSeen.load();
+        if (trip < 2) {
+            allocationsAtTrip[trip] = threadAllocationCount();
+            tripsSeen = trip + 1;
+        }
+    }));
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (tripsSeen.load() < 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // A fresh command re-arms it, and everything it does up to and including the next trip is counted
+    watchdog.feed();
+    while (tripsSeen.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    watchdog.disarm();
+
+    ASSERT_EQ(tripsSeen.load(), 2);
+    ASSERT_EQ(allocationsAtTrip[1] - allocationsAtTrip[0], 0u);
+}